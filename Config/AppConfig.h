@@ -44,6 +44,47 @@
 #define _APP_CONFIG_H_
 
 #define FIDO_REPORT_SIZE 64
-#define CTAPHID_CAPABILITIES (CTAPHID_CAPABILITY_WINK | CTAPHID_CAPABILITY_NMSG)
+
+// Service the FIDO endpoints from the USB endpoint interrupt as soon as the host fills or empties a
+// bank. Comment out to poll them from the main loop instead.
+#define FIDO_ENDPOINT_INTERRUPTS
+
+// Time each request's stages with Timer1 and keep per-command latency histograms, dumped by the
+// CTAPHID_VENDOR_PROFILE command. Takes Timer1 and about 130 bytes of RAM, and compiles out
+// completely when left undefined.
+//#define FIDO_PROFILER
+
+// Paint the free RAM at boot, and track the stack's and the heap's high-water marks from the main
+// loop's idle time, reported by the CTAPHID_VENDOR_RAM_USAGE command. Takes 12 bytes of RAM. Only
+// on the AVR, whose linker gives the RAM's layout.
+#if defined(__AVR__)
+#define FIDO_RAM_USAGE
+#endif
+
+// FIDO_SIGN_BENCH adds the CTAPHID_VENDOR_SIGN_BENCH command, which signs with a key and message
+// it's sent and replies with the signature, so the signers can be checked and timed on the AVR
+// under simavr. The signing state takes about 430 bytes of RAM and the signers several hundred of
+// stack, which the default build hasn't got spare, so it shrinks CTAPHID_MAX_MESSAGE_SIZE below to
+// make room. It's left to "make SIGN_BENCH=1", which "make simbench" uses, rather than defined here.
+
+#define CTAPHID_CAPABILITIES (CTAPHID_CAPABILITY_WINK | CTAPHID_CAPABILITY_CBOR | CTAPHID_CAPABILITY_NMSG)
+
+// Largest request payload that can be reassembled. Packets are copied into a buffer of this size as
+// they arrive, so it is the main RAM cost of accepting large messages (the advertised maxMsgSize).
+// Concurrent transactions share it, each taking a slice the size of its payload. The signing
+// benchmark build takes the smallest maxMsgSize authenticatorGetInfo can advertise, which frees the
+// RAM its signers need.
+#if defined(FIDO_SIGN_BENCH)
+#define CTAPHID_MAX_MESSAGE_SIZE 256
+#else
+#define CTAPHID_MAX_MESSAGE_SIZE 1200
+#endif
+
+// Number of channels that can have a transaction in progress at once.
+#define CTAPHID_MAX_TRANSACTIONS 4
+
+// Milliseconds a partly received request waits for its next packet before it's dropped with
+// CTAPHID_ERR_MSG_TIMEOUT.
+#define CTAPHID_TRANSACTION_TIMEOUT_MS 500
 
 #endif
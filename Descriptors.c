@@ -141,7 +141,7 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
 				.EndpointAddress = FIDO_IN_EPADDR,
 				.Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
 				.EndpointSize = FIDO_EPSIZE,
-				.PollingIntervalMS = 0x05},
+				.PollingIntervalMS = 0x01},
 
 		.HID_ReportOUTEndpoint =
 			{
@@ -150,7 +150,7 @@ const USB_Descriptor_Configuration_t PROGMEM ConfigurationDescriptor =
 				.EndpointAddress = FIDO_OUT_EPADDR,
 				.Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
 				.EndpointSize = FIDO_EPSIZE,
-				.PollingIntervalMS = 0x05},
+				.PollingIntervalMS = 0x01},
 };
 
 /** Language descriptor structure. This descriptor, located in FLASH memory, is returned when the host requests
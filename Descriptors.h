@@ -87,6 +87,11 @@ enum StringDescriptors_t
 /** Size in bytes of the Generic HID reporting endpoint. */
 #define FIDO_EPSIZE 64
 
+/** Banks of each FIDO endpoint. With two, the USB controller sends or receives one report while the
+ *  firmware fills or drains the other.
+ */
+#define FIDO_EPBANKS 2
+
 /* Function Prototypes: */
 uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
                                     const uint16_t wIndex,
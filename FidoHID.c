@@ -38,15 +38,21 @@
 #include "ctap2hid_packet.h"
 #include "ctap2hid_message.h"
 #include "ctaphid.h"
+#include "ctap2hid_transaction.h"
 #include "packet_queue.h"
-
-typedef struct
-{
-	uint32_t channel_id;
-
-} fido_state_t;
-
-int ms_till_poll = 5;
+#include "profiler.h"
+#include "ram_usage.h"
+#include "ctap2_request.h"
+#include "ctap2_info.h"
+#include "keepalive.h"
+#include "hash_stage.h"
+#include "drbg.h"
+#include "channel_table.h"
+#include "credential_store.h"
+#include "p256.h"
+#include "ed25519.h"
+#include "timer_wheel.h"
+#include "pt.h"
 
 void led_error(void)
 {
@@ -62,9 +68,11 @@ packet_queue_t in_queue;
 
 packet_queue_t out_queue;
 
+// The main loop produces into in_queue and consumes from out_queue, and hid_poll_task does the
+// opposite, so the queues need no locking even when it runs from the endpoint ISR.
 void write_packet(ctap2hid_packet_t *data)
 {
-	pq_push(&in_queue, *data);
+	pq_push(&in_queue, data);
 }
 
 void write_message(ctap2hid_message_t *message)
@@ -72,11 +80,29 @@ void write_message(ctap2hid_message_t *message)
 	write_message_packets(message, write_packet);
 }
 
-void handle_error(ctap2hid_packet_t *packet, uint8_t err)
+ctap2hid_response_t response_stream;
+
+void write_response(ctap2hid_message_view_t *response)
+{
+	// Single packet responses are queued whole. Longer ones are pulled from their source a packet at a
+	// time by hid_poll_task, so the source has to stay valid until the response has been sent.
+	if (response->payload_length <= INIT_PAYLOAD_LENGTH)
+		write_view_packets(response, write_packet);
+	else
+	{
+		// The endpoint ISR reads the stream as soon as it's active, so it's set up in one go.
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			response_begin(&response_stream, response);
+		}
+	}
+}
+
+void write_error(uint32_t channel_id, uint8_t err)
 {
 	uint8_t payload[1] = {err};
 	ctap2hid_message_t response = {
-		.channel_id = packet->channel_id,
+		.channel_id = channel_id,
 		.command_id = CTAPHID_ERROR,
 		.payload_length = 1,
 		.payload = payload,
@@ -84,36 +110,70 @@ void handle_error(ctap2hid_packet_t *packet, uint8_t err)
 	write_message(&response);
 }
 
-void handle_ping(ctap2hid_message_t *message)
+void handle_error(ctap2hid_packet_t *packet, uint8_t err)
 {
-	ctap2hid_message_t response = {
-		.channel_id = message->channel_id,
-		.command_id = CTAPHID_PING,
-		.payload_length = message->payload_length,
-		// This payload will be freed by read_message.
-		.payload = message->payload,
-	};
+	write_error(packet->channel_id, err);
+}
 
-	write_message(&response);
+void handle_ping(ctap2hid_message_view_t *message)
+{
+	// The request's segments are echoed straight back, wherever they were received into.
+	write_response(message);
 }
 
-uint32_t next_channel_id = 1;
+uint8_t message_buffer[CTAPHID_MAX_MESSAGE_SIZE];
 
-void handle_init(ctap2hid_message_t *message)
-{
-	uint64_t nonce = *(uint64_t *)(&message->payload[0]);
+transaction_table_t transactions;
 
+drbg_t drbg;
+
+// Whatever SRAM powered up holding, left alone by the C runtime, seeds the DRBG until the watchdog
+// jitter has been mixed in.
+uint8_t power_on_sram[32] __attribute__((section(".noinit")));
+
+channel_table_t channels;
+
+// Each transaction has a timer, numbered the same, for its next packet's timeout, and there's one
+// for the lock.
+#define LOCK_TIMER CTAPHID_MAX_TRANSACTIONS
+
+#if LOCK_TIMER >= TIMER_WHEEL_TIMERS
+#error "The timer wheel needs a timer for each transaction and one for the lock"
+#endif
+
+timer_wheel_t timers;
+
+// The channel CTAPHID_LOCK has given the device to, or 0.
+uint32_t locked_channel;
+
+void handle_init(ctap2hid_message_view_t *message)
+{
 	uint8_t payload[17];
 	memset(payload, 0, 17);
 
-	// *((uint64_t *)(&payload[0])) = nonce;
-	for (int i = 0; i < 8; i++)
+	// The 8 byte nonce is echoed back at the start of the response.
+	ctap2hid_view_cursor_t cursor = view_cursor(message);
+	view_read(&cursor, payload, 8);
+
+	// An INIT on the broadcast channel allocates a channel, with a random ID so one application
+	// can't guess another's. One on an allocated channel resynchronises it, and it keeps its ID.
+	uint32_t channel_id = message->channel_id;
+	if (channel_id == CTAPHID_BROADCAST_CID)
 	{
-		payload[i] = nonce >> (8 * i);
+		uint32_t evicted;
+		channel_id = ct_open(&channels, &drbg, &evicted);
+
+		// A request still arriving on the channel that was replaced could never be completed, so its
+		// sender is told the channel's gone rather than left to time out.
+		ctap2hid_transaction_t *transaction = evicted ? tt_find(&transactions, evicted) : NULL;
+		if (transaction && transaction->reassembler.active)
+		{
+			write_error(evicted, CTAPHID_ERR_INVALID_CHANNEL);
+			tt_release(transaction);
+		}
 	}
 
-	*((uint32_t *)(&payload[8])) = next_channel_id;
-	next_channel_id++;
+	*((uint32_t *)(&payload[8])) = channel_id;
 
 	payload[12] = CTAPHID_PROTOCOL_VERSION;
 	payload[13] = 0;
@@ -131,30 +191,468 @@ void handle_init(ctap2hid_message_t *message)
 	write_message(&response);
 }
 
-void handle_message(ctap2hid_message_t *message)
+// Locks the device to the channel for up to 10 seconds, or unlocks it if the time is 0. Other
+// channels' requests are refused as busy meanwhile.
+void handle_lock(ctap2hid_message_view_t *message)
 {
-	LEDs_SetAllLEDs((LEDs_GetLEDs() + 1) & 0xf);
+	uint8_t seconds;
+	ctap2hid_view_cursor_t cursor = view_cursor(message);
 
-	switch (message->command_id)
+	if (message->payload_length != 1 || !view_read(&cursor, &seconds, 1))
 	{
-	case CTAPHID_PING:
-		handle_ping(message);
+		write_error(message->channel_id, CTAPHID_ERR_INVALID_LEN);
 		return;
-	case CTAPHID_INIT:
-		handle_init(message);
+	}
+	if (seconds > 10)
+	{
+		write_error(message->channel_id, CTAPHID_ERR_INVALID_PAR);
 		return;
 	}
 
-	uint8_t payload[1] = {CTAPHID_ERR_INVALID_CMD};
+	if (seconds)
+	{
+		locked_channel = message->channel_id;
+		tw_start(&timers, LOCK_TIMER, seconds * 1000);
+	}
+	else
+	{
+		locked_channel = 0;
+		tw_cancel(&timers, LOCK_TIMER);
+	}
+
 	ctap2hid_message_t response = {
 		.channel_id = message->channel_id,
-		.command_id = CTAPHID_ERROR,
+		.command_id = CTAPHID_LOCK,
+		.payload_length = 0,
+	};
+	write_message(&response);
+}
+
+void write_status(uint32_t channel_id, uint8_t status)
+{
+	ctap2hid_message_t response = {
+		.channel_id = channel_id,
+		.command_id = CTAPHID_CBOR,
 		.payload_length = 1,
-		.payload = payload,
+		.payload = &status,
 	};
 	write_message(&response);
 }
 
+// The transaction whose reassembled request is the source of the response being streamed.
+ctap2hid_transaction_t *responding;
+
+// The transaction whose request is being handled, or NULL if it's being handled in place.
+ctap2hid_transaction_t *handling;
+
+keepalive_t keepalive;
+
+// An authenticator command that runs over many passes of the main loop as a protothread, yielding
+// between steps so the endpoints, keepalives and other channels' INIT and PING are serviced
+// meanwhile. Its request stays where it was reassembled, in a transaction that's held until the job
+// (and any response read from the request) is done.
+typedef struct job job_t;
+typedef pt_state_t job_handler_t(job_t *job);
+
+struct job
+{
+	pt_t pt;
+	bool active;
+	uint8_t status;
+	job_handler_t *handler;
+	ctap2hid_transaction_t *transaction;
+	ctap2hid_message_view_t request;
+	uint8_t rp_id_hash[SHA256_DIGEST_LENGTH];
+};
+
+job_t job;
+
+// Hashes the rpId of a makeCredential or getAssertion request while the rest of it is arriving, so
+// its job finds the rpIdHash mostly done.
+hash_stage_t rp_id_stage;
+
+// Whether a response can be written now: there's room for a single packet reply and the stream is
+// free for a longer one. Jobs wait for this before replying.
+bool can_respond(void)
+{
+	return !pq_is_full(&in_queue) && !response_stream.active && !responding;
+}
+
+void start_job(ctap2hid_message_view_t *request, job_handler_t *handler)
+{
+	// There's only the one job, and every other channel is busy until it's done.
+	if (job.active)
+	{
+		write_error(request->channel_id, CTAPHID_ERR_CHANNEL_BUSY);
+		return;
+	}
+
+	PT_INIT(&job.pt);
+	job.active = true;
+	job.handler = handler;
+	job.transaction = handling;
+	job.request = *request;
+
+	keepalive_start(&keepalive, request->channel_id, CTAPHID_STATUS_PROCESSING);
+}
+
+/** Runs the job to its next yield. Returns whether it did any work. */
+bool run_job(void)
+{
+	if (!job.active)
+		return false;
+
+	pt_state_t state = job.handler(&job);
+
+	if (state == PT_ENDED)
+	{
+		job.active = false;
+		keepalive_stop(&keepalive);
+
+		if (response_stream.active)
+			responding = job.transaction;
+		else
+			tt_release(job.transaction);
+		job.transaction = NULL;
+	}
+
+	return state != PT_WAITING;
+}
+
+// Nothing can sign yet, so none of the algorithms a client asks for are supported.
+pt_state_t make_credential(job_t *job)
+{
+	PT_BEGIN(&job->pt);
+
+	{
+		ctap2_make_credential_t params;
+		job->status = parse_make_credential(&job->request, &params);
+		if (job->status == CTAP2_OK)
+		{
+			hash_stage_digest(&rp_id_stage, job->transaction, params.rp_id, job->rp_id_hash);
+			job->status = CTAP2_ERR_UNSUPPORTED_ALGORITHM;
+		}
+	}
+
+	PT_WAIT_UNTIL(&job->pt, can_respond());
+	write_status(job->request.channel_id, job->status);
+
+	PT_END(&job->pt);
+}
+
+// Without an allow list, the rpId's discoverable credentials are looked up in the store. Even when
+// there are some, nothing can sign with them yet.
+pt_state_t get_assertion(job_t *job)
+{
+	PT_BEGIN(&job->pt);
+
+	{
+		ctap2_get_assertion_t params;
+		job->status = parse_get_assertion(&job->request, &params);
+		if (job->status == CTAP2_OK)
+		{
+			hash_stage_digest(&rp_id_stage, job->transaction, params.rp_id, job->rp_id_hash);
+			if (params.allow_list_count == 0 && cs_find(job->rp_id_hash, CS_NONE) != CS_NONE)
+				job->status = CTAP2_ERR_UNSUPPORTED_ALGORITHM;
+			else
+				job->status = CTAP2_ERR_NO_CREDENTIALS;
+		}
+	}
+
+	PT_WAIT_UNTIL(&job->pt, can_respond());
+	write_status(job->request.channel_id, job->status);
+
+	PT_END(&job->pt);
+}
+
+// The response is constant, so it's streamed straight out of flash.
+void get_info(ctap2hid_message_view_t *message)
+{
+	ctap2hid_message_view_t response = progmem_view(message->channel_id, CTAPHID_CBOR, ctap2_info_response, ctap2_info_response_length);
+	write_response(&response);
+}
+
+// Commands that are quick and need no RAM are answered on the spot. The rest run as the job.
+void handle_cbor(ctap2hid_message_view_t *message)
+{
+	uint8_t command;
+	ctap2hid_view_cursor_t cursor = view_cursor(message);
+
+	if (!view_read(&cursor, &command, 1))
+	{
+		write_error(message->channel_id, CTAPHID_ERR_INVALID_LEN);
+		return;
+	}
+
+	// Requests are parsed in place, straight out of the reassembly buffer they arrived in.
+	switch (command)
+	{
+	case CTAP2_MAKE_CREDENTIAL:
+		start_job(message, make_credential);
+		return;
+	case CTAP2_GET_ASSERTION:
+		start_job(message, get_assertion);
+		return;
+	case CTAP2_GET_INFO:
+		get_info(message);
+		return;
+	}
+
+	write_status(message->channel_id, CTAP1_ERR_INVALID_COMMAND);
+}
+
+#if defined(FIDO_PROFILER)
+void handle_profile(ctap2hid_message_view_t *message)
+{
+	ctap2hid_message_view_t response = profile_view(message->channel_id);
+	write_response(&response);
+}
+#endif
+
+#if defined(FIDO_RAM_USAGE)
+void handle_ram_usage(ctap2hid_message_view_t *message)
+{
+	ram_usage_update();
+
+	ctap2hid_message_view_t response = ram_usage_view(message->channel_id);
+	write_response(&response);
+}
+#endif
+
+#if defined(FIDO_SIGN_BENCH)
+// Signs as an assertion would, a step per pass of the main loop. The request is the signer, then a
+// P-256 private key and hash, or an Ed25519 seed, public key and message. The signature's replied
+// with, so it can be checked against known answers. It's written over the request, which is longer
+// and no longer needed by then, so it takes no RAM of its own.
+union
+{
+	p256_sign_t p256;
+	ed25519_sign_t ed25519;
+} sign_bench;
+
+uint8_t sign_bench_signer;
+ctap2hid_view_cursor_t sign_bench_message;
+
+// Feeds the Ed25519 message to the signer's hash, which reads it twice.
+void sign_bench_update(void)
+{
+	ctap2hid_view_cursor_t cursor = sign_bench_message;
+	const uint8_t *data;
+	uint16_t size;
+
+	while ((size = view_next_chunk(&cursor, &data, CTAPHID_MAX_MESSAGE_SIZE)))
+		ed25519_sign_update(&sign_bench.ed25519, data, size);
+}
+
+// Reads the request and starts signing. Returns false if the request's malformed.
+bool sign_bench_start(ctap2hid_message_view_t *request)
+{
+	ctap2hid_view_cursor_t cursor = view_cursor(request);
+	uint8_t key[2][32];
+
+	if (view_read(&cursor, &sign_bench_signer, 1) + view_read(&cursor, key[0], 32) + view_read(&cursor, key[1], 32) != 65)
+		return false;
+
+	switch (sign_bench_signer)
+	{
+	case SIGN_BENCH_P256:
+		return view_remaining(&cursor) == 0 && p256_sign_start(&sign_bench.p256, key[0], key[1]);
+	case SIGN_BENCH_ED25519:
+		sign_bench_message = cursor;
+		ed25519_sign_start(&sign_bench.ed25519, key[0], key[1]);
+		sign_bench_update();
+		ed25519_sign_nonce(&sign_bench.ed25519);
+		return true;
+	}
+	return false;
+}
+
+bool sign_bench_step(void)
+{
+	if (sign_bench_signer == SIGN_BENCH_P256)
+		return p256_sign_step(&sign_bench.p256);
+	return ed25519_sign_step(&sign_bench.ed25519);
+}
+
+void sign_bench_finish(uint8_t signature[P256_SIGNATURE_LENGTH])
+{
+	if (sign_bench_signer == SIGN_BENCH_P256)
+		p256_sign_finish(&sign_bench.p256, signature);
+	else
+	{
+		sign_bench_update();
+		ed25519_sign_finish(&sign_bench.ed25519, signature);
+	}
+}
+
+pt_state_t sign_bench_job(job_t *job)
+{
+	PT_BEGIN(&job->pt);
+
+	if (sign_bench_start(&job->request))
+	{
+		while (sign_bench_step())
+			PT_YIELD(&job->pt);
+		sign_bench_finish(job->transaction->reassembler.message.payload);
+		job->status = CTAP2_OK;
+	}
+	else
+		job->status = CTAPHID_ERR_INVALID_LEN;
+
+	PT_WAIT_UNTIL(&job->pt, can_respond());
+	if (job->status == CTAP2_OK)
+	{
+		ctap2hid_message_t signature = {
+			.channel_id = job->request.channel_id,
+			.command_id = CTAPHID_VENDOR_SIGN_BENCH,
+			.payload_length = P256_SIGNATURE_LENGTH,
+			.payload = job->transaction->reassembler.message.payload,
+		};
+		ctap2hid_message_view_t response = message_view(&signature);
+		write_response(&response);
+	}
+	else
+		write_error(job->request.channel_id, job->status);
+
+	PT_END(&job->pt);
+}
+#endif
+
+void dispatch_message(ctap2hid_message_view_t *message)
+{
+	switch (message->command_id)
+	{
+	case CTAPHID_PING:
+		handle_ping(message);
+		return;
+	case CTAPHID_INIT:
+		handle_init(message);
+		return;
+	case CTAPHID_LOCK:
+		handle_lock(message);
+		return;
+	case CTAPHID_CBOR:
+		handle_cbor(message);
+		return;
+#if defined(FIDO_PROFILER)
+	case CTAPHID_VENDOR_PROFILE:
+		handle_profile(message);
+		return;
+#endif
+#if defined(FIDO_RAM_USAGE)
+	case CTAPHID_VENDOR_RAM_USAGE:
+		handle_ram_usage(message);
+		return;
+#endif
+#if defined(FIDO_SIGN_BENCH)
+	case CTAPHID_VENDOR_SIGN_BENCH:
+		start_job(message, sign_bench_job);
+		return;
+#endif
+	}
+
+	write_error(message->channel_id, CTAPHID_ERR_INVALID_CMD);
+}
+
+void handle_message(ctap2hid_message_view_t *message)
+{
+	LEDs_SetAllLEDs((LEDs_GetLEDs() + 1) & 0xf);
+
+	PROFILE_COMMAND(message->channel_id, message->command_id);
+	PROFILE_STAMP(message->channel_id, PROFILE_HANDLER_ENTRY);
+
+	// Only handlers that run past KEEPALIVE_INTERVAL_MS ever get to send one. While there's a job the
+	// keepalive is its own, and it's kept going until the job is done.
+	if (!job.active)
+		keepalive_start(&keepalive, message->channel_id, CTAPHID_STATUS_PROCESSING);
+
+	dispatch_message(message);
+
+	if (!job.active)
+		keepalive_stop(&keepalive);
+
+	PROFILE_STAMP(message->channel_id, PROFILE_HANDLER_EXIT);
+}
+
+// Starts the rpId hash stage on a makeCredential or getAssertion request whose init packet has just
+// started its transaction, if the stage is free. Requests it isn't free for are hashed by their job.
+void start_hash_stage(ctap2hid_packet_t *packet)
+{
+	// The stage follows its channel's current message, which this packet has replaced.
+	if (hash_stage_is_on(&rp_id_stage, packet->channel_id))
+		hash_stage_stop(&rp_id_stage);
+
+	ctap2hid_transaction_t *transaction = tt_find(&transactions, packet->channel_id);
+	uint8_t command = packet->init.payload[0];
+
+	if (!transaction || rp_id_stage.state != HASH_STAGE_IDLE || (packet->init.command_id & 0x7f) != CTAPHID_CBOR)
+		return;
+	if (command == CTAP2_MAKE_CREDENTIAL || command == CTAP2_GET_ASSERTION)
+		hash_stage_start(&rp_id_stage, transaction, locate_rp_id);
+}
+
+// Checks a packet is on a channel it may use: one that INIT allocated, or the broadcast channel for
+// INIT itself, and only the locked channel while there is one. Returns the error to refuse it with,
+// or 0. A request starting on an allocated channel makes it the most recently used.
+uint8_t check_channel(ctap2hid_packet_t *packet)
+{
+	if (packet->channel_id == CTAPHID_BROADCAST_CID)
+	{
+		if (is_init_packet(packet) && (packet->init.command_id & 0x7f) != CTAPHID_INIT)
+			return CTAPHID_ERR_INVALID_CHANNEL;
+	}
+	else if (!ct_is_open(&channels, packet->channel_id))
+		return CTAPHID_ERR_INVALID_CHANNEL;
+
+	if (locked_channel && packet->channel_id != locked_channel)
+		return CTAPHID_ERR_CHANNEL_BUSY;
+
+	if (is_init_packet(packet))
+		ct_touch(&channels, packet->channel_id);
+	return 0;
+}
+
+// Aborts a channel's complete request for an INIT on the channel, whatever's become of it: a job
+// working on it is dropped, a response being streamed from it is cut short, and its transaction is
+// released so the INIT can be handled as on an idle channel. One still arriving is left to tt_feed.
+void abort_request(uint32_t channel_id)
+{
+	ctap2hid_transaction_t *transaction = tt_find(&transactions, channel_id);
+
+	if (!transaction || transaction->reassembler.active)
+		return;
+
+	if (hash_stage_is_on(&rp_id_stage, channel_id))
+		hash_stage_stop(&rp_id_stage);
+
+	if (job.active && job.transaction == transaction)
+	{
+		job.active = false;
+		job.transaction = NULL;
+		keepalive_stop(&keepalive);
+	}
+
+	if (responding == transaction)
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			response_stream.active = false;
+		}
+		responding = NULL;
+	}
+
+	tt_release(transaction);
+}
+
+bool may_start_job(uint8_t command_id)
+{
+#if defined(FIDO_SIGN_BENCH)
+	if (command_id == CTAPHID_VENDOR_SIGN_BENCH)
+		return true;
+#endif
+	return command_id == CTAPHID_CBOR;
+}
+
 ctap2hid_packet_t *read_packet(uint8_t n)
 {
 	return pq_peek_n(&out_queue, n);
@@ -162,27 +660,153 @@ ctap2hid_packet_t *read_packet(uint8_t n)
 
 bool process_messages(void)
 {
-	while (!pq_is_empty(&out_queue) && !is_init_packet(pq_peek(&out_queue)))
+	if (responding && !response_stream.active)
+	{
+		tt_release(responding);
+		responding = NULL;
+	}
+
+	// Each step below may queue a single packet reply, or two for an INIT that evicts a channel with a
+	// request still arriving, so nothing is done until there's room for them.
+	if (pq_length(&in_queue) > PACKET_QUEUE_LEN - 2)
+		return false;
+
+	ctap2hid_message_view_t view;
+
+	// Complete requests are handled once the response stream is free for their reply.
+	ctap2hid_transaction_t *transaction = response_stream.active ? NULL : tt_next_complete(&transactions);
+
+	if (transaction)
 	{
-		pq_pop(&out_queue);
+		transaction->handled = true;
+		view = message_view(&transaction->reassembler.message);
+
+		handling = transaction;
+		handle_message(&view);
+		handling = NULL;
+
+		// A job takes its transaction over, and releases it itself.
+		if (job.transaction == transaction)
+			return true;
+
+		if (response_stream.active)
+			responding = transaction;
+		else
+			tt_release(transaction);
+
+		return true;
 	}
 
 	if (pq_is_empty(&out_queue))
 		return false;
 
-	ctap2hid_message_t message = {};
-	bool err = false;
-	uint8_t packet_count = read_message_packets(&message, &err, read_packet, handle_error);
-	pq_pop_n(&out_queue, packet_count);
+	ctap2hid_packet_t *packet = pq_peek(&out_queue);
+
+	// Continuation packets on a channel they can't use are dropped like any other spurious ones.
+	uint8_t err = check_channel(packet);
+	if (err)
+	{
+		if (is_init_packet(packet))
+			handle_error(packet, err);
+		pq_release(&out_queue);
+		return true;
+	}
+
+	if (is_init_packet(packet) && (packet->init.command_id & 0x7f) == CTAPHID_INIT)
+		abort_request(packet->channel_id);
 
-	if (!err)
+	// A single packet request on a channel with no transaction open is handled in place, without
+	// copying. Its reply can't be streamed from the packet once it's released, so this waits for the
+	// response stream to be free. Requests that may start a job that outlives the packet are always
+	// reassembled.
+	if (!response_stream.active && !tt_find(&transactions, packet->channel_id) &&
+		is_init_packet(packet) && SwapEndian_16(packet->init.payload_length) <= INIT_PAYLOAD_LENGTH &&
+		!may_start_job(packet->init.command_id & 0x7f))
 	{
-		handle_message(&message);
+		read_message_view(&view, read_packet);
+		PROFILE_STAMP(view.channel_id, PROFILE_COMPLETE);
+		handle_message(&view);
+		pq_release(&out_queue);
+		return true;
+	}
+
+	// Otherwise packets are demultiplexed by channel and each is consumed as soon as it arrives, so a
+	// message may be larger than the queue and one channel's partial message never holds up another's.
+	// An init packet starts a new message unless its channel's request is complete, when it's refused.
+	// An INIT has already aborted a complete request.
+	transaction = tt_find(&transactions, packet->channel_id);
+	bool starts_message = is_init_packet(packet) && (!transaction || transaction->reassembler.active);
+
+	if (tt_feed(&transactions, packet, handle_error))
+		PROFILE_STAMP(packet->channel_id, PROFILE_COMPLETE);
+	if (starts_message)
+		start_hash_stage(packet);
+	pq_release(&out_queue);
+
+	// Every packet a message is still waiting on has its own timeout.
+	transaction = tt_find(&transactions, packet->channel_id);
+	if (transaction)
+	{
+		uint8_t timer = transaction - transactions.transactions;
+		if (transaction->reassembler.active)
+			tw_start(&timers, timer, CTAPHID_TRANSACTION_TIMEOUT_MS);
+		else
+			tw_cancel(&timers, timer);
 	}
 
 	return true;
 }
 
+/** Deals with an expired timer, once there's room for the error a timeout is reported with. Returns
+ *  whether there was one.
+ */
+bool expire_timers(void)
+{
+	if (pq_is_full(&in_queue))
+		return false;
+
+	uint8_t timer = tw_next_expired(&timers);
+	if (timer == TIMER_NONE)
+		return false;
+
+	if (timer == LOCK_TIMER)
+	{
+		locked_channel = 0;
+		return true;
+	}
+
+	// A transaction's timer may have outlived the message it was started for, so only a message
+	// that's still being received times out.
+	ctap2hid_transaction_t *transaction = &transactions.transactions[timer];
+	if (transaction->in_use && transaction->reassembler.active)
+	{
+		write_error(transaction->reassembler.message.channel_id, CTAPHID_ERR_MSG_TIMEOUT);
+		tt_release(transaction);
+	}
+	return true;
+}
+
+/** Resets the packet queues and transaction table to their power-on state. */
+void init_state(void)
+{
+	in_queue = pq_init();
+	out_queue = pq_init();
+	transactions = tt_init(message_buffer, sizeof(message_buffer));
+	response_stream.active = false;
+	responding = NULL;
+	keepalive_stop(&keepalive);
+	job.active = false;
+	job.transaction = NULL;
+	hash_stage_stop(&rp_id_stage);
+	drbg_init(&drbg, power_on_sram, sizeof(power_on_sram));
+	channels = ct_init();
+	timers = tw_init();
+	locked_channel = 0;
+	cs_init();
+
+	PROFILE_INIT();
+}
+
 /** Main program entry point. This routine contains the overall program flow, including initial
  *  setup of all components and the main program loop.
  */
@@ -193,19 +817,40 @@ int main(void)
 	LEDs_SetAllLEDs(LEDMASK_USB_NOTREADY);
 	GlobalInterruptEnable();
 
-	in_queue = pq_init();
-	out_queue = pq_init();
+	init_state();
 
 	for (;;)
-	{
-		if (ms_till_poll == 0)
-		{
-			hid_poll_task();
-			ms_till_poll = 5;
-		}
-		USB_USBTask();
-		process_messages();
-	}
+		fido_task();
+}
+
+/** Runs one pass of the main loop. Returns whether any task did work. */
+bool fido_task(void)
+{
+#if !defined(FIDO_ENDPOINT_INTERRUPTS)
+	hid_poll_task();
+#endif
+	USB_USBTask();
+
+	// Each task does a bounded amount of work before the next gets a turn, so a long running job
+	// never holds up the endpoints or other channels' requests.
+	bool processed = expire_timers();
+	processed |= process_messages();
+	processed |= hash_stage_run(&rp_id_stage);
+	processed |= run_job();
+
+	// Random bytes are only made when there's nothing else to do, so handing them out costs nothing.
+	if (!processed)
+		processed = drbg_task(&drbg);
+
+	// RAM use is checked in whatever idle time's left. It never counts as work, so the loop still idles.
+	if (!processed)
+		RAM_USAGE_TASK();
+
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+	hid_enable_interrupts();
+#endif
+
+	return processed;
 }
 
 /** Configures the board hardware and chip peripherals for the demo's functionality. */
@@ -220,6 +865,12 @@ void SetupHardware(void)
 	/* Hardware Initialization */
 	LEDs_Init();
 	USB_Init();
+
+	/* The watchdog runs from its own RC oscillator, so the unprescaled Timer0 count it interrupts
+	   at every 16ms jitters. Its interrupt, rather than a reset, samples that for the DRBG. */
+	TCCR0B = (1 << CS00);
+	WDTCSR = (1 << WDCE) | (1 << WDE);
+	WDTCSR = (1 << WDIE);
 }
 
 /** Event handler for the library USB Connection event. */
@@ -239,12 +890,16 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
 	bool ConfigSuccess = true;
 
-	ConfigSuccess &= Endpoint_ConfigureEndpoint(FIDO_IN_EPADDR, EP_TYPE_INTERRUPT, FIDO_EPSIZE, 1);
-	ConfigSuccess &= Endpoint_ConfigureEndpoint(FIDO_OUT_EPADDR, EP_TYPE_INTERRUPT, FIDO_EPSIZE, 1);
+	ConfigSuccess &= Endpoint_ConfigureEndpoint(FIDO_IN_EPADDR, EP_TYPE_INTERRUPT, FIDO_EPSIZE, FIDO_EPBANKS);
+	ConfigSuccess &= Endpoint_ConfigureEndpoint(FIDO_OUT_EPADDR, EP_TYPE_INTERRUPT, FIDO_EPSIZE, FIDO_EPBANKS);
 
-	// Enables EVENT_USB_Device_StartOfFrame
+	// Enables EVENT_USB_Device_StartOfFrame, which times keepalives and the timer wheel
 	USB_Device_EnableSOFEvents();
 
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+	hid_enable_interrupts();
+#endif
+
 	LEDs_SetAllLEDs(ConfigSuccess ? LEDMASK_USB_READY : LEDMASK_USB_ERROR);
 }
 
@@ -254,13 +909,52 @@ void EVENT_USB_Device_ControlRequest(void)
 	// CTAP2HID has no traffic on control requests. May have to implement anyway to satisfy OS, but hopefully can be avoided.
 }
 
-/** Event handler for the USB device Start Of Frame event. */
+/** Event handler for the USB device Start Of Frame event, raised every millisecond. */
 void EVENT_USB_Device_StartOfFrame(void)
 {
-	// This event triggers once every millisecond. This allows us to implement polling intervals!
-	ms_till_poll--;
+	tw_tick(&timers);
+
+	// This runs from the USB interrupt, so a due keepalive is sent even while a handler is busy.
+	if (keepalive_tick(&keepalive))
+	{
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+		hid_enable_interrupts();
+#endif
+	}
+}
+
+/** Watchdog interrupt, sampling Timer0 for the DRBG's entropy. */
+ISR(WDT_vect)
+{
+	drbg_add_sample(&drbg, TCNT0);
+}
+
+void write_endpoint(const uint8_t *data, uint8_t length, bool progmem)
+{
+	if (!data)
+		Endpoint_Null_Stream(length, NULL);
+	else if (progmem)
+		Endpoint_Write_PStream_LE(data, length, NULL);
+	else
+		Endpoint_Write_Stream_LE(data, length, NULL);
 }
 
+// A keepalive goes out ahead of everything else, unless that would put it in the middle of its own
+// channel's response.
+bool keepalive_pending(void)
+{
+	return keepalive.due && !(response_stream.active && response_stream.started &&
+							  response_stream.view.channel_id == keepalive.channel_id);
+}
+
+bool hid_has_in_data(void)
+{
+	return keepalive_pending() || !pq_is_empty(&in_queue) || response_stream.active;
+}
+
+/** Moves reports between the endpoints and the packet queues: every free IN bank is filled and every
+ *  received OUT bank is drained, as far as the queues allow.
+ */
 void hid_poll_task(void)
 {
 	/* Device must be connected and configured for the task to run */
@@ -269,25 +963,98 @@ void hid_poll_task(void)
 
 	Endpoint_SelectEndpoint(FIDO_IN_EPADDR);
 
-	if (!pq_is_empty(&in_queue) && Endpoint_IsINReady() && Endpoint_IsReadWriteAllowed())
+	while (hid_has_in_data() && Endpoint_IsINReady() && Endpoint_IsReadWriteAllowed())
 	{
-		ctap2hid_packet_t *packet = pq_peek(&in_queue);
+		// A due keepalive goes first. Then queued single packet replies, as they may be errors for
+		// channels other than the one being streamed to.
+		if (keepalive_pending())
+		{
+			keepalive_write_packet(&keepalive, write_endpoint);
+			Endpoint_ClearIN();
+		}
+		else if (!pq_is_empty(&in_queue))
+		{
+			ctap2hid_packet_t *packet = pq_peek(&in_queue);
 
-		Endpoint_Write_Stream_LE(packet, FIDO_REPORT_SIZE, NULL);
-		Endpoint_ClearIN();
+			Endpoint_Write_Stream_LE(packet, FIDO_REPORT_SIZE, NULL);
+			Endpoint_ClearIN();
 
-		pq_pop(&in_queue);
+			PROFILE_STAMP(packet->channel_id, PROFILE_SENT);
+			pq_release(&in_queue);
+		}
+		else
+		{
+			if (!response_write_packet(&response_stream, write_endpoint))
+				PROFILE_STAMP(response_stream.view.channel_id, PROFILE_SENT);
+			Endpoint_ClearIN();
+		}
 	}
 
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+	// A free bank keeps its interrupt raised, so it's masked until there's something to put in it.
+	if (!hid_has_in_data())
+		UEIENX &= ~(1 << TXINE);
+#endif
+
 	Endpoint_SelectEndpoint(FIDO_OUT_EPADDR);
 
-	if (!pq_is_full(&out_queue) && Endpoint_IsOUTReceived() && Endpoint_IsReadWriteAllowed())
-	{
-		ctap2hid_packet_t packet;
+	ctap2hid_packet_t *packet;
 
-		Endpoint_Read_Stream_LE(&packet, FIDO_REPORT_SIZE, NULL);
+	// Reports are read straight into the queue's slots.
+	while ((packet = pq_reserve(&out_queue)) && Endpoint_IsOUTReceived() && Endpoint_IsReadWriteAllowed())
+	{
+		Endpoint_Read_Stream_LE(packet, FIDO_REPORT_SIZE, NULL);
 		Endpoint_ClearOUT();
 
-		pq_push(&out_queue, packet);
+		if (is_init_packet(packet))
+			PROFILE_STAMP(packet->channel_id, PROFILE_RECEIVED);
+
+		pq_commit(&out_queue);
+	}
+
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+	// Likewise a received bank can't be acknowledged until the queue has room for it.
+	if (pq_is_full(&out_queue))
+		UEIENX &= ~(1 << RXOUTE);
+#endif
+}
+
+#if defined(FIDO_ENDPOINT_INTERRUPTS)
+/** Unmasks the endpoint interrupts for whichever directions the packet queues can make progress in.
+ *  hid_poll_task masks them again from the ISR once they run out of work.
+ */
+void hid_enable_interrupts(void)
+{
+	if (USB_DeviceState != DEVICE_STATE_Configured)
+		return;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint8_t PrevSelectedEndpoint = Endpoint_GetCurrentEndpoint();
+
+		if (hid_has_in_data())
+		{
+			Endpoint_SelectEndpoint(FIDO_IN_EPADDR);
+			UEIENX |= (1 << TXINE);
+		}
+
+		if (!pq_is_full(&out_queue))
+		{
+			Endpoint_SelectEndpoint(FIDO_OUT_EPADDR);
+			UEIENX |= (1 << RXOUTE);
+		}
+
+		Endpoint_SelectEndpoint(PrevSelectedEndpoint);
 	}
-}
\ No newline at end of file
+}
+
+/** Endpoint interrupt, raised as soon as the host has filled the OUT bank or emptied the IN bank. */
+ISR(USB_COM_vect, ISR_BLOCK)
+{
+	uint8_t PrevSelectedEndpoint = Endpoint_GetCurrentEndpoint();
+
+	hid_poll_task();
+
+	Endpoint_SelectEndpoint(PrevSelectedEndpoint);
+}
+#endif
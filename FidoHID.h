@@ -41,6 +41,7 @@
 #include <avr/wdt.h>
 #include <avr/power.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
@@ -67,7 +68,11 @@
 
 /* Function Prototypes: */
 void SetupHardware(void);
+void init_state(void);
+bool fido_task(void);
 void hid_poll_task(void);
+void hid_enable_interrupts(void);
+bool process_messages(void);
 
 void EVENT_USB_Device_Connect(void);
 void EVENT_USB_Device_Disconnect(void);
@@ -0,0 +1,39 @@
+/** \file
+ *
+ *  Host build stand-in for LUFA's Common.h, providing the attribute, endian and
+ *  utility macros used by the application code.
+ */
+
+#ifndef _HOST_SHIM_LUFA_COMMON_H_
+#define _HOST_SHIM_LUFA_COMMON_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define ATTR_PACKED __attribute__((packed))
+#define ATTR_WARN_UNUSED_RESULT __attribute__((warn_unused_result))
+#define ATTR_NON_NULL_PTR_ARG(...) __attribute__((nonnull(__VA_ARGS__)))
+#define ATTR_ALWAYS_INLINE __attribute__((always_inline))
+
+#if !defined(MIN)
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#if !defined(MAX)
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+#define SwapEndian_16(Word) ((uint16_t)((((Word) & 0xFF00) >> 8) | (((Word) & 0x00FF) << 8)))
+
+#define GlobalInterruptEnable() \
+    do                          \
+    {                           \
+    } while (0)
+
+#define GlobalInterruptDisable() \
+    do                           \
+    {                            \
+    } while (0)
+
+#endif
@@ -0,0 +1,36 @@
+/** \file
+ *
+ *  Host build stand-in for LUFA's board LED driver. The LED state is kept in a
+ *  variable so that host tools can inspect it.
+ */
+
+#ifndef _HOST_SHIM_LUFA_LEDS_H_
+#define _HOST_SHIM_LUFA_LEDS_H_
+
+#include "../../Common/Common.h"
+
+#define LEDS_LED1 (1 << 0)
+#define LEDS_LED2 (1 << 1)
+#define LEDS_LED3 (1 << 2)
+#define LEDS_LED4 (1 << 3)
+#define LEDS_ALL_LEDS (LEDS_LED1 | LEDS_LED2 | LEDS_LED3 | LEDS_LED4)
+#define LEDS_NO_LEDS 0
+
+extern uint8_t host_leds;
+
+static inline void LEDs_Init(void)
+{
+    host_leds = LEDS_NO_LEDS;
+}
+
+static inline void LEDs_SetAllLEDs(const uint8_t LEDMask)
+{
+    host_leds = LEDMask;
+}
+
+static inline uint8_t LEDs_GetLEDs(void)
+{
+    return host_leds;
+}
+
+#endif
@@ -0,0 +1,236 @@
+/** \file
+ *
+ *  Host build stand-in for LUFA's USB driver. Descriptor types and the HID
+ *  report item macros mirror LUFA's layouts, so Descriptors.c builds unchanged,
+ *  and the low level endpoint API is backed by the emulated USB controller in
+ *  host_usb.c.
+ */
+
+#ifndef _HOST_SHIM_LUFA_USB_H_
+#define _HOST_SHIM_LUFA_USB_H_
+
+#include "../../Common/Common.h"
+
+/* Macros: */
+#define ENDPOINT_DIR_MASK 0x80
+#define ENDPOINT_DIR_OUT 0x00
+#define ENDPOINT_DIR_IN 0x80
+
+#define EP_TYPE_CONTROL 0x00
+#define EP_TYPE_ISOCHRONOUS 0x01
+#define EP_TYPE_BULK 0x02
+#define EP_TYPE_INTERRUPT 0x03
+
+#define ENDPOINT_ATTR_NO_SYNC (0 << 2)
+#define ENDPOINT_USAGE_DATA (0 << 4)
+
+#define NO_DESCRIPTOR 0
+
+/** As Config/LUFAConfig.h sets them for the AVR8 build. */
+#define FIXED_CONTROL_ENDPOINT_SIZE 8
+#define FIXED_NUM_CONFIGURATIONS 1
+
+#define VERSION_BCD(Major, Minor, Revision) \
+    (((Major & 0xFF) << 8) | ((Minor & 0x0F) << 4) | (Revision & 0x0F))
+
+#define LANGUAGE_ID_ENG 0x0409
+
+#define USB_CONFIG_ATTR_RESERVED 0x80
+#define USB_CONFIG_ATTR_SELFPOWERED 0x40
+#define USB_CONFIG_POWER_MA(mA) ((mA) >> 1)
+
+/** String descriptors hold UTF-16, which the host's wide string literals are
+ *  only with -fshort-wchar, as the makefile builds Descriptors.c. */
+#define USB_STRING_DESCRIPTOR(String)                                                          \
+    {                                                                                          \
+        .Header = {.Size = sizeof(USB_Descriptor_Header_t) + (sizeof(String) - 2),             \
+                   .Type = DTYPE_String},                                                      \
+        .UnicodeString = String                                                                \
+    }
+
+#define USB_STRING_DESCRIPTOR_ARRAY(...)                                                       \
+    {                                                                                          \
+        .Header = {.Size = sizeof(USB_Descriptor_Header_t) + sizeof((uint16_t[]){__VA_ARGS__}), \
+                   .Type = DTYPE_String},                                                      \
+        .UnicodeString = {__VA_ARGS__}                                                         \
+    }
+
+#define HID_RI_TYPE_MAIN 0x00
+#define HID_RI_TYPE_GLOBAL 0x04
+#define HID_RI_TYPE_LOCAL 0x08
+
+#define HID_RI_DATA_BITS_0 0x00
+#define HID_RI_DATA_BITS_8 0x01
+#define HID_RI_DATA_BITS_16 0x02
+#define HID_RI_DATA_BITS_32 0x03
+
+#define _HID_RI_ENCODE_0(Data)
+#define _HID_RI_ENCODE_8(Data) , (Data & 0xFF)
+#define _HID_RI_ENCODE_16(Data) _HID_RI_ENCODE_8(Data) _HID_RI_ENCODE_8(Data >> 8)
+#define _HID_RI_ENCODE_32(Data) _HID_RI_ENCODE_16(Data) _HID_RI_ENCODE_16(Data >> 16)
+
+#define _HID_RI_ENTRY(Type, Tag, DataBits, ...) \
+    (Type | Tag | HID_RI_DATA_BITS_##DataBits) _HID_RI_ENCODE_##DataBits((__VA_ARGS__))
+
+#define HID_RI_INPUT(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_MAIN, 0x80, DataBits, __VA_ARGS__)
+#define HID_RI_OUTPUT(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_MAIN, 0x90, DataBits, __VA_ARGS__)
+#define HID_RI_COLLECTION(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_MAIN, 0xA0, DataBits, __VA_ARGS__)
+#define HID_RI_END_COLLECTION(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_MAIN, 0xC0, DataBits, __VA_ARGS__)
+#define HID_RI_USAGE_PAGE(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_GLOBAL, 0x00, DataBits, __VA_ARGS__)
+#define HID_RI_LOGICAL_MINIMUM(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_GLOBAL, 0x10, DataBits, __VA_ARGS__)
+#define HID_RI_LOGICAL_MAXIMUM(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_GLOBAL, 0x20, DataBits, __VA_ARGS__)
+#define HID_RI_REPORT_SIZE(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_GLOBAL, 0x70, DataBits, __VA_ARGS__)
+#define HID_RI_REPORT_COUNT(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_GLOBAL, 0x90, DataBits, __VA_ARGS__)
+#define HID_RI_USAGE(DataBits, ...) _HID_RI_ENTRY(HID_RI_TYPE_LOCAL, 0x00, DataBits, __VA_ARGS__)
+
+#define HID_IOF_DATA (0 << 0)
+#define HID_IOF_VARIABLE (1 << 1)
+#define HID_IOF_ABSOLUTE (0 << 2)
+
+/* Enums: */
+enum USB_DescriptorTypes_t
+{
+    DTYPE_Device = 0x01,
+    DTYPE_Configuration = 0x02,
+    DTYPE_String = 0x03,
+    DTYPE_Interface = 0x04,
+    DTYPE_Endpoint = 0x05,
+};
+
+enum USB_Descriptor_ClassSubclassProtocol_t
+{
+    USB_CSCP_NoDeviceClass = 0x00,
+    USB_CSCP_NoDeviceSubclass = 0x00,
+    USB_CSCP_NoDeviceProtocol = 0x00,
+};
+
+enum HID_Descriptor_ClassSubclassProtocol_t
+{
+    HID_CSCP_HIDClass = 0x03,
+    HID_CSCP_NonBootSubclass = 0x00,
+    HID_CSCP_NonBootProtocol = 0x00,
+};
+
+enum HID_DescriptorTypes_t
+{
+    HID_DTYPE_HID = 0x21,
+    HID_DTYPE_Report = 0x22,
+};
+
+enum USB_Device_States_t
+{
+    DEVICE_STATE_Unattached = 0,
+    DEVICE_STATE_Powered = 1,
+    DEVICE_STATE_Default = 2,
+    DEVICE_STATE_Addressed = 3,
+    DEVICE_STATE_Configured = 4,
+    DEVICE_STATE_Suspended = 5,
+};
+
+enum Endpoint_Stream_RW_ErrorCodes_t
+{
+    ENDPOINT_RWSTREAM_NoError = 0,
+    ENDPOINT_RWSTREAM_EndpointStalled = 1,
+    ENDPOINT_RWSTREAM_DeviceDisconnected = 2,
+    ENDPOINT_RWSTREAM_BusSuspended = 3,
+    ENDPOINT_RWSTREAM_Timeout = 4,
+    ENDPOINT_RWSTREAM_IncompleteTransfer = 5,
+};
+
+/* Type Defines: */
+typedef struct
+{
+    uint8_t Size;
+    uint8_t Type;
+} ATTR_PACKED USB_Descriptor_Header_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint16_t USBSpecification;
+    uint8_t Class;
+    uint8_t SubClass;
+    uint8_t Protocol;
+    uint8_t Endpoint0Size;
+    uint16_t VendorID;
+    uint16_t ProductID;
+    uint16_t ReleaseNumber;
+    uint8_t ManufacturerStrIndex;
+    uint8_t ProductStrIndex;
+    uint8_t SerialNumStrIndex;
+    uint8_t NumberOfConfigurations;
+} ATTR_PACKED USB_Descriptor_Device_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint16_t UnicodeString[];
+} ATTR_PACKED USB_Descriptor_String_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint16_t TotalConfigurationSize;
+    uint8_t TotalInterfaces;
+    uint8_t ConfigurationNumber;
+    uint8_t ConfigurationStrIndex;
+    uint8_t ConfigAttributes;
+    uint8_t MaxPowerConsumption;
+} ATTR_PACKED USB_Descriptor_Configuration_Header_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint8_t InterfaceNumber;
+    uint8_t AlternateSetting;
+    uint8_t TotalEndpoints;
+    uint8_t Class;
+    uint8_t SubClass;
+    uint8_t Protocol;
+    uint8_t InterfaceStrIndex;
+} ATTR_PACKED USB_Descriptor_Interface_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint16_t HIDSpec;
+    uint8_t CountryCode;
+    uint8_t TotalReportDescriptors;
+    uint8_t HIDReportType;
+    uint16_t HIDReportLength;
+} ATTR_PACKED USB_HID_Descriptor_HID_t;
+
+typedef struct
+{
+    USB_Descriptor_Header_t Header;
+    uint8_t EndpointAddress;
+    uint8_t Attributes;
+    uint16_t EndpointSize;
+    uint8_t PollingIntervalMS;
+} ATTR_PACKED USB_Descriptor_Endpoint_t;
+
+typedef uint8_t USB_Descriptor_HIDReport_Datatype_t;
+
+/* Global Variables: */
+extern volatile uint8_t USB_DeviceState;
+
+/* Function Prototypes: */
+void USB_Init(void);
+void USB_USBTask(void);
+void USB_Device_EnableSOFEvents(void);
+uint16_t USB_Device_GetFrameNumber(void);
+
+bool Endpoint_ConfigureEndpoint(const uint8_t Address, const uint8_t Type, const uint16_t Size, const uint8_t Banks);
+void Endpoint_SelectEndpoint(const uint8_t Address);
+uint8_t Endpoint_GetCurrentEndpoint(void);
+bool Endpoint_IsINReady(void);
+bool Endpoint_IsOUTReceived(void);
+bool Endpoint_IsReadWriteAllowed(void);
+void Endpoint_ClearIN(void);
+void Endpoint_ClearOUT(void);
+uint8_t Endpoint_Write_Stream_LE(const void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed);
+uint8_t Endpoint_Write_PStream_LE(const void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed);
+uint8_t Endpoint_Null_Stream(uint16_t Length, uint16_t *const BytesProcessed);
+uint8_t Endpoint_Read_Stream_LE(void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed);
+
+#endif
@@ -0,0 +1,11 @@
+/** \file
+ *
+ *  Host build stand-in for LUFA's Platform.h.
+ */
+
+#ifndef _HOST_SHIM_LUFA_PLATFORM_H_
+#define _HOST_SHIM_LUFA_PLATFORM_H_
+
+#include "../Common/Common.h"
+
+#endif
@@ -0,0 +1,46 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/eeprom.h>. The EEPROM is an array in
+ *  host_usb.c that starts out erased, like a new chip's. Writes are done at
+ *  once, and bytes read and written are counted so the benchmarks can report
+ *  how much of the EEPROM an operation touches.
+ */
+
+#ifndef _HOST_SHIM_AVR_EEPROM_H_
+#define _HOST_SHIM_AVR_EEPROM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/io.h>
+
+extern uint8_t host_eeprom[E2END + 1];
+extern unsigned long host_eeprom_reads;
+extern unsigned long host_eeprom_writes;
+
+#define eeprom_is_ready() true
+
+static inline uint8_t eeprom_read_byte(const uint8_t *address)
+{
+    host_eeprom_reads++;
+    return host_eeprom[(uintptr_t)address];
+}
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    host_eeprom_reads += n;
+    memcpy(dst, &host_eeprom[(uintptr_t)src], n);
+}
+
+/* Like avr-libc's, only bytes that differ are written. */
+static inline void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+    if (host_eeprom[(uintptr_t)address] != value)
+    {
+        host_eeprom[(uintptr_t)address] = value;
+        host_eeprom_writes++;
+    }
+}
+
+#endif
@@ -0,0 +1,24 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/interrupt.h>.
+ */
+
+#ifndef _HOST_SHIM_AVR_INTERRUPT_H_
+#define _HOST_SHIM_AVR_INTERRUPT_H_
+
+#define sei() \
+    do        \
+    {         \
+    } while (0)
+
+#define cli() \
+    do        \
+    {         \
+    } while (0)
+
+/* Interrupt vectors become plain functions, which the emulated USB controller
+ * calls whenever the matching interrupt is enabled and its condition holds. */
+#define ISR_BLOCK
+#define ISR(vector, ...) void vector(void)
+
+#endif
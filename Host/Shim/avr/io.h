@@ -0,0 +1,50 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/io.h>. Only the registers touched by the
+ *  application code are provided, as plain variables defined in host_usb.c.
+ */
+
+#ifndef _HOST_SHIM_AVR_IO_H_
+#define _HOST_SHIM_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t MCUSR;
+
+#define WDRF 3
+
+/* UEIENX is banked per endpoint on the device, so it resolves to the
+ * interrupt enable register of the currently selected endpoint. */
+volatile uint8_t *host_usb_ueienx(void);
+
+#define UEIENX (*host_usb_ueienx())
+#define TXINE 0
+#define RXOUTE 2
+
+/* Timers 0 and 1 count in step with the emulated bus: whole frames from the
+ * frame counter plus the wall clock time spent in the current one. */
+extern volatile uint8_t TCCR0B;
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+uint8_t host_usb_timer0(void);
+uint16_t host_usb_timer1(void);
+
+#define TCNT0 (host_usb_timer0())
+#define TCNT1 (host_usb_timer1())
+#define CS00 0
+#define CS10 0
+#define CS11 1
+#define CS12 2
+
+/* The ATmega32U4's 1KB of EEPROM, emulated in host_usb.c. */
+#define E2END 0x3FF
+
+/* Only the watchdog's interrupt enable bit does anything: the emulated USB
+ * controller calls WDT_vect every 16 frames while it's set. */
+extern volatile uint8_t WDTCSR;
+
+#define WDE 3
+#define WDCE 4
+#define WDIE 6
+
+#endif
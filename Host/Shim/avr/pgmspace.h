@@ -0,0 +1,20 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/pgmspace.h>. Flash and RAM share one address
+ *  space on the host, so program memory accessors are plain reads.
+ */
+
+#ifndef _HOST_SHIM_AVR_PGMSPACE_H_
+#define _HOST_SHIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P(dst, src, n) memcpy((dst), (src), (n))
+#define memcmp_P(s1, s2, n) memcmp((s1), (s2), (n))
+
+#endif
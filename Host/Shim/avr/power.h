@@ -0,0 +1,13 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/power.h>.
+ */
+
+#ifndef _HOST_SHIM_AVR_POWER_H_
+#define _HOST_SHIM_AVR_POWER_H_
+
+#define clock_div_1 0
+
+#define clock_prescale_set(div) ((void)(div))
+
+#endif
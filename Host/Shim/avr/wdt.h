@@ -0,0 +1,14 @@
+/** \file
+ *
+ *  Host build stand-in for <avr/wdt.h>.
+ */
+
+#ifndef _HOST_SHIM_AVR_WDT_H_
+#define _HOST_SHIM_AVR_WDT_H_
+
+#define wdt_disable() \
+    do                \
+    {                 \
+    } while (0)
+
+#endif
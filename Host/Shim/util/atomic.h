@@ -0,0 +1,16 @@
+/** \file
+ *
+ *  Host build stand-in for <util/atomic.h>. The emulated USB controller only
+ *  raises interrupts from the host side driver's calls, never in the middle of
+ *  application code, so an atomic block is just a block that runs once.
+ */
+
+#ifndef _HOST_SHIM_UTIL_ATOMIC_H_
+#define _HOST_SHIM_UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 0
+
+#define ATOMIC_BLOCK(type) for (int __atomic_once = ((void)(type), 1); __atomic_once; __atomic_once = 0)
+
+#endif
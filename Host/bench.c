@@ -0,0 +1,1148 @@
+/** \file
+ *
+ *  Host-native microbenchmarks for the CTAPHID core. Measures message
+ *  packetisation, in-place message views and streaming reassembly, the packet queue operations, and whole
+ *  transactions driven through the firmware's own endpoint handling on the
+ *  emulated USB controller: PINGs, whose response is as large as the request,
+ *  and requests for an unknown command, which only exercise reassembly. Every response is checked
+ *  against what the firmware should send, and a wrong one or an unexpected error stops the run.
+ *  Requests larger than CTAPHID_MAX_MESSAGE_SIZE are refused by design, so they're reported as
+ *  request_refused, and interleaved PINGs are only timed at sizes where both fit in the reassembly
+ *  buffer at once. Results are printed as one line per benchmark so they can be diffed between
+ *  commits.
+ *
+ *  Before anything's timed, a response with a segment in flash is streamed and reassembled, checking
+ *  each chunk is written with the right progmem flag, since on the host memcpy_P is memcpy.
+ *  The transaction table is checked for refusing a second large request as busy while the first's
+ *  arriving, and for letting an INIT replace its channel's request.
+ *
+ *  makeCredential requests are parsed with the up option absent, true and false, of which only false
+ *  is refused.
+ *
+ *  The DRBG's random bytes are timed as read from its pool, and as made when it's refilled.
+ *
+ *  The signing benchmarks first check the signers against known answers, and report the time per
+ *  signature (or per step) in the ns/packet column. Their peak stack use, measured by painting the
+ *  stack, is in the bytes column of the _stack lines; it's only a rough guide to the AVR's, where
+ *  words and pointers are narrower.
+ *
+ *  The credential store is checked by filling the emulated EEPROM, replacing and deleting records, and
+ *  interrupting a write part way. Its lookups are then timed with the store full. Their bytes column is
+ *  the EEPROM bytes each reads, and their pkts column the number of credentials stored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../FidoHID.h"
+#include "../chacha20.h"
+#include "../credential_store.h"
+#include "../ctap2.h"
+#include "../ctap2_request.h"
+#include "../drbg.h"
+#include "../ed25519.h"
+#include "../ctap2hid_message.h"
+#include "../ctap2hid_packet.h"
+#include "../ctap2hid_transaction.h"
+#include "../p256.h"
+#include "../packet_queue.h"
+#include "../sha256.h"
+
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+
+#include "host_usb.h"
+
+/** Largest payload a CTAPHID message can carry: an init packet and 128 continuation packets. */
+#define MAX_MESSAGE_SIZE (INIT_PAYLOAD_LENGTH + 128 * CONT_PAYLOAD_LENGTH)
+
+/** Number of packets each benchmark aims to move, which sets its iteration count. */
+#define TARGET_PACKETS 1000000UL
+
+/** Bytes of stack painted to measure the signers' peak stack use. */
+#define STACK_PAINT_SIZE 16384
+
+/** Vendor command the firmware doesn't implement, answered with a single CTAPHID_ERROR packet. */
+#define UNKNOWN_COMMAND 0x7e
+
+/** Frames a transaction may take before the firmware is considered stalled. */
+#define MAX_FRAMES 4096
+
+#define BENCH_CHANNEL_ID 0x01020304
+#define OTHER_CHANNEL_ID 0x05060708
+
+static const uint16_t payload_sizes[] = {0, 57, 58, 116, 117, 293, 512, 1024, CTAPHID_MAX_MESSAGE_SIZE, 2048, 4096, MAX_MESSAGE_SIZE};
+
+static uint8_t payload[MAX_MESSAGE_SIZE];
+static ctap2hid_packet_t packets[2 * 129];
+static uint16_t packet_count;
+/** The response packets a transaction has to produce, each channel's in order. */
+static ctap2hid_packet_t expected[2 * 129];
+static uint16_t expected_count;
+static volatile uint8_t sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint16_t packets_for(uint16_t payload_length)
+{
+    if (payload_length <= INIT_PAYLOAD_LENGTH)
+        return 1;
+    return 1 + (payload_length - INIT_PAYLOAD_LENGTH + CONT_PAYLOAD_LENGTH - 1) / CONT_PAYLOAD_LENGTH;
+}
+
+static unsigned long iterations_for(uint16_t count)
+{
+    return TARGET_PACKETS / count;
+}
+
+static void report_frames(const char *name, uint16_t payload_length, uint16_t count, unsigned long iterations, uint64_t elapsed, unsigned long frames)
+{
+    double per_packet = (double)elapsed / ((double)iterations * count);
+    double bytes_per_second = (double)payload_length * iterations * 1e9 / (double)elapsed;
+
+    printf("%-24s %6u %4u %12.1f %12.2f", name, payload_length, count, per_packet, bytes_per_second / 1e6);
+    if (frames)
+        printf(" %8.1f", (double)frames / iterations);
+    printf("\n");
+}
+
+static void report(const char *name, uint16_t payload_length, uint16_t count, unsigned long iterations, uint64_t elapsed)
+{
+    report_frames(name, payload_length, count, iterations, elapsed, 0);
+}
+
+static void store_packet(ctap2hid_packet_t *packet)
+{
+    packets[packet_count++] = *packet;
+}
+
+static void store_expected(ctap2hid_packet_t *packet)
+{
+    expected[expected_count++] = *packet;
+}
+
+static void expect_error(uint32_t channel_id, uint8_t err)
+{
+    uint8_t error_payload[1] = {err};
+    ctap2hid_message_t message = {
+        .channel_id = channel_id,
+        .command_id = CTAPHID_ERROR,
+        .payload_length = 1,
+        .payload = error_payload,
+    };
+    write_message_packets(&message, store_expected);
+}
+
+static void discard_packet(ctap2hid_packet_t *packet)
+{
+    sink ^= packet->cont.payload[0];
+}
+
+static ctap2hid_packet_t *stored_packet(uint8_t n)
+{
+    return n < packet_count ? &packets[n] : NULL;
+}
+
+static void ignore_error(ctap2hid_packet_t *packet, uint8_t err)
+{
+    (void)packet;
+    (void)err;
+}
+
+static ctap2hid_message_t bench_message(uint8_t command_id, uint16_t payload_length)
+{
+    ctap2hid_message_t message = {
+        .channel_id = BENCH_CHANNEL_ID,
+        .command_id = command_id | 0x80,
+        .payload_length = payload_length,
+        .payload = payload,
+    };
+    return message;
+}
+
+static void bench_write_message_packets(uint16_t payload_length)
+{
+    ctap2hid_message_t message = bench_message(CTAPHID_PING, payload_length);
+    uint16_t count = packets_for(payload_length);
+    unsigned long iterations = iterations_for(count);
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+        write_message_packets(&message, discard_packet);
+    report("write_message_packets", payload_length, count, iterations, now_ns() - start);
+}
+
+static void bench_read_message_view(uint16_t payload_length)
+{
+    ctap2hid_message_t message = bench_message(CTAPHID_PING, payload_length);
+    packet_count = 0;
+    write_message_packets(&message, store_packet);
+
+    uint16_t count = packet_count;
+    if (count > MESSAGE_VIEW_SEGMENTS)
+        return;
+
+    unsigned long iterations = iterations_for(count);
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        ctap2hid_message_view_t view;
+        read_message_view(&view, stored_packet);
+
+        ctap2hid_view_cursor_t cursor = view_cursor(&view);
+        const uint8_t *data;
+        uint16_t size;
+        while ((size = view_next_chunk(&cursor, &data, UINT16_MAX)))
+            sink ^= data[size - 1];
+    }
+    report("read_message_view", payload_length, count, iterations, now_ns() - start);
+}
+
+static void bench_reassemble_packet(uint16_t payload_length)
+{
+    static uint8_t buffer[MAX_MESSAGE_SIZE];
+    ctap2hid_message_t message = bench_message(CTAPHID_PING, payload_length);
+    packet_count = 0;
+    write_message_packets(&message, store_packet);
+
+    uint16_t count = packet_count;
+    unsigned long iterations = iterations_for(count);
+    ctap2hid_reassembler_t r = reassembler_init(buffer, sizeof(buffer));
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        for (uint16_t n = 0; n < count; n++)
+            reassemble_packet(&r, &packets[n], ignore_error);
+        sink ^= r.message.payload[payload_length / 2];
+    }
+    report("reassemble_packet", payload_length, count, iterations, now_ns() - start);
+}
+
+static void bench_packet_queue(void)
+{
+    packet_queue_t q = pq_init();
+    ctap2hid_packet_t packet = {.channel_id = BENCH_CHANNEL_ID};
+    unsigned long iterations = TARGET_PACKETS * 10;
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        pq_push(&q, &packet);
+        sink ^= pq_peek(&q)->cont.seq;
+        pq_release(&q);
+    }
+    report("pq_push_peek_release", 0, 1, iterations, now_ns() - start);
+
+    start = now_ns();
+    for (unsigned long i = 0; i < iterations / PACKET_QUEUE_LEN; i++)
+    {
+        while (!pq_is_full(&q))
+            pq_push(&q, &packet);
+        for (uint8_t n = 0; n < PACKET_QUEUE_LEN; n++)
+            sink ^= pq_peek_n(&q, n)->cont.seq;
+        pq_release_n(&q, PACKET_QUEUE_LEN);
+    }
+    report("pq_fill_peek_n_release_n", 0, PACKET_QUEUE_LEN, iterations / PACKET_QUEUE_LEN, now_ns() - start);
+}
+
+/** The error tt_feed last reported, or 0. */
+static uint8_t last_error;
+
+static void record_error(ctap2hid_packet_t *packet, uint8_t err)
+{
+    (void)packet;
+    last_error = err;
+}
+
+static ctap2hid_packet_t init_packet(uint32_t channel_id, uint8_t command_id, uint16_t payload_length)
+{
+    ctap2hid_packet_t packet = {
+        .channel_id = channel_id,
+        .init.command_id = command_id | 0x80,
+        .init.payload_length = SwapEndian_16(payload_length),
+    };
+    return packet;
+}
+
+/** Checks the transaction table's limits: slices are reserved at a request's whole declared length,
+ *  so a second channel's large request is refused as busy while the first's is arriving, and an INIT
+ *  replaces its channel's request, complete or not, rather than being refused. */
+static bool check_transaction_table(void)
+{
+    static uint8_t buffer[CTAPHID_MAX_MESSAGE_SIZE];
+    transaction_table_t t = tt_init(buffer, sizeof(buffer));
+    uint16_t large = CTAPHID_MAX_MESSAGE_SIZE / 2 + 1;
+    ctap2hid_packet_t packet;
+    ctap2hid_transaction_t *complete;
+
+    last_error = 0;
+    packet = init_packet(BENCH_CHANNEL_ID, UNKNOWN_COMMAND, large);
+    tt_feed(&t, &packet, record_error);
+    packet = init_packet(OTHER_CHANNEL_ID, UNKNOWN_COMMAND, large);
+    tt_feed(&t, &packet, record_error);
+    if (last_error != CTAPHID_ERR_CHANNEL_BUSY || tt_find(&t, OTHER_CHANNEL_ID))
+    {
+        printf("tt_feed: two large requests both given room\n");
+        return false;
+    }
+
+    // What's left still takes a smaller request.
+    last_error = 0;
+    packet = init_packet(OTHER_CHANNEL_ID, UNKNOWN_COMMAND, CTAPHID_MAX_MESSAGE_SIZE - large);
+    tt_feed(&t, &packet, record_error);
+    if (last_error || !tt_find(&t, OTHER_CHANNEL_ID))
+    {
+        printf("tt_feed: small request refused next to a large one\n");
+        return false;
+    }
+    tt_release(tt_find(&t, OTHER_CHANNEL_ID));
+
+    // An INIT mid-message resynchronises the channel.
+    packet = init_packet(BENCH_CHANNEL_ID, CTAPHID_INIT, 8);
+    complete = tt_feed(&t, &packet, record_error);
+    if (last_error || !complete || complete->reassembler.message.payload_length != 8)
+    {
+        printf("tt_feed: INIT didn't replace a partial request\n");
+        return false;
+    }
+
+    // Another request on a channel whose request is complete is refused, but an INIT replaces it.
+    packet = init_packet(BENCH_CHANNEL_ID, CTAPHID_PING, 0);
+    if (tt_feed(&t, &packet, record_error) || last_error != CTAPHID_ERR_CHANNEL_BUSY)
+    {
+        printf("tt_feed: request accepted on a busy channel\n");
+        return false;
+    }
+    last_error = 0;
+    packet = init_packet(BENCH_CHANNEL_ID, CTAPHID_INIT, 8);
+    if (tt_feed(&t, &packet, record_error) != complete || last_error)
+    {
+        printf("tt_feed: INIT refused on a channel with a complete request\n");
+        return false;
+    }
+    return true;
+}
+
+/** A flash string spanning several packets, as the firmware's canned responses are. */
+static const char progmem_blob[] PROGMEM =
+    "A response streamed from flash is read with memcpy_P, a chunk at a time, as it's written "
+    "into the endpoint, so it's never copied into RAM.";
+
+/** Bytes the stream writer was given, and whether each was flagged as in flash. */
+static uint8_t streamed[4 * FIDO_REPORT_SIZE];
+static bool streamed_progmem[4 * FIDO_REPORT_SIZE];
+static uint16_t streamed_length;
+
+static void record_stream(const uint8_t *data, uint8_t length, bool progmem)
+{
+    for (uint8_t i = 0; i < length && streamed_length < sizeof(streamed); i++, streamed_length++)
+    {
+        streamed[streamed_length] = data ? data[i] : 0;
+        streamed_progmem[streamed_length] = progmem;
+    }
+}
+
+/** Streams a view with a flash segment between two RAM ones, so on the host, where memcpy_P is
+ *  memcpy, the reassembled bytes are checked along with the flag each chunk was written with. */
+static bool check_progmem_response(void)
+{
+    const uint16_t blob_length = sizeof(progmem_blob) - 1;
+    ctap2hid_message_view_t view = {
+        .channel_id = BENCH_CHANNEL_ID,
+        .command_id = CTAPHID_PING,
+        .payload_length = 20 + blob_length + 30,
+        .segment_count = 3,
+        .segments = {
+            {.data = payload, .length = 20},
+            {.data = (const uint8_t *)progmem_blob, .length = blob_length, .progmem = true},
+            {.data = payload + 20, .length = 30},
+        },
+    };
+    ctap2hid_response_t response;
+    uint16_t position = 0;
+
+    streamed_length = 0;
+    response_begin(&response, &view);
+    while (response_write_packet(&response, record_stream))
+        ;
+
+    if (streamed_length != packets_for(view.payload_length) * FIDO_REPORT_SIZE)
+    {
+        printf("progmem response: wrong length\n");
+        return false;
+    }
+
+    for (uint16_t packet = 0; packet < streamed_length; packet += FIDO_REPORT_SIZE)
+    {
+        uint16_t i = packet + (packet ? 5 : 7);
+
+        for (uint16_t j = packet; j < i; j++)
+            if (streamed_progmem[j])
+            {
+                printf("progmem response: header flagged as in flash\n");
+                return false;
+            }
+
+        for (; i < packet + FIDO_REPORT_SIZE; i++, position++)
+        {
+            bool in_blob = position >= 20 && position < 20 + blob_length;
+            uint8_t expected = position >= view.payload_length ? 0
+                               : in_blob                        ? progmem_blob[position - 20]
+                               : position < 20                  ? payload[position]
+                                                                : payload[position - blob_length];
+
+            if (streamed[i] != expected || streamed_progmem[i] != in_blob)
+            {
+                printf("progmem response: wrong byte or flag at offset %u\n", position);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** RFC 6979 appendix A.2.5: P-256 with SHA-256. */
+static const uint8_t p256_private_key[32] = {
+    0xc9, 0xaf, 0xa9, 0xd8, 0x45, 0xba, 0x75, 0x16, 0x6b, 0x5c, 0x21, 0x57, 0x67, 0xb1, 0xd6, 0x93,
+    0x4e, 0x50, 0xc3, 0xdb, 0x36, 0xe8, 0x9b, 0x12, 0x7b, 0x8a, 0x62, 0x2b, 0x12, 0x0f, 0x67, 0x21,
+};
+
+static const uint8_t p256_public_key_answer[64] = {
+    0x60, 0xfe, 0xd4, 0xba, 0x25, 0x5a, 0x9d, 0x31, 0xc9, 0x61, 0xeb, 0x74, 0xc6, 0x35, 0x6d, 0x68,
+    0xc0, 0x49, 0xb8, 0x92, 0x3b, 0x61, 0xfa, 0x6c, 0xe6, 0x69, 0x62, 0x2e, 0x60, 0xf2, 0x9f, 0xb6,
+    0x79, 0x03, 0xfe, 0x10, 0x08, 0xb8, 0xbc, 0x99, 0xa4, 0x1a, 0xe9, 0xe9, 0x56, 0x28, 0xbc, 0x64,
+    0xf2, 0xf1, 0xb2, 0x0c, 0x2d, 0x7e, 0x9f, 0x51, 0x77, 0xa3, 0xc2, 0x94, 0xd4, 0x46, 0x22, 0x99,
+};
+
+static const struct
+{
+    const char *message;
+    uint8_t signature[64];
+} p256_answers[] = {
+    {"sample", {
+        0xef, 0xd4, 0x8b, 0x2a, 0xac, 0xb6, 0xa8, 0xfd, 0x11, 0x40, 0xdd, 0x9c, 0xd4, 0x5e, 0x81, 0xd6,
+        0x9d, 0x2c, 0x87, 0x7b, 0x56, 0xaa, 0xf9, 0x91, 0xc3, 0x4d, 0x0e, 0xa8, 0x4e, 0xaf, 0x37, 0x16,
+        0xf7, 0xcb, 0x1c, 0x94, 0x2d, 0x65, 0x7c, 0x41, 0xd4, 0x36, 0xc7, 0xa1, 0xb6, 0xe2, 0x9f, 0x65,
+        0xf3, 0xe9, 0x00, 0xdb, 0xb9, 0xaf, 0xf4, 0x06, 0x4d, 0xc4, 0xab, 0x2f, 0x84, 0x3a, 0xcd, 0xa8,
+    }},
+    {"test", {
+        0xf1, 0xab, 0xb0, 0x23, 0x51, 0x83, 0x51, 0xcd, 0x71, 0xd8, 0x81, 0x56, 0x7b, 0x1e, 0xa6, 0x63,
+        0xed, 0x3e, 0xfc, 0xf6, 0xc5, 0x13, 0x2b, 0x35, 0x4f, 0x28, 0xd3, 0xb0, 0xb7, 0xd3, 0x83, 0x67,
+        0x01, 0x9f, 0x41, 0x13, 0x74, 0x2a, 0x2b, 0x14, 0xbd, 0x25, 0x92, 0x6b, 0x49, 0xc6, 0x49, 0x15,
+        0x5f, 0x26, 0x7e, 0x60, 0xd3, 0x81, 0x4b, 0x4c, 0x0c, 0xc8, 0x42, 0x50, 0xe4, 0x6f, 0x00, 0x83,
+    }},
+};
+
+/** RFC 8032 section 7.1, tests 1 to 3. */
+static const struct
+{
+    uint8_t seed[32];
+    uint8_t message[2];
+    uint8_t message_length;
+    uint8_t public_key[32];
+    uint8_t signature[64];
+} ed25519_answers[] = {
+    {
+        {
+            0x9d, 0x61, 0xb1, 0x9d, 0xef, 0xfd, 0x5a, 0x60, 0xba, 0x84, 0x4a, 0xf4, 0x92, 0xec, 0x2c, 0xc4,
+            0x44, 0x49, 0xc5, 0x69, 0x7b, 0x32, 0x69, 0x19, 0x70, 0x3b, 0xac, 0x03, 0x1c, 0xae, 0x7f, 0x60,
+        },
+        {},
+        0,
+        {
+            0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7, 0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+            0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25, 0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a,
+        },
+        {
+            0xe5, 0x56, 0x43, 0x00, 0xc3, 0x60, 0xac, 0x72, 0x90, 0x86, 0xe2, 0xcc, 0x80, 0x6e, 0x82, 0x8a,
+            0x84, 0x87, 0x7f, 0x1e, 0xb8, 0xe5, 0xd9, 0x74, 0xd8, 0x73, 0xe0, 0x65, 0x22, 0x49, 0x01, 0x55,
+            0x5f, 0xb8, 0x82, 0x15, 0x90, 0xa3, 0x3b, 0xac, 0xc6, 0x1e, 0x39, 0x70, 0x1c, 0xf9, 0xb4, 0x6b,
+            0xd2, 0x5b, 0xf5, 0xf0, 0x59, 0x5b, 0xbe, 0x24, 0x65, 0x51, 0x41, 0x43, 0x8e, 0x7a, 0x10, 0x0b,
+        },
+    },
+    {
+        {
+            0x4c, 0xcd, 0x08, 0x9b, 0x28, 0xff, 0x96, 0xda, 0x9d, 0xb6, 0xc3, 0x46, 0xec, 0x11, 0x4e, 0x0f,
+            0x5b, 0x8a, 0x31, 0x9f, 0x35, 0xab, 0xa6, 0x24, 0xda, 0x8c, 0xf6, 0xed, 0x4f, 0xb8, 0xa6, 0xfb,
+        },
+        {0x72},
+        1,
+        {
+            0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a, 0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+            0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c, 0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c,
+        },
+        {
+            0x92, 0xa0, 0x09, 0xa9, 0xf0, 0xd4, 0xca, 0xb8, 0x72, 0x0e, 0x82, 0x0b, 0x5f, 0x64, 0x25, 0x40,
+            0xa2, 0xb2, 0x7b, 0x54, 0x16, 0x50, 0x3f, 0x8f, 0xb3, 0x76, 0x22, 0x23, 0xeb, 0xdb, 0x69, 0xda,
+            0x08, 0x5a, 0xc1, 0xe4, 0x3e, 0x15, 0x99, 0x6e, 0x45, 0x8f, 0x36, 0x13, 0xd0, 0xf1, 0x1d, 0x8c,
+            0x38, 0x7b, 0x2e, 0xae, 0xb4, 0x30, 0x2a, 0xee, 0xb0, 0x0d, 0x29, 0x16, 0x12, 0xbb, 0x0c, 0x00,
+        },
+    },
+    {
+        {
+            0xc5, 0xaa, 0x8d, 0xf4, 0x3f, 0x9f, 0x83, 0x7b, 0xed, 0xb7, 0x44, 0x2f, 0x31, 0xdc, 0xb7, 0xb1,
+            0x66, 0xd3, 0x85, 0x35, 0x07, 0x6f, 0x09, 0x4b, 0x85, 0xce, 0x3a, 0x2e, 0x0b, 0x44, 0x58, 0xf7,
+        },
+        {0xaf, 0x82},
+        2,
+        {
+            0xfc, 0x51, 0xcd, 0x8e, 0x62, 0x18, 0xa1, 0xa3, 0x8d, 0xa4, 0x7e, 0xd0, 0x02, 0x30, 0xf0, 0x58,
+            0x08, 0x16, 0xed, 0x13, 0xba, 0x33, 0x03, 0xac, 0x5d, 0xeb, 0x91, 0x15, 0x48, 0x90, 0x80, 0x25,
+        },
+        {
+            0x62, 0x91, 0xd6, 0x57, 0xde, 0xec, 0x24, 0x02, 0x48, 0x27, 0xe6, 0x9c, 0x3a, 0xbe, 0x01, 0xa3,
+            0x0c, 0xe5, 0x48, 0xa2, 0x84, 0x74, 0x3a, 0x44, 0x5e, 0x36, 0x80, 0xd7, 0xdb, 0x5a, 0xc3, 0xac,
+            0x18, 0xff, 0x9b, 0x53, 0x8d, 0x16, 0xf2, 0x90, 0xae, 0x67, 0xf7, 0x60, 0x98, 0x4d, 0xc6, 0x59,
+            0x4a, 0x7c, 0x15, 0xe9, 0x71, 0x6e, 0xd2, 0x8d, 0xc0, 0x27, 0xbe, 0xce, 0xea, 0x1e, 0xc4, 0x0a,
+        },
+    },
+};
+
+// RFC 8439 section 2.3.2: the key is 00 01 .. 1f.
+static const uint8_t chacha20_nonce[12] = {0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00};
+static const uint8_t chacha20_answer[64] = {
+    0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+    0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+    0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+    0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,
+};
+
+static bool check_chacha20(void)
+{
+    uint8_t key[32];
+    uint8_t block[64];
+    for (uint8_t i = 0; i < 32; i++)
+        key[i] = i;
+
+    chacha20_block(key, 1, chacha20_nonce, block);
+    if (memcmp(block, chacha20_answer, 64))
+    {
+        printf("chacha20_block: wrong answer\n");
+        return false;
+    }
+    return true;
+}
+
+static bool check_p256(void)
+{
+    uint8_t public_key[64];
+    if (!p256_public_key(p256_private_key, public_key) || memcmp(public_key, p256_public_key_answer, 64))
+    {
+        printf("p256_public_key: wrong answer\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(p256_answers) / sizeof(p256_answers[0]); i++)
+    {
+        uint8_t hash[32];
+        uint8_t signature[64];
+        sha256((const uint8_t *)p256_answers[i].message, strlen(p256_answers[i].message), hash);
+
+        if (!p256_sign(p256_private_key, hash, signature) || memcmp(signature, p256_answers[i].signature, 64))
+        {
+            printf("p256_sign \"%s\": wrong answer\n", p256_answers[i].message);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_ed25519(void)
+{
+    for (size_t i = 0; i < sizeof(ed25519_answers) / sizeof(ed25519_answers[0]); i++)
+    {
+        uint8_t public_key[32];
+        uint8_t signature[64];
+        ed25519_public_key(ed25519_answers[i].seed, public_key);
+        ed25519_sign(ed25519_answers[i].seed, public_key, ed25519_answers[i].message, ed25519_answers[i].message_length, signature);
+
+        if (memcmp(public_key, ed25519_answers[i].public_key, 32) || memcmp(signature, ed25519_answers[i].signature, 64))
+        {
+            printf("ed25519_sign test %zu: wrong answer\n", i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** A makeCredential request with the four required parameters, ES256 only, and room at the end for
+ *  an options map. Its map header is at MAKE_CREDENTIAL_MAP. */
+#define MAKE_CREDENTIAL_MAP 1
+static const uint8_t make_credential_request[] = {
+    CTAP2_MAKE_CREDENTIAL, 0xa4,
+    // 1: clientDataHash
+    0x01, 0x58, 0x20,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    // 2: rp {"id": "a"}
+    0x02, 0xa1, 0x62, 'i', 'd', 0x61, 'a',
+    // 3: user {"id": h'01'}
+    0x03, 0xa1, 0x62, 'i', 'd', 0x41, 0x01,
+    // 4: pubKeyCredParams [{"alg": -7, "type": "public-key"}]
+    0x04, 0x81, 0xa2, 0x63, 'a', 'l', 'g', 0x26, 0x64, 't', 'y', 'p', 'e',
+    0x6a, 'p', 'u', 'b', 'l', 'i', 'c', '-', 'k', 'e', 'y',
+};
+
+/** Parses makeCredential with up absent, true and false. Only false is refused, as there's no user
+ *  presence to skip when making a credential. */
+static bool check_make_credential_up(void)
+{
+    static const struct
+    {
+        const char *name;
+        uint8_t options[6];
+        uint8_t options_length;
+        uint8_t status;
+    } cases[] = {
+        {"absent", {0}, 0, CTAP2_OK},
+        // 7: options {"up": true} and {"up": false}
+        {"true", {0x07, 0xa1, 0x62, 'u', 'p', 0xf5}, 6, CTAP2_OK},
+        {"false", {0x07, 0xa1, 0x62, 'u', 'p', 0xf4}, 6, CTAP2_ERR_INVALID_OPTION},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        uint8_t request[sizeof(make_credential_request) + 6];
+        uint16_t length = sizeof(make_credential_request);
+        ctap2_make_credential_t params;
+
+        memcpy(request, make_credential_request, length);
+        if (cases[i].options_length)
+        {
+            request[MAKE_CREDENTIAL_MAP]++;
+            memcpy(request + length, cases[i].options, cases[i].options_length);
+            length += cases[i].options_length;
+        }
+
+        ctap2hid_message_t message = {.channel_id = BENCH_CHANNEL_ID, .payload_length = length, .payload = request};
+        ctap2hid_message_view_t view = message_view(&message);
+        uint8_t status = parse_make_credential(&view, &params);
+        if (status != cases[i].status)
+        {
+            printf("parse_make_credential up %s: status 0x%02x, expected 0x%02x\n", cases[i].name, status, cases[i].status);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Bytes of user ID in the credentials the store is filled with, which makes each take two blocks. */
+#define CREDENTIAL_USER_ID_LENGTH 16
+
+static void credential_rp_id_hash(uint8_t rp, uint8_t rp_id_hash[SHA256_DIGEST_LENGTH])
+{
+    char rp_id[16];
+    snprintf(rp_id, sizeof(rp_id), "rp%u.example", rp);
+    sha256((const uint8_t *)rp_id, strlen(rp_id), rp_id_hash);
+}
+
+/** Stores a credential for the given RP, its nonce and user ID filled with the given byte, and runs
+ *  the writer to completion.
+ */
+static uint8_t store_credential(uint8_t rp, uint8_t fill, uint8_t user_id_length)
+{
+    uint8_t rp_id_hash[SHA256_DIGEST_LENGTH];
+    uint8_t nonce[CS_NONCE_LENGTH];
+    uint8_t user_id[CS_MAX_USER_ID_LENGTH];
+    ctap2hid_message_t message = {.payload_length = user_id_length, .payload = user_id};
+    ctap2hid_message_view_t view = message_view(&message);
+    cs_writer_t w;
+
+    credential_rp_id_hash(rp, rp_id_hash);
+    memset(nonce, fill, sizeof(nonce));
+    memset(user_id, rp, user_id_length);
+
+    uint8_t status = cs_store(&w, rp_id_hash, nonce, -7, view_cursor(&view));
+    if (status == CTAP2_OK)
+        while (!cs_write_step(&w))
+            ;
+    return status;
+}
+
+/** Checks the RP has exactly one credential, with the nonce filled with the given byte. */
+static bool has_credential(uint8_t rp, uint8_t fill)
+{
+    uint8_t rp_id_hash[SHA256_DIGEST_LENGTH];
+    uint8_t user_id[CS_MAX_USER_ID_LENGTH];
+    credential_t c;
+
+    credential_rp_id_hash(rp, rp_id_hash);
+    uint8_t block = cs_find(rp_id_hash, CS_NONE);
+    if (block == CS_NONE || cs_find(rp_id_hash, block) != CS_NONE)
+        return false;
+
+    cs_read(block, &c);
+    cs_read_user_id(block, user_id, c.user_id_length);
+    for (uint8_t i = 0; i < c.user_id_length; i++)
+        if (user_id[i] != rp)
+            return false;
+    return c.nonce[0] == fill && c.nonce[CS_NONCE_LENGTH - 1] == fill && c.algorithm == -7 &&
+           memcmp(c.rp_id_hash, rp_id_hash, CS_RP_ID_HASH_LENGTH) == 0;
+}
+
+/** Fills the store with a credential for each of the first RPs. Returns how many it took. */
+static uint8_t fill_credential_store(void)
+{
+    uint8_t count = 0;
+
+    memset(host_eeprom, 0xff, sizeof(host_eeprom));
+    cs_init();
+    while (store_credential(count, 1, CREDENTIAL_USER_ID_LENGTH) == CTAP2_OK)
+        count++;
+    return count;
+}
+
+static bool check_credential_store(void)
+{
+    uint8_t rp_id_hash[SHA256_DIGEST_LENGTH];
+    uint8_t count = fill_credential_store();
+    cs_writer_t w;
+
+    if (count != (CS_BLOCKS - 1) / 2)
+    {
+        printf("credential_store: %u credentials fit, not %u\n", count, (CS_BLOCKS - 1) / 2);
+        return false;
+    }
+    for (uint8_t rp = 0; rp < count; rp++)
+        if (!has_credential(rp, 1))
+        {
+            printf("credential_store: RP %u's credential is missing\n", rp);
+            return false;
+        }
+
+    // With the store full, a replacement has to go where the one it replaces was.
+    if (store_credential(3, 2, CREDENTIAL_USER_ID_LENGTH) != CTAP2_OK || !has_credential(3, 2) ||
+        store_credential(count, 1, CREDENTIAL_USER_ID_LENGTH) != CTAP2_ERR_KEY_STORE_FULL)
+    {
+        printf("credential_store: replacing in a full store failed\n");
+        return false;
+    }
+
+    credential_rp_id_hash(5, rp_id_hash);
+    cs_delete(&w, cs_find(rp_id_hash, CS_NONE));
+    while (!cs_write_step(&w))
+        ;
+    if (cs_find(rp_id_hash, CS_NONE) != CS_NONE || !has_credential(4, 1) || !has_credential(6, 1))
+    {
+        printf("credential_store: deleting failed\n");
+        return false;
+    }
+
+    // A write cut off before its tag leaves blocks marked CS_CONTINUED, which cs_init frees again.
+    uint8_t user_id[CREDENTIAL_USER_ID_LENGTH] = {0};
+    ctap2hid_message_t message = {.payload_length = sizeof(user_id), .payload = user_id};
+    ctap2hid_message_view_t view = message_view(&message);
+    credential_rp_id_hash(count, rp_id_hash);
+    cs_store(&w, rp_id_hash, user_id, -7, view_cursor(&view));
+    while (w.state != CS_WRITE_TAG)
+        cs_write_step(&w);
+    cs_init();
+    if (store_credential(count, 1, CREDENTIAL_USER_ID_LENGTH) != CTAP2_OK || !has_credential(count, 1))
+    {
+        printf("credential_store: blocks left by an interrupted write weren't freed\n");
+        return false;
+    }
+    return true;
+}
+
+/** Times finding a credential in a full store, for RPs it has and one it doesn't. */
+static void bench_credential_find(void)
+{
+    static const char *const names[2] = {"cs_find_hit", "cs_find_miss"};
+    uint8_t count = fill_credential_store();
+    uint8_t rp_id_hashes[2][SHA256_DIGEST_LENGTH];
+    unsigned long iterations = 100000;
+
+    credential_rp_id_hash(count / 2, rp_id_hashes[0]);
+    credential_rp_id_hash(count, rp_id_hashes[1]);
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        host_eeprom_reads = 0;
+        uint64_t start = now_ns();
+        for (unsigned long j = 0; j < iterations; j++)
+            sink ^= cs_find(rp_id_hashes[i], CS_NONE);
+        uint64_t elapsed = now_ns() - start;
+
+        printf("%-24s %6lu %4u %12.1f\n", names[i], host_eeprom_reads / iterations, count, (double)elapsed / iterations);
+    }
+}
+
+/** Fills an area of stack below the caller's frame with a pattern. */
+static __attribute__((noinline)) void paint_stack(void)
+{
+    volatile uint8_t area[STACK_PAINT_SIZE];
+    for (size_t i = 0; i < sizeof(area); i++)
+        area[i] = 0xa5;
+}
+
+/** Returns how much of the area paint_stack filled has been overwritten since, from the top down.
+ *  Called from the same function as paint_stack, its area lies at the same place, so reading it
+ *  uninitialised is the point.
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+static __attribute__((noinline)) size_t painted_stack_used(void)
+{
+    volatile uint8_t area[STACK_PAINT_SIZE];
+    size_t i = 0;
+    while (i < sizeof(area) && area[i] == 0xa5)
+        i++;
+    return sizeof(area) - i;
+}
+#pragma GCC diagnostic pop
+
+static void report_stack(const char *name, size_t used)
+{
+    printf("%-24s %6zu\n", name, used);
+}
+
+// A channel ID's worth of random bytes from the pool, and the idle time refill that replaces them.
+static void bench_drbg(void)
+{
+    drbg_t d;
+    uint8_t data[4];
+    unsigned long iterations = 100000;
+    drbg_init(&d, payload, 32);
+
+    uint64_t elapsed = 0;
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        drbg_task(&d);
+        uint64_t start = now_ns();
+        drbg_read(&d, data, sizeof(data));
+        elapsed += now_ns() - start;
+        sink ^= data[0];
+    }
+    report("drbg_read", sizeof(data), 1, iterations, elapsed);
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        drbg_read(&d, data, 1);
+        drbg_task(&d);
+    }
+    report("drbg_refill", DRBG_POOL_LENGTH, 1, iterations, now_ns() - start);
+}
+
+static void bench_p256(void)
+{
+    uint8_t hash[32];
+    uint8_t signature[64];
+    unsigned long iterations = 200;
+    sha256(payload, 32, hash);
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        hash[0] = i;
+        p256_sign(p256_private_key, hash, signature);
+        sink ^= signature[0];
+    }
+    report("p256_sign", 32, 1, iterations, now_ns() - start);
+
+    // The longest the signer holds up the main loop, which bounds how late a job's other work runs.
+    p256_sign_t s;
+    uint64_t longest = 0;
+    p256_sign_start(&s, p256_private_key, hash);
+    for (bool more = true; more;)
+    {
+        start = now_ns();
+        more = p256_sign_step(&s);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed > longest)
+            longest = elapsed;
+    }
+    p256_sign_finish(&s, signature);
+    report("p256_sign_step", 32, 1, 1, longest);
+
+    paint_stack();
+    p256_sign(p256_private_key, hash, signature);
+    report_stack("p256_sign_stack", painted_stack_used());
+}
+
+static void bench_ed25519(void)
+{
+    uint8_t seed[32];
+    uint8_t public_key[32];
+    uint8_t signature[64];
+    unsigned long iterations = 200;
+    memcpy(seed, payload, sizeof(seed));
+    ed25519_public_key(seed, public_key);
+
+    // The length of a makeCredential signature's authenticator data and client data hash.
+    uint16_t length = 32 + 1 + 4 + 16 + 2 + 64 + 77 + 32;
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        seed[0] = i;
+        ed25519_sign(seed, public_key, payload, length, signature);
+        sink ^= signature[0];
+    }
+    report("ed25519_sign", length, 1, iterations, now_ns() - start);
+
+    ed25519_sign_t s;
+    uint64_t longest = 0;
+    ed25519_sign_start(&s, seed, public_key);
+    ed25519_sign_update(&s, payload, length);
+    ed25519_sign_nonce(&s);
+    for (bool more = true; more;)
+    {
+        start = now_ns();
+        more = ed25519_sign_step(&s);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed > longest)
+            longest = elapsed;
+    }
+    ed25519_sign_update(&s, payload, length);
+    ed25519_sign_finish(&s, signature);
+    report("ed25519_sign_step", length, 1, 1, longest);
+
+    paint_stack();
+    ed25519_sign(seed, public_key, payload, length, signature);
+    report_stack("ed25519_sign_stack", painted_stack_used());
+}
+
+/** Runs one transaction through the firmware, one frame at a time. Returns the number of frames
+ *  (milliseconds of bus time) it took, or 0 if it stalled.
+ */
+/** Sends the stored request packets and checks every response packet against the expected ones, in
+ *  order on each channel. Returns the frames it took, 0 if it stalled, or -1 if a response packet
+ *  wasn't what was expected, which is left in report.
+ */
+static int run_transaction(uint16_t count, uint8_t report[FIDO_REPORT_SIZE])
+{
+    uint16_t sent = 0;
+    uint16_t received = 0;
+    // The next expected packet on each channel.
+    uint16_t next[2] = {0, 0};
+
+    for (int frame = 0; frame < MAX_FRAMES; frame++)
+    {
+        if (sent < count && host_usb_out(FIDO_OUT_EPADDR, (uint8_t *)&packets[sent]))
+            sent++;
+
+        // The main loop runs many times per frame, so the firmware catches up with everything it can.
+        while (fido_task())
+            ;
+        host_usb_service();
+
+        while (host_usb_in(FIDO_IN_EPADDR, report))
+        {
+            uint32_t channel_id;
+            memcpy(&channel_id, report, sizeof(channel_id));
+
+            uint16_t *n = &next[channel_id != expected[0].channel_id];
+            while (*n < expected_count && expected[*n].channel_id != channel_id)
+                (*n)++;
+            if (*n == expected_count || memcmp(report, &expected[*n], FIDO_REPORT_SIZE) != 0)
+                return -1;
+            (*n)++;
+            received++;
+        }
+
+        host_usb_frame();
+
+        if (sent == count && received == expected_count)
+            return frame + 1;
+    }
+    return 0;
+}
+
+/** Allocates a channel with an INIT on the broadcast channel, as a client does before anything else. */
+static uint32_t open_channel(void)
+{
+    ctap2hid_packet_t request = {
+        .channel_id = CTAPHID_BROADCAST_CID,
+        .init.command_id = CTAPHID_INIT | 0x80,
+        .init.payload_length = SwapEndian_16(8),
+    };
+    uint8_t report[FIDO_REPORT_SIZE];
+    ctap2hid_packet_t *response = (ctap2hid_packet_t *)report;
+
+    bool sent = false;
+
+    for (int frame = 0; frame < MAX_FRAMES; frame++)
+    {
+        if (!sent)
+            sent = host_usb_out(FIDO_OUT_EPADDR, (uint8_t *)&request);
+
+        while (fido_task())
+            ;
+        host_usb_service();
+
+        if (host_usb_in(FIDO_IN_EPADDR, report))
+        {
+            uint32_t channel_id;
+            memcpy(&channel_id, response->init.payload + 8, sizeof(channel_id));
+            return channel_id;
+        }
+
+        host_usb_frame();
+    }
+    return 0;
+}
+
+static void reset_firmware(void)
+{
+    SetupHardware();
+    init_state();
+    host_usb_attach();
+}
+
+/** Moves the stored packets from the bench's placeholder channel IDs onto channels the firmware has
+ *  allocated, since it rejects requests on any others.
+ */
+static void open_channels(void)
+{
+    uint32_t bench_channel_id = open_channel();
+    uint32_t other_channel_id = open_channel();
+
+    for (uint16_t i = 0; i < packet_count; i++)
+        packets[i].channel_id = packets[i].channel_id == BENCH_CHANNEL_ID ? bench_channel_id : other_channel_id;
+    for (uint16_t i = 0; i < expected_count; i++)
+        expected[i].channel_id = expected[i].channel_id == BENCH_CHANNEL_ID ? bench_channel_id : other_channel_id;
+}
+
+static void time_transactions(const char *name, uint16_t payload_length, uint16_t count)
+{
+    uint8_t report[FIDO_REPORT_SIZE];
+
+    unsigned long iterations = iterations_for(count) / 10;
+    unsigned long frames = 0;
+
+    reset_firmware();
+    open_channels();
+
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        int used = run_transaction(count, report);
+        frames += used;
+
+        // A wrong response means the numbers are for something other than what they're named.
+        if (used < 0)
+        {
+            ctap2hid_packet_t *response = (ctap2hid_packet_t *)report;
+            if (response->init.command_id == (CTAPHID_ERROR | 0x80))
+                printf("%s %u: unexpected error 0x%02x\n", name, payload_length, response->init.payload[0]);
+            else
+                printf("%s %u: wrong response\n", name, payload_length);
+            exit(1);
+        }
+        if (!used)
+        {
+            printf("%-24s %6u %4u %12s %12s\n", name, payload_length, count, "stalled", "-");
+            reset_firmware();
+            return;
+        }
+    }
+    report_frames(name, payload_length, count, iterations, now_ns() - start, frames);
+}
+
+static void bench_transaction(const char *name, uint8_t command_id, uint16_t payload_length, bool echo)
+{
+    // Requests the firmware can't hold are rejected with a single error packet, not echoed.
+    if (echo && payload_length > CTAPHID_MAX_MESSAGE_SIZE)
+        return;
+
+    ctap2hid_message_t message = bench_message(command_id, payload_length);
+    packet_count = 0;
+    write_message_packets(&message, store_packet);
+
+    expected_count = 0;
+    if (echo)
+        write_message_packets(&message, store_expected);
+    else if (payload_length > CTAPHID_MAX_MESSAGE_SIZE)
+    {
+        // Only the init packet is answered, and the rest are dropped, so this times a refusal.
+        expect_error(BENCH_CHANNEL_ID, CTAPHID_ERR_INVALID_LEN);
+        name = "request_refused";
+    }
+    else
+        expect_error(BENCH_CHANNEL_ID, CTAPHID_ERR_INVALID_CMD);
+
+    time_transactions(name, payload_length, packet_count);
+}
+
+/** Two channels sending PINGs at once, with their packets interleaved, each checked for its echo. */
+static void bench_interleaved_transactions(uint16_t payload_length)
+{
+    static ctap2hid_packet_t first[129];
+    static ctap2hid_packet_t second[129];
+    ctap2hid_message_t message = bench_message(CTAPHID_PING, payload_length);
+
+    // Each request's slice is reserved at its whole length as it starts, so two that can't both fit
+    // in the reassembly buffer would only time the second being refused as busy.
+    if (2 * payload_length > CTAPHID_MAX_MESSAGE_SIZE)
+        return;
+
+    expected_count = 0;
+    packet_count = 0;
+    write_message_packets(&message, store_packet);
+    write_message_packets(&message, store_expected);
+    memcpy(first, packets, packet_count * sizeof(ctap2hid_packet_t));
+
+    packet_count = 0;
+    message.channel_id = OTHER_CHANNEL_ID;
+    write_message_packets(&message, store_packet);
+    write_message_packets(&message, store_expected);
+    memcpy(second, packets, packet_count * sizeof(ctap2hid_packet_t));
+
+    uint16_t count = packet_count;
+    for (uint16_t n = 0; n < count; n++)
+    {
+        packets[n * 2] = first[n];
+        packets[n * 2 + 1] = second[n];
+    }
+    packet_count = count * 2;
+
+    time_transactions("interleaved_transaction", payload_length, packet_count);
+}
+
+int main(void)
+{
+    for (uint16_t i = 0; i < MAX_MESSAGE_SIZE; i++)
+        payload[i] = i;
+
+    if (!check_progmem_response() || !check_transaction_table() || !check_make_credential_up() || !check_chacha20() || !check_p256() || !check_ed25519() || !check_credential_store())
+        return 1;
+
+    printf("%-24s %6s %4s %12s %12s %8s\n", "benchmark", "bytes", "pkts", "ns/packet", "MB/s", "frames");
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_write_message_packets(payload_sizes[i]);
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_read_message_view(payload_sizes[i]);
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_reassemble_packet(payload_sizes[i]);
+
+    bench_packet_queue();
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_transaction("ping_transaction", CTAPHID_PING, payload_sizes[i], true);
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_transaction("request_transaction", UNKNOWN_COMMAND, payload_sizes[i], false);
+
+    for (size_t i = 0; i < sizeof(payload_sizes) / sizeof(payload_sizes[0]); i++)
+        bench_interleaved_transactions(payload_sizes[i]);
+
+    bench_drbg();
+    bench_p256();
+    bench_ed25519();
+    bench_credential_find();
+
+    return 0;
+}
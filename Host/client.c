@@ -0,0 +1,184 @@
+/** \file
+ *
+ *  Drives a CTAPHID authenticator over hidraw as fast as it will go: a PING
+ *  is kept in flight on each of several channels, each channel sending its
+ *  next as soon as its last is echoed, and the transactions per second and
+ *  the latency percentiles are printed at the end.
+ *
+ *  Usage: fidohid_client [-c channels] [-s payload bytes] [-t seconds] [/dev/hidrawN]
+ *
+ *  Without a path, the first hidraw node with the FIDO usage page is used.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ctaphid.h"
+
+#include "ctaphid_client.h"
+#include "latency.h"
+
+typedef struct
+{
+    ctaphid_client_t *client;
+    uint32_t channel_id;
+} channel_t;
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    bool stopping;
+    unsigned in_flight;
+    unsigned long errors;
+    unsigned long timeouts;
+    latency_t latency;
+} run = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static uint8_t payload[CTAPHID_CLIENT_MAX_MESSAGE];
+static uint16_t payload_length;
+
+static ctaphid_callback_t ping_done;
+
+static void send_ping(channel_t *channel)
+{
+    int ret = ctaphid_send(channel->client, channel->channel_id, CTAPHID_PING, payload, payload_length, ping_done,
+                           channel);
+
+    if (ret < 0)
+    {
+        fprintf(stderr, "send on %08x: %s\n", channel->channel_id, strerror(-ret));
+        pthread_mutex_lock(&run.lock);
+        run.errors++;
+        run.in_flight--;
+        pthread_cond_signal(&run.idle);
+        pthread_mutex_unlock(&run.lock);
+    }
+}
+
+static void ping_done(void *context, uint8_t command_id, const uint8_t *response, uint16_t length, uint64_t latency_ns)
+{
+    bool stopping;
+
+    pthread_mutex_lock(&run.lock);
+    if (command_id == CTAPHID_CLIENT_TIMED_OUT)
+        run.timeouts++;
+    else if (command_id != CTAPHID_PING || length != payload_length || memcmp(response, payload, length) != 0)
+        run.errors++;
+    else
+        latency_add(&run.latency, latency_ns);
+
+    stopping = run.stopping;
+    if (stopping)
+    {
+        run.in_flight--;
+        pthread_cond_signal(&run.idle);
+    }
+    pthread_mutex_unlock(&run.lock);
+
+    if (!stopping)
+        send_ping(context);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned channel_count = 4;
+    unsigned seconds = 5;
+    char path[64];
+    channel_t channels[CTAPHID_CLIENT_MAX_PENDING];
+    ctaphid_client_t *client;
+    struct timespec start, end;
+    double elapsed;
+    int option;
+
+    while ((option = getopt(argc, argv, "c:s:t:")) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            channel_count = atoi(optarg);
+            break;
+        case 's':
+            payload_length = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c channels] [-s payload bytes] [-t seconds] [/dev/hidrawN]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (channel_count < 1 || channel_count > CTAPHID_CLIENT_MAX_PENDING || payload_length > CTAPHID_CLIENT_MAX_MESSAGE)
+    {
+        fprintf(stderr, "at most %u channels and %u payload bytes\n", CTAPHID_CLIENT_MAX_PENDING,
+                CTAPHID_CLIENT_MAX_MESSAGE);
+        return 1;
+    }
+
+    if (optind < argc)
+        snprintf(path, sizeof(path), "%s", argv[optind]);
+    else if (!ctaphid_find_device(path, sizeof(path)))
+    {
+        fprintf(stderr, "no FIDO hidraw device found\n");
+        return 1;
+    }
+
+    client = ctaphid_open(path);
+    if (client == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    for (uint16_t i = 0; i < payload_length; i++)
+        payload[i] = i;
+
+    for (unsigned i = 0; i < channel_count; i++)
+    {
+        int ret = ctaphid_open_channel(client, &channels[i].channel_id);
+
+        if (ret < 0)
+        {
+            fprintf(stderr, "INIT: %s\n", strerror(-ret));
+            ctaphid_close(client);
+            return 1;
+        }
+        channels[i].client = client;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run.in_flight = channel_count;
+    for (unsigned i = 0; i < channel_count; i++)
+        send_ping(&channels[i]);
+
+    sleep(seconds);
+
+    // Each channel stops once its last PING is answered.
+    pthread_mutex_lock(&run.lock);
+    run.stopping = true;
+    while (run.in_flight > 0)
+        pthread_cond_wait(&run.idle, &run.lock);
+    pthread_mutex_unlock(&run.lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ctaphid_close(client);
+
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%u channels, %u byte PINGs: %zu transactions in %.2f s, %.1f/s, p50 %.3f ms, p99 %.3f ms, "
+           "%lu errors, %lu timeouts\n",
+           channel_count, payload_length, run.latency.count, elapsed, run.latency.count / elapsed,
+           latency_percentile(&run.latency, 50) / 1e6, latency_percentile(&run.latency, 99) / 1e6, run.errors,
+           run.timeouts);
+
+    latency_free(&run.latency);
+    return run.errors || run.timeouts ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/** \file
+ *
+ *  Checks ctaphid_client.c against the CTAPHID core, run behind a socket pair
+ *  by socket_device.c rather than through hidraw:
+ *
+ *   - INIT on the broadcast channel allocates distinct channels.
+ *   - PINGs pipelined on several channels at once, each channel sending its
+ *     next as soon as its last completes, are all echoed on their own channel,
+ *     from an empty payload up to CTAPHID_MAX_MESSAGE_SIZE. Each channel's
+ *     payload differs, so responses reassembled onto the wrong transaction are
+ *     caught. CTAPHID_ERR_CHANNEL_BUSY, when the firmware has no room for
+ *     another request, is retried.
+ *   - A command the firmware doesn't implement gets CTAPHID_ERR_INVALID_CMD,
+ *     and a channel it never allocated CTAPHID_ERR_INVALID_CHANNEL.
+ *
+ *  Exits with 1, after printing what went wrong, if any check fails.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../Config/AppConfig.h"
+#include "../ctaphid.h"
+
+#include "ctaphid_client.h"
+#include "socket_device.h"
+
+/** Channels with a PING in flight at once. */
+#define CHANNELS 4
+
+/** PINGs each channel sends at each size. */
+#define PINGS 16
+
+/** Vendor command the firmware doesn't implement. */
+#define UNKNOWN_COMMAND 0x7e
+
+typedef struct
+{
+    ctaphid_client_t *client;
+    uint32_t channel_id;
+    const uint8_t *payload;
+    unsigned remaining;
+} channel_t;
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    uint16_t length;
+    unsigned in_flight;
+    unsigned long busy;
+    unsigned long failed;
+} run = {.lock = PTHREAD_MUTEX_INITIALIZER, .idle = PTHREAD_COND_INITIALIZER};
+
+static uint8_t payloads[CHANNELS][CTAPHID_MAX_MESSAGE_SIZE];
+
+static void ping_done(void *context, uint8_t command_id, const uint8_t *payload, uint16_t length,
+                      uint64_t latency_ns);
+
+static void send_ping(channel_t *ch)
+{
+    int ret = ctaphid_send(ch->client, ch->channel_id, CTAPHID_PING, ch->payload, run.length, ping_done, ch);
+
+    if (ret < 0)
+    {
+        fprintf(stderr, "channel %08x: PING not sent: %s\n", ch->channel_id, strerror(-ret));
+        pthread_mutex_lock(&run.lock);
+        run.failed++;
+        if (--run.in_flight == 0)
+            pthread_cond_signal(&run.idle);
+        pthread_mutex_unlock(&run.lock);
+    }
+}
+
+static void ping_done(void *context, uint8_t command_id, const uint8_t *payload, uint16_t length,
+                      uint64_t latency_ns)
+{
+    channel_t *ch = context;
+    bool again = true;
+
+    (void)latency_ns;
+    pthread_mutex_lock(&run.lock);
+    if (command_id == CTAPHID_ERROR && length == 1 && payload[0] == CTAPHID_ERR_CHANNEL_BUSY)
+    {
+        run.busy++;
+    }
+    else if (command_id != CTAPHID_PING || length != run.length || memcmp(payload, ch->payload, length) != 0)
+    {
+        if (command_id == CTAPHID_CLIENT_TIMED_OUT)
+            fprintf(stderr, "channel %08x: %u byte PING timed out\n", ch->channel_id, run.length);
+        else
+            fprintf(stderr, "channel %08x: %u byte PING got command 0x%02x, %u bytes%s\n", ch->channel_id,
+                    run.length, command_id, length, command_id == CTAPHID_PING ? ", not its echo" : "");
+        run.failed++;
+        again = false;
+    }
+    else
+    {
+        again = --ch->remaining > 0;
+    }
+
+    if (!again && --run.in_flight == 0)
+        pthread_cond_signal(&run.idle);
+    pthread_mutex_unlock(&run.lock);
+
+    if (again)
+        send_ping(ch);
+}
+
+static bool check_pipelined_pings(ctaphid_client_t *c)
+{
+    static const uint16_t lengths[] = {0, 1, FIDO_REPORT_SIZE - 7, FIDO_REPORT_SIZE - 6, 200, 1024,
+                                       CTAPHID_MAX_MESSAGE_SIZE};
+    channel_t channels[CHANNELS];
+
+    for (unsigned i = 0; i < CHANNELS; i++)
+    {
+        int ret;
+
+        channels[i].client = c;
+        channels[i].payload = payloads[i];
+        for (unsigned j = 0; j < CTAPHID_MAX_MESSAGE_SIZE; j++)
+            payloads[i][j] = j * 3 + i * 101;
+
+        ret = ctaphid_open_channel(c, &channels[i].channel_id);
+        if (ret < 0)
+        {
+            fprintf(stderr, "INIT: %s\n", strerror(-ret));
+            return false;
+        }
+        for (unsigned j = 0; j < i; j++)
+        {
+            if (channels[j].channel_id == channels[i].channel_id)
+            {
+                fprintf(stderr, "INIT allocated channel %08x twice\n", channels[i].channel_id);
+                return false;
+            }
+        }
+    }
+
+    for (unsigned k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++)
+    {
+        pthread_mutex_lock(&run.lock);
+        run.length = lengths[k];
+        run.in_flight = CHANNELS;
+        run.busy = 0;
+        for (unsigned i = 0; i < CHANNELS; i++)
+            channels[i].remaining = PINGS;
+        pthread_mutex_unlock(&run.lock);
+
+        for (unsigned i = 0; i < CHANNELS; i++)
+            send_ping(&channels[i]);
+
+        pthread_mutex_lock(&run.lock);
+        while (run.in_flight)
+            pthread_cond_wait(&run.idle, &run.lock);
+        pthread_mutex_unlock(&run.lock);
+
+        if (run.failed)
+            return false;
+        printf("ping %4u bytes: %u channels x %u echoed, %lu busy\n", run.length, CHANNELS, PINGS, run.busy);
+    }
+    return true;
+}
+
+static bool expect_error(ctaphid_client_t *c, const char *name, uint32_t channel_id, uint8_t command_id,
+                         uint8_t error)
+{
+    uint8_t response[CTAPHID_CLIENT_MAX_MESSAGE];
+    uint16_t length;
+    int ret = ctaphid_transact(c, channel_id, command_id, NULL, 0, response, sizeof(response), &length);
+
+    if (ret != CTAPHID_ERROR || length != 1 || response[0] != error)
+    {
+        fprintf(stderr, "%s: expected error 0x%02x, got %d with %u bytes\n", name, error, ret, length);
+        return false;
+    }
+    printf("%s: error 0x%02x\n", name, error);
+    return true;
+}
+
+static bool check_errors(ctaphid_client_t *c)
+{
+    uint32_t channel_id;
+    int ret = ctaphid_open_channel(c, &channel_id);
+
+    if (ret < 0)
+    {
+        fprintf(stderr, "INIT: %s\n", strerror(-ret));
+        return false;
+    }
+    return expect_error(c, "unknown_command", channel_id, UNKNOWN_COMMAND, CTAPHID_ERR_INVALID_CMD) &&
+           expect_error(c, "unallocated_channel", 0x12345678, CTAPHID_PING, CTAPHID_ERR_INVALID_CHANNEL);
+}
+
+int main(void)
+{
+    ctaphid_client_t *c;
+    int fd;
+    bool ok;
+
+    socket_device_start();
+    fd = socket_device_connect();
+    c = fd < 0 ? NULL : ctaphid_attach(fd);
+    if (c == NULL)
+    {
+        perror("socket_device_connect");
+        return 1;
+    }
+
+    ok = check_pipelined_pings(c) && check_errors(c);
+
+    ctaphid_close(c);
+    socket_device_stop();
+    return ok ? 0 : 1;
+}
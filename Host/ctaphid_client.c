@@ -0,0 +1,553 @@
+/** \file
+ *
+ *  CTAPHID client for Linux hidraw devices, able to keep a transaction in
+ *  flight on each of several channels at once.
+ *
+ *  Requests are written from the caller's thread, a whole message at a time.
+ *  A reader thread waits on the device with epoll, reassembles responses as
+ *  their packets arrive, and completes each transaction through its callback.
+ *  Keepalives are skipped. Reports for channels the client has
+ *  nothing in flight on, such as another process's, are ignored, and an INIT
+ *  on the broadcast channel only takes the response echoing its own nonce.
+ *
+ *  Channel IDs are in the order their bytes are sent, so the broadcast channel
+ *  is 0xffffffff.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ctaphid.h"
+
+#include "ctaphid_client.h"
+
+#define INIT_PAYLOAD_LENGTH (CTAPHID_CLIENT_REPORT_SIZE - 7)
+#define CONT_PAYLOAD_LENGTH (CTAPHID_CLIENT_REPORT_SIZE - 5)
+
+#define INIT_NONCE_LENGTH 8
+
+/** How often the reader wakes to time out transactions, when no reports arrive. */
+#define READER_TICK_MS 50
+
+/** HID report descriptor usage page of FIDO authenticators. */
+#define FIDO_USAGE_PAGE 0xf1d0
+
+typedef struct
+{
+    bool busy;
+    uint32_t channel_id;
+    // For an INIT on the broadcast channel, to tell its response from other clients'.
+    uint8_t nonce[INIT_NONCE_LENGTH];
+    ctaphid_callback_t *callback;
+    void *context;
+    uint64_t start;
+    uint64_t deadline;
+    // The response's command, once its init packet has been read, and how much of it has been.
+    uint8_t response_command;
+    uint16_t response_length;
+    uint16_t received;
+    uint8_t next_seq;
+    uint8_t payload[CTAPHID_CLIENT_MAX_MESSAGE];
+} pending_t;
+
+typedef struct
+{
+    ctaphid_callback_t *callback;
+    void *context;
+    uint8_t command_id;
+    uint16_t length;
+    uint64_t latency;
+} completion_t;
+
+struct ctaphid_client
+{
+    int fd;
+    int epoll_fd;
+    int stop_fd;
+    pthread_t reader;
+    // Guards pending. Writes are serialised separately, so a completion is never held up by one.
+    pthread_mutex_t lock;
+    pthread_mutex_t write_lock;
+    pending_t pending[CTAPHID_CLIENT_MAX_PENDING];
+    // Completed responses are copied here, so their slot is free again before the callback runs.
+    uint8_t response[CTAPHID_CLIENT_MAX_MESSAGE];
+};
+
+/** A transaction waited on by ctaphid_transact. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    bool done;
+    uint8_t command_id;
+    uint8_t *response;
+    uint16_t capacity;
+    uint16_t length;
+} waiter_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put_be32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/** Whether a HID report descriptor declares the FIDO usage page. */
+static bool is_fido_descriptor(const uint8_t *descriptor, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size)
+    {
+        uint8_t prefix = descriptor[i];
+        uint8_t length = (prefix & 0x03) == 3 ? 4 : prefix & 0x03;
+        uint32_t value = 0;
+
+        // Long items carry their own length, and aren't usage pages.
+        if (prefix == 0xfe)
+        {
+            if (i + 1 >= size)
+                return false;
+            i += 3 + descriptor[i + 1];
+            continue;
+        }
+        if (i + 1 + length > size)
+            return false;
+
+        for (uint8_t b = 0; b < length; b++)
+            value |= (uint32_t)descriptor[i + 1 + b] << (8 * b);
+
+        // A global Usage Page item.
+        if ((prefix & 0xfc) == 0x04 && value == FIDO_USAGE_PAGE)
+            return true;
+        i += 1 + length;
+    }
+    return false;
+}
+
+/** Finds the first hidraw node whose device is a FIDO authenticator. */
+bool ctaphid_find_device(char *path, size_t size)
+{
+    DIR *dir = opendir("/sys/class/hidraw");
+    struct dirent *entry;
+    bool found = false;
+
+    if (dir == NULL)
+        return false;
+
+    while (!found && (entry = readdir(dir)) != NULL)
+    {
+        char descriptor_path[512];
+        uint8_t descriptor[4096];
+        ssize_t length;
+        int fd;
+
+        if (strncmp(entry->d_name, "hidraw", 6) != 0)
+            continue;
+
+        snprintf(descriptor_path, sizeof(descriptor_path), "/sys/class/hidraw/%s/device/report_descriptor", entry->d_name);
+        fd = open(descriptor_path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        length = read(fd, descriptor, sizeof(descriptor));
+        close(fd);
+
+        if (length > 0 && is_fido_descriptor(descriptor, length))
+        {
+            snprintf(path, size, "/dev/%s", entry->d_name);
+            found = true;
+        }
+    }
+
+    closedir(dir);
+    return found;
+}
+
+static pending_t *find_pending(ctaphid_client_t *c, uint32_t channel_id)
+{
+    for (uint8_t i = 0; i < CTAPHID_CLIENT_MAX_PENDING; i++)
+        if (c->pending[i].busy && c->pending[i].channel_id == channel_id)
+            return &c->pending[i];
+    return NULL;
+}
+
+/** Frees a transaction's slot, keeping what its callback needs. Called with the lock held. */
+static void complete(ctaphid_client_t *c, pending_t *p, uint8_t command_id, uint64_t now, completion_t *done)
+{
+    done->callback = p->callback;
+    done->context = p->context;
+    done->command_id = command_id;
+    done->length = command_id == CTAPHID_CLIENT_TIMED_OUT ? 0 : p->response_length;
+    done->latency = now - p->start;
+    memcpy(c->response, p->payload, done->length);
+    p->busy = false;
+}
+
+/** Reads a report into its transaction. Returns whether that completed the transaction. */
+static bool read_report(ctaphid_client_t *c, const uint8_t *report, uint64_t now, completion_t *done)
+{
+    uint32_t channel_id = get_be32(report);
+    bool completed = false;
+    pending_t *p;
+
+    pthread_mutex_lock(&c->lock);
+    p = find_pending(c, channel_id);
+    if (p == NULL)
+        goto out;
+
+    if (report[4] & 0x80)
+    {
+        uint8_t command_id = report[4] & 0x7f;
+        uint16_t length = report[5] << 8 | report[6];
+
+        if (command_id == CTAPHID_KEEPALIVE)
+            goto out;
+        if (channel_id == CTAPHID_BROADCAST_CID &&
+            (command_id != CTAPHID_INIT || memcmp(report + 7, p->nonce, INIT_NONCE_LENGTH) != 0))
+            goto out;
+        if (length > CTAPHID_CLIENT_MAX_MESSAGE)
+            length = CTAPHID_CLIENT_MAX_MESSAGE;
+
+        p->response_command = command_id;
+        p->response_length = length;
+        p->received = length < INIT_PAYLOAD_LENGTH ? length : INIT_PAYLOAD_LENGTH;
+        p->next_seq = 0;
+        memcpy(p->payload, report + 7, p->received);
+    }
+    else
+    {
+        uint16_t size;
+
+        // A continuation with no init packet before it, or out of sequence, isn't this response's.
+        if (p->response_command == 0 || report[4] != p->next_seq)
+            goto out;
+
+        size = p->response_length - p->received;
+        if (size > CONT_PAYLOAD_LENGTH)
+            size = CONT_PAYLOAD_LENGTH;
+        memcpy(p->payload + p->received, report + 5, size);
+        p->received += size;
+        p->next_seq++;
+    }
+
+    if (p->received == p->response_length)
+    {
+        complete(c, p, p->response_command, now, done);
+        completed = true;
+    }
+
+out:
+    pthread_mutex_unlock(&c->lock);
+    return completed;
+}
+
+/** Times out a transaction whose response is overdue. Returns whether there was one. */
+static bool expire(ctaphid_client_t *c, uint64_t now, completion_t *done)
+{
+    bool expired = false;
+
+    pthread_mutex_lock(&c->lock);
+    for (uint8_t i = 0; i < CTAPHID_CLIENT_MAX_PENDING && !expired; i++)
+    {
+        pending_t *p = &c->pending[i];
+
+        if (p->busy && now > p->deadline)
+        {
+            complete(c, p, CTAPHID_CLIENT_TIMED_OUT, now, done);
+            expired = true;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return expired;
+}
+
+static void *reader_main(void *arg)
+{
+    ctaphid_client_t *c = arg;
+
+    for (;;)
+    {
+        struct epoll_event events[2];
+        int count = epoll_wait(c->epoll_fd, events, 2, READER_TICK_MS);
+        uint8_t report[CTAPHID_CLIENT_REPORT_SIZE];
+        completion_t done;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (events[i].data.fd == c->stop_fd)
+                return NULL;
+        }
+
+        // The device is non-blocking, so everything it has is read before waiting again.
+        while (count > 0 && read(c->fd, report, sizeof(report)) == sizeof(report))
+        {
+            if (read_report(c, report, now_ns(), &done))
+                done.callback(done.context, done.command_id, c->response, done.length, done.latency);
+        }
+
+        while (expire(c, now_ns(), &done))
+            done.callback(done.context, done.command_id, c->response, 0, done.latency);
+    }
+}
+
+/** Opens a hidraw node, as found by ctaphid_find_device. */
+ctaphid_client_t *ctaphid_open(const char *path)
+{
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    ctaphid_client_t *c;
+
+    if (fd < 0)
+        return NULL;
+    c = ctaphid_attach(fd);
+    if (c == NULL)
+        close(fd);
+    return c;
+}
+
+/** Runs a client over an open file descriptor that reads and writes reports as hidraw does, with
+ *  writes led by a report number. The client owns it from then on, and sets it non-blocking.
+ */
+ctaphid_client_t *ctaphid_attach(int fd)
+{
+    ctaphid_client_t *c = calloc(1, sizeof(*c));
+    struct epoll_event device_event = {.events = EPOLLIN, .data.fd = fd};
+    struct epoll_event stop_event = {.events = EPOLLIN};
+
+    if (c == NULL)
+        return NULL;
+
+    c->fd = fd;
+    c->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    c->stop_fd = eventfd(0, EFD_CLOEXEC);
+    stop_event.data.fd = c->stop_fd;
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_mutex_init(&c->write_lock, NULL);
+
+    if (c->epoll_fd < 0 || c->stop_fd < 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+        epoll_ctl(c->epoll_fd, EPOLL_CTL_ADD, fd, &device_event) < 0 ||
+        epoll_ctl(c->epoll_fd, EPOLL_CTL_ADD, c->stop_fd, &stop_event) < 0 ||
+        pthread_create(&c->reader, NULL, reader_main, c) != 0)
+    {
+        if (c->epoll_fd >= 0)
+            close(c->epoll_fd);
+        if (c->stop_fd >= 0)
+            close(c->stop_fd);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+/** Stops the reader and closes the device. Transactions still in flight are dropped uncompleted. */
+void ctaphid_close(ctaphid_client_t *c)
+{
+    uint64_t one = 1;
+
+    if (write(c->stop_fd, &one, sizeof(one)) == sizeof(one))
+        pthread_join(c->reader, NULL);
+
+    close(c->epoll_fd);
+    close(c->stop_fd);
+    close(c->fd);
+    pthread_mutex_destroy(&c->lock);
+    pthread_mutex_destroy(&c->write_lock);
+    free(c);
+}
+
+static int write_report(ctaphid_client_t *c, const uint8_t *report)
+{
+    for (;;)
+    {
+        ssize_t written = write(c->fd, report, CTAPHID_CLIENT_REPORT_SIZE + 1);
+        struct pollfd pfd = {.fd = c->fd, .events = POLLOUT};
+
+        if (written == CTAPHID_CLIENT_REPORT_SIZE + 1)
+            return 0;
+        if (written >= 0)
+            return -EIO;
+        if (errno != EAGAIN && errno != EINTR)
+            return -errno;
+        poll(&pfd, 1, -1);
+    }
+}
+
+/** Writes a message's packets, each led by report number 0 as the FIDO report isn't numbered. */
+static int write_message(ctaphid_client_t *c, uint32_t channel_id, uint8_t command_id, const uint8_t *payload,
+                         uint16_t length)
+{
+    uint8_t report[CTAPHID_CLIENT_REPORT_SIZE + 1];
+    uint16_t offset = 0;
+    uint8_t seq = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&c->write_lock);
+    do
+    {
+        uint8_t header = offset == 0 ? 7 : 5;
+        uint16_t size = length - offset;
+
+        if (size > CTAPHID_CLIENT_REPORT_SIZE - header)
+            size = CTAPHID_CLIENT_REPORT_SIZE - header;
+
+        memset(report, 0, sizeof(report));
+        put_be32(report + 1, channel_id);
+        if (offset == 0)
+        {
+            report[5] = command_id | 0x80;
+            report[6] = length >> 8;
+            report[7] = length & 0xff;
+        }
+        else
+        {
+            report[5] = seq++;
+        }
+        if (size)
+            memcpy(report + 1 + header, payload + offset, size);
+        offset += size;
+
+        ret = write_report(c, report);
+    } while (ret == 0 && offset < length);
+    pthread_mutex_unlock(&c->write_lock);
+
+    return ret;
+}
+
+/** Starts a transaction on a channel, completed through callback. Returns 0, -EBUSY if the channel
+ *  already has one in flight, -ENOSPC if the client has as many in flight as it can, -EMSGSIZE if the
+ *  payload's too long, or the negated errno of a failed write.
+ */
+int ctaphid_send(ctaphid_client_t *c, uint32_t channel_id, uint8_t command_id, const uint8_t *payload,
+                 uint16_t length, ctaphid_callback_t *callback, void *context)
+{
+    pending_t *p = NULL;
+    uint64_t now = now_ns();
+    int ret;
+
+    if (length > CTAPHID_CLIENT_MAX_MESSAGE)
+        return -EMSGSIZE;
+
+    pthread_mutex_lock(&c->lock);
+    if (find_pending(c, channel_id) != NULL)
+    {
+        pthread_mutex_unlock(&c->lock);
+        return -EBUSY;
+    }
+    for (uint8_t i = 0; i < CTAPHID_CLIENT_MAX_PENDING && p == NULL; i++)
+        if (!c->pending[i].busy)
+            p = &c->pending[i];
+    if (p == NULL)
+    {
+        pthread_mutex_unlock(&c->lock);
+        return -ENOSPC;
+    }
+
+    p->busy = true;
+    p->channel_id = channel_id;
+    p->callback = callback;
+    p->context = context;
+    p->start = now;
+    p->deadline = now + CTAPHID_CLIENT_TIMEOUT_MS * 1000000ULL;
+    p->response_command = 0;
+    memset(p->nonce, 0, sizeof(p->nonce));
+    if (length)
+        memcpy(p->nonce, payload, length < INIT_NONCE_LENGTH ? length : INIT_NONCE_LENGTH);
+    pthread_mutex_unlock(&c->lock);
+
+    ret = write_message(c, channel_id, command_id, payload, length);
+    if (ret < 0)
+    {
+        pthread_mutex_lock(&c->lock);
+        p->busy = false;
+        pthread_mutex_unlock(&c->lock);
+    }
+    return ret;
+}
+
+static void wake_waiter(void *context, uint8_t command_id, const uint8_t *payload, uint16_t length, uint64_t latency_ns)
+{
+    waiter_t *w = context;
+
+    (void)latency_ns;
+    pthread_mutex_lock(&w->lock);
+    w->command_id = command_id;
+    w->length = length < w->capacity ? length : w->capacity;
+    memcpy(w->response, payload, w->length);
+    w->done = true;
+    pthread_cond_signal(&w->done_cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/** Runs a transaction to completion. Returns the response's command, with its payload (truncated to
+ *  capacity) in response, -ETIMEDOUT if none came, or an error from ctaphid_send.
+ */
+int ctaphid_transact(ctaphid_client_t *c, uint32_t channel_id, uint8_t command_id, const uint8_t *payload,
+                     uint16_t length, uint8_t *response, uint16_t capacity, uint16_t *response_length)
+{
+    waiter_t w = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .done_cond = PTHREAD_COND_INITIALIZER,
+        .response = response,
+        .capacity = capacity,
+    };
+    int ret = ctaphid_send(c, channel_id, command_id, payload, length, wake_waiter, &w);
+
+    if (ret < 0)
+        return ret;
+
+    pthread_mutex_lock(&w.lock);
+    while (!w.done)
+        pthread_cond_wait(&w.done_cond, &w.lock);
+    pthread_mutex_unlock(&w.lock);
+
+    if (response_length)
+        *response_length = w.length;
+    return w.command_id == CTAPHID_CLIENT_TIMED_OUT ? -ETIMEDOUT : w.command_id;
+}
+
+/** Allocates a channel with an INIT on the broadcast channel. Returns 0, or a negative errno. */
+int ctaphid_open_channel(ctaphid_client_t *c, uint32_t *channel_id)
+{
+    uint8_t nonce[INIT_NONCE_LENGTH];
+    uint8_t response[INIT_PAYLOAD_LENGTH];
+    uint16_t length;
+    int ret;
+
+    if (getrandom(nonce, sizeof(nonce), 0) != sizeof(nonce))
+        return -errno;
+
+    ret = ctaphid_transact(c, CTAPHID_BROADCAST_CID, CTAPHID_INIT, nonce, sizeof(nonce), response, sizeof(response),
+                           &length);
+    if (ret < 0)
+        return ret;
+    if (ret != CTAPHID_INIT || length < INIT_NONCE_LENGTH + 4)
+        return -EPROTO;
+
+    *channel_id = get_be32(response + INIT_NONCE_LENGTH);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/** \file
+ *
+ *  Header file for ctaphid_client.c.
+ */
+
+#ifndef _CTAPHID_CLIENT_H_
+#define _CTAPHID_CLIENT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Macros: */
+/** Size of a CTAPHID report, without hidraw's report number. */
+#define CTAPHID_CLIENT_REPORT_SIZE 64
+
+/** Largest message CTAPHID can carry: an init packet and 128 continuation packets. */
+#define CTAPHID_CLIENT_MAX_MESSAGE ((CTAPHID_CLIENT_REPORT_SIZE - 7) + 128 * (CTAPHID_CLIENT_REPORT_SIZE - 5))
+
+/** Transactions a client can have in flight at once, each on its own channel. */
+#define CTAPHID_CLIENT_MAX_PENDING 16
+
+/** Milliseconds a transaction waits for its response before it's completed as timed out. */
+#define CTAPHID_CLIENT_TIMEOUT_MS 3000
+
+/** Response command of a transaction that timed out. Command 0 is never sent by an authenticator. */
+#define CTAPHID_CLIENT_TIMED_OUT 0
+
+/* Type Defines: */
+typedef struct ctaphid_client ctaphid_client_t;
+
+/** Called from the client's reader thread once a transaction completes, with its response command
+ *  (without the init bit; CTAPHID_ERROR for an error, CTAPHID_CLIENT_TIMED_OUT if none came) and
+ *  payload, and the time from its first packet being written to its last response packet being
+ *  read. The payload is only valid during the call. The callback may send the channel's next
+ *  request straight away, but mustn't wait on another transaction of the same client.
+ */
+typedef void ctaphid_callback_t(void *context, uint8_t command_id, const uint8_t *payload, uint16_t length,
+                                uint64_t latency_ns);
+
+/* Function Prototypes: */
+bool ctaphid_find_device(char *path, size_t size);
+ctaphid_client_t *ctaphid_open(const char *path);
+ctaphid_client_t *ctaphid_attach(int fd);
+void ctaphid_close(ctaphid_client_t *c);
+
+int ctaphid_send(ctaphid_client_t *c, uint32_t channel_id, uint8_t command_id, const uint8_t *payload,
+                 uint16_t length, ctaphid_callback_t *callback, void *context);
+int ctaphid_transact(ctaphid_client_t *c, uint32_t channel_id, uint8_t command_id, const uint8_t *payload,
+                     uint16_t length, uint8_t *response, uint16_t capacity, uint16_t *response_length);
+int ctaphid_open_channel(ctaphid_client_t *c, uint32_t *channel_id);
+
+#endif
@@ -0,0 +1,346 @@
+/** \file
+ *
+ *  Emulated USB device controller for the host build. Implements the subset of
+ *  LUFA's low level endpoint API used by the application on top of per-endpoint
+ *  bank buffers, and exposes the other end of those banks to host side drivers
+ *  (benchmarks and runners) as whole reports.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <LUFA/Drivers/USB/USB.h>
+#include <LUFA/Drivers/Board/LEDs.h>
+
+#include "host_usb.h"
+
+#define ENDPOINT_COUNT 8
+
+typedef struct
+{
+    uint16_t size;
+    uint8_t banks;
+    uint8_t head;
+    uint8_t count;
+    uint8_t pos;
+    volatile uint8_t ueienx;
+    uint8_t data[HOST_USB_MAX_BANKS][HOST_USB_MAX_EPSIZE];
+} host_endpoint_t;
+
+volatile uint8_t MCUSR;
+volatile uint8_t TCCR0B;
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint8_t WDTCSR;
+volatile uint8_t USB_DeviceState;
+uint8_t host_leds;
+
+/* Erased EEPROM reads as 0xff. */
+uint8_t host_eeprom[E2END + 1] = {[0 ... E2END] = 0xff};
+unsigned long host_eeprom_reads;
+unsigned long host_eeprom_writes;
+
+static host_endpoint_t endpoints[ENDPOINT_COUNT];
+static uint8_t selected;
+static uint16_t frame_number;
+static uint32_t frame_count;
+static uint64_t frame_start_ns;
+static bool sof_events;
+
+/* The application provides these as LUFA event callbacks. */
+void EVENT_USB_Device_Connect(void);
+void EVENT_USB_Device_Disconnect(void);
+void EVENT_USB_Device_ConfigurationChanged(void);
+
+/* Like LUFA's own event stubs, the Start Of Frame event is optional. */
+void EVENT_USB_Device_StartOfFrame(void) __attribute__((weak));
+
+/* Endpoint interrupt vector, if the application services its endpoints from one. */
+void USB_COM_vect(void) __attribute__((weak));
+
+/* Watchdog interrupt vector, if the application runs the watchdog as a timer. */
+void WDT_vect(void) __attribute__((weak));
+
+static host_endpoint_t *endpoint(uint8_t address)
+{
+    return &endpoints[address & (ENDPOINT_COUNT - 1)];
+}
+
+static bool is_in(uint8_t address)
+{
+    return (address & ENDPOINT_DIR_MASK) == ENDPOINT_DIR_IN;
+}
+
+void USB_Init(void)
+{
+    memset(endpoints, 0, sizeof(endpoints));
+    USB_DeviceState = DEVICE_STATE_Unattached;
+    sof_events = false;
+}
+
+void USB_USBTask(void)
+{
+}
+
+void USB_Device_EnableSOFEvents(void)
+{
+    sof_events = true;
+}
+
+uint16_t USB_Device_GetFrameNumber(void)
+{
+    return frame_number;
+}
+
+bool Endpoint_ConfigureEndpoint(const uint8_t Address, const uint8_t Type, const uint16_t Size, const uint8_t Banks)
+{
+    (void)Type;
+
+    if (Size > HOST_USB_MAX_EPSIZE || Banks == 0 || Banks > HOST_USB_MAX_BANKS)
+        return false;
+
+    host_endpoint_t *ep = endpoint(Address);
+    memset(ep, 0, sizeof(*ep));
+    ep->size = Size;
+    ep->banks = Banks;
+    selected = Address;
+    return true;
+}
+
+void Endpoint_SelectEndpoint(const uint8_t Address)
+{
+    selected = Address;
+}
+
+uint8_t Endpoint_GetCurrentEndpoint(void)
+{
+    return selected;
+}
+
+volatile uint8_t *host_usb_ueienx(void)
+{
+    return &endpoint(selected)->ueienx;
+}
+
+bool Endpoint_IsINReady(void)
+{
+    host_endpoint_t *ep = endpoint(selected);
+    return is_in(selected) && ep->count < ep->banks;
+}
+
+bool Endpoint_IsOUTReceived(void)
+{
+    return !is_in(selected) && endpoint(selected)->count > 0;
+}
+
+bool Endpoint_IsReadWriteAllowed(void)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (is_in(selected))
+        return ep->count < ep->banks && ep->pos < ep->size;
+    return ep->count > 0 && ep->pos < ep->size;
+}
+
+void Endpoint_ClearIN(void)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (ep->count < ep->banks)
+    {
+        uint8_t bank = (ep->head + ep->count) % ep->banks;
+        memset(&ep->data[bank][ep->pos], 0, ep->size - ep->pos);
+        ep->count++;
+    }
+    ep->pos = 0;
+}
+
+void Endpoint_ClearOUT(void)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (ep->count > 0)
+    {
+        ep->head = (ep->head + 1) % ep->banks;
+        ep->count--;
+    }
+    ep->pos = 0;
+}
+
+uint8_t Endpoint_Write_Stream_LE(const void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (ep->count == ep->banks || ep->pos + Length > ep->size)
+        return ENDPOINT_RWSTREAM_IncompleteTransfer;
+
+    uint8_t bank = (ep->head + ep->count) % ep->banks;
+    memcpy(&ep->data[bank][ep->pos], Buffer, Length);
+    ep->pos += Length;
+
+    if (BytesProcessed)
+        *BytesProcessed = Length;
+    return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t Endpoint_Write_PStream_LE(const void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed)
+{
+    return Endpoint_Write_Stream_LE(Buffer, Length, BytesProcessed);
+}
+
+uint8_t Endpoint_Null_Stream(uint16_t Length, uint16_t *const BytesProcessed)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (ep->count == ep->banks || ep->pos + Length > ep->size)
+        return ENDPOINT_RWSTREAM_IncompleteTransfer;
+
+    uint8_t bank = (ep->head + ep->count) % ep->banks;
+    memset(&ep->data[bank][ep->pos], 0, Length);
+    ep->pos += Length;
+
+    if (BytesProcessed)
+        *BytesProcessed = Length;
+    return ENDPOINT_RWSTREAM_NoError;
+}
+
+uint8_t Endpoint_Read_Stream_LE(void *const Buffer, uint16_t Length, uint16_t *const BytesProcessed)
+{
+    host_endpoint_t *ep = endpoint(selected);
+
+    if (ep->count == 0 || ep->pos + Length > ep->size)
+        return ENDPOINT_RWSTREAM_IncompleteTransfer;
+
+    memcpy(Buffer, &ep->data[ep->head][ep->pos], Length);
+    ep->pos += Length;
+
+    if (BytesProcessed)
+        *BytesProcessed = Length;
+    return ENDPOINT_RWSTREAM_NoError;
+}
+
+static bool interrupt_pending(void)
+{
+    for (uint8_t i = 0; i < ENDPOINT_COUNT; i++)
+    {
+        host_endpoint_t *ep = &endpoints[i];
+
+        if ((ep->ueienx & (1 << TXINE)) && ep->count < ep->banks)
+            return true;
+        if ((ep->ueienx & (1 << RXOUTE)) && ep->count > 0)
+            return true;
+    }
+    return false;
+}
+
+/** Raises the endpoint interrupt for as long as an enabled condition holds. The number of calls is
+ *  bounded, so an ISR which never clears its condition shows up as a hang in the driver rather than here.
+ */
+void host_usb_service(void)
+{
+    if (!USB_COM_vect || USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    for (uint8_t i = 0; i < 16 && interrupt_pending(); i++)
+        USB_COM_vect();
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Counts clock ticks through the emulated bus's frames at the prescaler a timer's clock select
+// bits pick.
+static uint64_t timer_count(uint8_t clock_select)
+{
+    static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+    uint16_t prescaler = prescalers[clock_select & 0x07];
+
+    if (!prescaler)
+        return 0;
+
+    // Time spent within a frame is capped at the frame, so the count never runs ahead of the bus.
+    uint64_t ticks_per_frame = F_CPU / 1000 / prescaler;
+    uint64_t ticks = (now_ns() - frame_start_ns) * (F_CPU / prescaler) / 1000000000;
+
+    return frame_count * ticks_per_frame + MIN(ticks, ticks_per_frame - 1);
+}
+
+uint8_t host_usb_timer0(void)
+{
+    return timer_count(TCCR0B);
+}
+
+uint16_t host_usb_timer1(void)
+{
+    return timer_count(TCCR1B);
+}
+
+/** Connects the emulated device to the bus and configures it, as a host would during enumeration. */
+void host_usb_attach(void)
+{
+    USB_DeviceState = DEVICE_STATE_Powered;
+    EVENT_USB_Device_Connect();
+    USB_DeviceState = DEVICE_STATE_Configured;
+    EVENT_USB_Device_ConfigurationChanged();
+    host_usb_service();
+}
+
+/** Disconnects the emulated device from the bus. */
+void host_usb_detach(void)
+{
+    USB_DeviceState = DEVICE_STATE_Unattached;
+    EVENT_USB_Device_Disconnect();
+}
+
+/** Advances the bus by one 1ms frame, raising the Start Of Frame event if it is enabled. */
+void host_usb_frame(void)
+{
+    frame_number = (frame_number + 1) & 0x7FF;
+    frame_count++;
+    frame_start_ns = now_ns();
+
+    if (sof_events && EVENT_USB_Device_StartOfFrame)
+    {
+        EVENT_USB_Device_StartOfFrame();
+        host_usb_service();
+    }
+
+    // The watchdog's shortest timeout, which is all the application uses, is roughly 16 frames.
+    if ((WDTCSR & (1 << WDIE)) && WDT_vect && frame_count % 16 == 0)
+        WDT_vect();
+}
+
+/** Delivers one OUT report from the host. Returns false (a NAK) if the endpoint has no free bank. */
+bool host_usb_out(uint8_t address, const uint8_t *report)
+{
+    host_endpoint_t *ep = endpoint(address);
+
+    if (ep->banks == 0 || ep->count == ep->banks)
+        return false;
+
+    memcpy(ep->data[(ep->head + ep->count) % ep->banks], report, ep->size);
+    ep->count++;
+    host_usb_service();
+    return true;
+}
+
+/** Collects one IN report for the host. Returns false (a NAK) if the device has not cleared a bank. */
+bool host_usb_in(uint8_t address, uint8_t *report)
+{
+    host_endpoint_t *ep = endpoint(address);
+
+    if (ep->count == 0)
+        return false;
+
+    memcpy(report, ep->data[ep->head], ep->size);
+    ep->head = (ep->head + 1) % ep->banks;
+    ep->count--;
+    host_usb_service();
+    return true;
+}
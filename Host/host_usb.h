@@ -0,0 +1,27 @@
+/** \file
+ *
+ *  Header file for host_usb.c.
+ */
+
+#ifndef _HOST_USB_H_
+#define _HOST_USB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Macros: */
+/** Largest endpoint size supported by the emulated USB controller. */
+#define HOST_USB_MAX_EPSIZE 64
+
+/** Largest number of banks an emulated endpoint can be configured with. */
+#define HOST_USB_MAX_BANKS 2
+
+/* Function Prototypes: */
+void host_usb_attach(void);
+void host_usb_detach(void);
+void host_usb_frame(void);
+void host_usb_service(void);
+bool host_usb_out(uint8_t address, const uint8_t *report);
+bool host_usb_in(uint8_t address, uint8_t *report);
+
+#endif
@@ -0,0 +1,70 @@
+/** \file
+ *
+ *  Latency samples for the host clients, with exact percentiles.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+void latency_add(latency_t *l, uint64_t ns)
+{
+    if (l->count == l->capacity)
+    {
+        size_t capacity = l->capacity ? l->capacity * 2 : 1024;
+        uint64_t *samples = realloc(l->samples, capacity * sizeof(*samples));
+
+        // Running out of memory loses samples rather than the run.
+        if (samples == NULL)
+            return;
+        l->samples = samples;
+        l->capacity = capacity;
+    }
+    l->samples[l->count++] = ns;
+    l->total += ns;
+}
+
+void latency_merge(latency_t *into, const latency_t *from)
+{
+    for (size_t i = 0; i < from->count; i++)
+        latency_add(into, from->samples[i]);
+}
+
+static int compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/** Returns the nearest-rank percentile, 0 if there are no samples. Sorts the samples. */
+uint64_t latency_percentile(latency_t *l, unsigned percentile)
+{
+    size_t rank;
+
+    if (l->count == 0)
+        return 0;
+
+    qsort(l->samples, l->count, sizeof(*l->samples), compare);
+    rank = (l->count * percentile + 99) / 100;
+    return l->samples[rank ? rank - 1 : 0];
+}
+
+double latency_mean(const latency_t *l)
+{
+    return l->count ? (double)l->total / l->count : 0.0;
+}
+
+void latency_clear(latency_t *l)
+{
+    l->count = 0;
+    l->total = 0;
+}
+
+void latency_free(latency_t *l)
+{
+    free(l->samples);
+    memset(l, 0, sizeof(*l));
+}
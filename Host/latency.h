@@ -0,0 +1,30 @@
+/** \file
+ *
+ *  Header file for latency.c.
+ */
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Type Defines: */
+/** Every latency recorded, in nanoseconds, so exact percentiles can be taken. Not thread safe. */
+typedef struct
+{
+    uint64_t *samples;
+    size_t count;
+    size_t capacity;
+    uint64_t total;
+} latency_t;
+
+/* Function Prototypes: */
+void latency_add(latency_t *l, uint64_t ns);
+void latency_merge(latency_t *into, const latency_t *from);
+uint64_t latency_percentile(latency_t *l, unsigned percentile);
+double latency_mean(const latency_t *l);
+void latency_clear(latency_t *l);
+void latency_free(latency_t *l);
+
+#endif
@@ -0,0 +1,45 @@
+/** \file
+ *
+ *  Runs loadgen.c against the CTAPHID core, behind socket pairs from
+ *  socket_device.c rather than hidraw, as a check of how the firmware and the
+ *  client behave under contention: up to eight clients, each with its own
+ *  handle, mixing INITs that evict one another's channels, PINGs whose echoes
+ *  are checked and refused unknown commands.
+ *
+ *  The makefile builds loadgen.c for it with main() renamed to loadgen_main()
+ *  and ctaphid_open() to load_test_open(), which connects a new handle to the
+ *  device. loadgen's exit status is passed on, so any failed or timed out
+ *  request fails the test. So does a step whose clients don't stop once its
+ *  time is up, through the alarm.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "ctaphid_client.h"
+#include "socket_device.h"
+
+/** Seconds before a run that hasn't finished is killed. Its steps take one second each. */
+#define TIMEOUT_SECONDS 30
+
+int loadgen_main(int argc, char **argv);
+
+ctaphid_client_t *load_test_open(const char *path)
+{
+    int fd = socket_device_connect();
+
+    (void)path;
+    return fd < 0 ? NULL : ctaphid_attach(fd);
+}
+
+int main(void)
+{
+    char *argv[] = {"fidohid_load", "-n", "8", "-t", "1", "-m", "1,8,1", "-s", "0,57,512,1024", "socket_device", NULL};
+    int ret;
+
+    alarm(TIMEOUT_SECONDS);
+    socket_device_start();
+    ret = loadgen_main(sizeof(argv) / sizeof(argv[0]) - 1, argv);
+    socket_device_stop();
+    return ret;
+}
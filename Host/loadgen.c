@@ -0,0 +1,368 @@
+/** \file
+ *
+ *  Contention load for a CTAPHID authenticator, as when several apps use the
+ *  key at once. Each client is a thread with its own hidraw handle and its own
+ *  channel, firing a weighted random mix of requests back to back:
+ *
+ *   - init:  allocates a fresh channel with an INIT on the broadcast channel,
+ *            as an app does when it starts, and moves to it.
+ *   - ping:  a PING of one of the given sizes, whose echo is checked. Sizes
+ *            are limited to the firmware's CTAPHID_MAX_MESSAGE_SIZE, since
+ *            it refuses longer requests with CTAPHID_ERR_INVALID_LEN.
+ *   - error: a command the authenticator doesn't implement, which must be
+ *            refused with CTAPHID_ERR_INVALID_CMD.
+ *
+ *  The run steps the number of clients up to the most asked for, doubling each
+ *  time. After each step, every client's latency distribution and refusals
+ *  are printed, then the step's total throughput. CTAPHID_ERR_CHANNEL_BUSY
+ *  means the authenticator had no room for the request. CTAPHID_ERR_INVALID_CHANNEL
+ *  means another client's INIT evicted the channel, which the client then
+ *  reallocates. The collapse point is the first step whose throughput falls more
+ *  than a tenth below the best step before it. The exit status is 1 if any
+ *  request failed or timed out, so a run doubles as a check.
+ *
+ *  Usage: fidohid_load [-n clients] [-t seconds per step] [-m init,ping,error weights]
+ *                      [-s ping sizes] [/dev/hidrawN]
+ *
+ *  For example: fidohid_load -n 16 -m 1,8,1 -s 0,57,512,1024
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Config/AppConfig.h"
+#include "../ctaphid.h"
+
+#include "ctaphid_client.h"
+#include "latency.h"
+
+#define MAX_CLIENTS 64
+#define MAX_SIZES 16
+
+/** Vendor command the firmware doesn't implement. */
+#define UNKNOWN_COMMAND 0x7e
+
+typedef enum
+{
+    OP_INIT,
+    OP_PING,
+    OP_ERROR,
+    OP_COUNT,
+} op_t;
+
+typedef struct
+{
+    unsigned id;
+    ctaphid_client_t *client;
+    pthread_t thread;
+    uint32_t channel_id;
+    unsigned seed;
+    latency_t latency;
+    unsigned long requests;
+    unsigned long busy;
+    unsigned long evicted;
+    unsigned long failed;
+    unsigned long timeouts;
+} client_t;
+
+static const char *op_names[OP_COUNT] = {"init", "ping", "error"};
+static unsigned weights[OP_COUNT] = {1, 8, 1};
+static uint16_t sizes[MAX_SIZES] = {0, 57, 512, 1024};
+static unsigned size_count = 4;
+
+static client_t clients[MAX_CLIENTS];
+static uint8_t payload[CTAPHID_CLIENT_MAX_MESSAGE];
+static atomic_bool running;
+static unsigned long failures;
+
+static op_t pick_op(client_t *c)
+{
+    unsigned total = weights[OP_INIT] + weights[OP_PING] + weights[OP_ERROR];
+    unsigned pick = rand_r(&c->seed) % total;
+    op_t op = OP_INIT;
+
+    while (pick >= weights[op])
+        pick -= weights[op++];
+    return op;
+}
+
+/** Runs one request. Returns the response's command, or a negative errno. */
+static int run_op(client_t *c, op_t op, uint8_t *response, uint16_t *length, uint16_t *size)
+{
+    uint32_t channel_id;
+    int ret;
+
+    switch (op)
+    {
+    case OP_INIT:
+        ret = ctaphid_open_channel(c->client, &channel_id);
+        if (ret == 0)
+        {
+            c->channel_id = channel_id;
+            ret = CTAPHID_INIT;
+        }
+        return ret;
+    case OP_PING:
+        *size = sizes[rand_r(&c->seed) % size_count];
+        return ctaphid_transact(c->client, c->channel_id, CTAPHID_PING, payload, *size, response,
+                                CTAPHID_CLIENT_MAX_MESSAGE, length);
+    default:
+        return ctaphid_transact(c->client, c->channel_id, UNKNOWN_COMMAND, payload, 0, response,
+                                CTAPHID_CLIENT_MAX_MESSAGE, length);
+    }
+}
+
+static void *client_main(void *arg)
+{
+    client_t *c = arg;
+    static __thread uint8_t response[CTAPHID_CLIENT_MAX_MESSAGE];
+
+    while (running)
+    {
+        op_t op = pick_op(c);
+        uint16_t length = 0;
+        uint16_t size = 0;
+        struct timespec start, end;
+        bool ok;
+        int ret;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ret = run_op(c, op, response, &length, &size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        c->requests++;
+
+        if (ret == -ETIMEDOUT)
+        {
+            c->timeouts++;
+            continue;
+        }
+        if (ret < 0)
+        {
+            c->failed++;
+            continue;
+        }
+        if (ret == CTAPHID_ERROR && length == 1 && response[0] == CTAPHID_ERR_CHANNEL_BUSY)
+        {
+            c->busy++;
+            continue;
+        }
+        if (ret == CTAPHID_ERROR && length == 1 && response[0] == CTAPHID_ERR_INVALID_CHANNEL)
+        {
+            c->evicted++;
+            if (ctaphid_open_channel(c->client, &c->channel_id) < 0)
+                c->failed++;
+            continue;
+        }
+
+        switch (op)
+        {
+        case OP_INIT:
+            ok = ret == CTAPHID_INIT;
+            break;
+        case OP_PING:
+            ok = ret == CTAPHID_PING && length == size && memcmp(response, payload, size) == 0;
+            break;
+        default:
+            ok = ret == CTAPHID_ERROR && length == 1 && response[0] == CTAPHID_ERR_INVALID_CMD;
+            break;
+        }
+
+        if (ok)
+            latency_add(&c->latency, (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec);
+        else
+            c->failed++;
+    }
+    return NULL;
+}
+
+static bool parse_list(const char *list, unsigned *values, unsigned max, unsigned *count)
+{
+    char *end;
+
+    *count = 0;
+    do
+    {
+        if (*count == max)
+            return false;
+        values[(*count)++] = strtoul(list, &end, 0);
+        if (end == list)
+            return false;
+        list = end + 1;
+    } while (*end == ',');
+    return *end == '\0';
+}
+
+static void print_client(client_t *c)
+{
+    printf("  client %2u %08x: %8lu req, p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms, %5.1f%% busy, %lu evicted, "
+           "%lu failed, %lu timeouts\n",
+           c->id, c->channel_id, c->requests, latency_percentile(&c->latency, 50) / 1e6,
+           latency_percentile(&c->latency, 99) / 1e6, latency_percentile(&c->latency, 100) / 1e6,
+           c->requests ? 100.0 * c->busy / c->requests : 0.0, c->evicted, c->failed, c->timeouts);
+}
+
+/** Runs a step with count clients. Returns its throughput in completed requests per second. */
+static double run_step(const char *path, unsigned count, unsigned seconds)
+{
+    latency_t all = {0};
+    unsigned long requests = 0;
+    unsigned long busy = 0;
+    unsigned long completed = 0;
+    double throughput;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        client_t *c = &clients[i];
+        int ret;
+
+        memset(c, 0, sizeof(*c));
+        c->id = i;
+        c->seed = i * 7919 + 1;
+        c->client = ctaphid_open(path);
+        if (c->client == NULL)
+        {
+            perror(path);
+            exit(1);
+        }
+        ret = ctaphid_open_channel(c->client, &c->channel_id);
+        if (ret < 0)
+        {
+            fprintf(stderr, "client %u INIT: %s\n", i, strerror(-ret));
+            exit(1);
+        }
+    }
+
+    running = true;
+    for (unsigned i = 0; i < count; i++)
+        pthread_create(&clients[i].thread, NULL, client_main, &clients[i]);
+    sleep(seconds);
+    running = false;
+
+    printf("%u clients:\n", count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        client_t *c = &clients[i];
+
+        pthread_join(c->thread, NULL);
+        ctaphid_close(c->client);
+
+        print_client(c);
+        latency_merge(&all, &c->latency);
+        requests += c->requests;
+        busy += c->busy;
+        completed += c->latency.count;
+        failures += c->failed + c->timeouts;
+        latency_free(&c->latency);
+    }
+
+    throughput = (double)completed / seconds;
+    printf("  total:             %8lu req, p50 %7.3f ms, p99 %7.3f ms, %5.1f%% busy, %.1f/s\n", requests,
+           latency_percentile(&all, 50) / 1e6, latency_percentile(&all, 99) / 1e6,
+           requests ? 100.0 * busy / requests : 0.0, throughput);
+    latency_free(&all);
+    return throughput;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned max_clients = 8;
+    unsigned seconds = 3;
+    unsigned values[MAX_SIZES];
+    unsigned count;
+    char path[64];
+    double best = 0;
+    unsigned best_clients = 0;
+    unsigned collapse = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:t:m:s:")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            max_clients = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'm':
+            if (!parse_list(optarg, values, OP_COUNT, &count) || count != OP_COUNT ||
+                values[0] + values[1] + values[2] == 0)
+                goto usage;
+            memcpy(weights, values, sizeof(weights));
+            break;
+        case 's':
+            if (!parse_list(optarg, values, MAX_SIZES, &size_count))
+                goto usage;
+            for (unsigned i = 0; i < size_count; i++)
+            {
+                if (values[i] > CTAPHID_MAX_MESSAGE_SIZE)
+                    goto usage;
+                sizes[i] = values[i];
+            }
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (max_clients < 1 || max_clients > MAX_CLIENTS || seconds < 1)
+        goto usage;
+
+    if (optind < argc)
+        snprintf(path, sizeof(path), "%s", argv[optind]);
+    else if (!ctaphid_find_device(path, sizeof(path)))
+    {
+        fprintf(stderr, "no FIDO hidraw device found\n");
+        return 1;
+    }
+
+    for (unsigned i = 0; i < sizeof(payload); i++)
+        payload[i] = i * 13;
+
+    printf("mix %s %u, %s %u, %s %u; ping sizes", op_names[OP_INIT], weights[OP_INIT], op_names[OP_PING],
+           weights[OP_PING], op_names[OP_ERROR], weights[OP_ERROR]);
+    for (unsigned i = 0; i < size_count; i++)
+        printf(" %u", sizes[i]);
+    printf("\n");
+
+    for (unsigned n = 1;; n = n * 2 < max_clients ? n * 2 : max_clients)
+    {
+        double throughput = run_step(path, n, seconds);
+
+        if (throughput > best)
+        {
+            best = throughput;
+            best_clients = n;
+        }
+        else if (collapse == 0 && throughput < best * 0.9)
+        {
+            collapse = n;
+        }
+
+        if (n == max_clients)
+            break;
+    }
+
+    printf("peak %.1f/s with %u clients", best, best_clients);
+    if (collapse)
+        printf(", collapsing from %u clients\n", collapse);
+    else
+        printf(", no collapse up to %u clients\n", max_clients);
+    if (failures)
+    {
+        printf("%lu requests failed or timed out\n", failures);
+        return 1;
+    }
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-n clients] [-t seconds per step] [-m init,ping,error weights] [-s ping sizes] [/dev/hidrawN]\n",
+            argv[0]);
+    return 1;
+}
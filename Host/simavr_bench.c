@@ -0,0 +1,530 @@
+/** \file
+ *
+ *  Cycle counts for the AVR build, ../FidoHID.elf, run under simavr's
+ *  ATmega32U4 with a scripted USB host in place of a PC. The host enumerates
+ *  the device over the control endpoint, then drives CTAPHID transactions
+ *  through the FIDO endpoints: INITs on the broadcast channel, and PINGs
+ *  across payload sizes on the channel the last INIT allocated.
+ *
+ *  The host stub takes an OUT report as soon as the firmware has a bank free
+ *  for it, and reads an IN report as soon as one's ready, checking between
+ *  every instruction. A real host only polls the interrupt endpoints once a
+ *  frame, so these are the firmware's own costs, without the bus's. A
+ *  transaction is timed from its first request packet being taken to its
+ *  response's last being read.
+ *
+ *  Interrupt latency is the cycles from the USB general (bus and SOF) and
+ *  endpoint interrupts being raised to their vectors running, so it's mostly
+ *  the time spent with interrupts disabled.
+ *
+ *  The signers are timed through the CTAPHID_VENDOR_SIGN_BENCH command, which
+ *  the firmware only has when built with "make SIGN_BENCH=1" (as "make
+ *  simbench" does). A P-256 signature and an Ed25519 one are made from the
+ *  RFC 6979 and RFC 8032 test keys, a ladder step per pass of the main loop
+ *  as for a real assertion, and checked against the RFCs' answers. They're
+ *  timed from the request's first packet to the signature's last. Each one's
+ *  stack depth, from the lowest the stack pointer went while it ran, is in
+ *  the bytes column of its _stack line. That build shrinks
+ *  CTAPHID_MAX_MESSAGE_SIZE to make room for the signers, so this is built
+ *  with FIDO_SIGN_BENCH too, and larger PINGs are left out.
+ *
+ *  The firmware's painted RAM high-water marks are asked for with the
+ *  CTAPHID_VENDOR_RAM_USAGE command after the PINGs and after each signer.
+ *  If the stack has ever reached the heap, and so run over .bss, the run
+ *  fails.
+ *
+ *  Usage: fidohid_simavr [FidoHID.elf]. Exits with 1 if enumeration or a
+ *  transaction stalls.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_irq.h"
+#include "avr_usb.h"
+
+#include "../Config/AppConfig.h"
+#include "../ctaphid.h"
+
+#define MCU "atmega32u4"
+#define F_CPU 16000000UL
+
+/** Endpoint addresses and sizes, as in Descriptors.h and Config/LUFAConfig.h. */
+#define FIDO_IN_EPADDR 0x81
+#define FIDO_OUT_EPADDR 0x02
+#define CONTROL_EPSIZE 8
+
+/** Interrupt vector numbers on the ATmega32U4. */
+#define USB_GEN_VECTOR 10
+#define USB_COM_VECTOR 11
+
+#define INIT_PAYLOAD_LENGTH (FIDO_REPORT_SIZE - 7)
+#define CONT_PAYLOAD_LENGTH (FIDO_REPORT_SIZE - 5)
+#define MAX_PACKETS (1 + (CTAPHID_MAX_MESSAGE_SIZE - INIT_PAYLOAD_LENGTH + CONT_PAYLOAD_LENGTH - 1) / CONT_PAYLOAD_LENGTH)
+
+/** Simulated time a control transfer or transaction may take before the firmware is considered stalled. */
+#define TIMEOUT_CYCLES (F_CPU / 10)
+
+/** Simulated time a signature may take. */
+#define SIGN_TIMEOUT_CYCLES (60 * F_CPU)
+
+#define INIT_ITERATIONS 16
+#define PING_ITERATIONS 8
+
+typedef struct
+{
+    const char *name;
+    avr_cycle_count_t raised;
+    unsigned long count;
+    avr_cycle_count_t total;
+    avr_cycle_count_t max;
+} interrupt_stats_t;
+
+static const uint16_t payload_sizes[] = {0, 57, 58, 116, 117, 293, 512, 1024, CTAPHID_MAX_MESSAGE_SIZE};
+
+static avr_t *avr;
+static uint16_t stack_pointer_min;
+static uint8_t requests[MAX_PACKETS][FIDO_REPORT_SIZE];
+static uint8_t responses[MAX_PACKETS][FIDO_REPORT_SIZE];
+static interrupt_stats_t usb_gen_stats = {.name = "usb_gen_latency"};
+static interrupt_stats_t usb_com_stats = {.name = "usb_com_latency"};
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "%s stalled at cycle %llu\n", what, (unsigned long long)avr->cycle);
+    exit(1);
+}
+
+/** Runs the firmware an instruction (or an interrupt's entry) further. */
+static void step(void)
+{
+    int state = avr_run(avr);
+    uint16_t stack_pointer = avr->data[R_SPL] | avr->data[R_SPH] << 8;
+
+    if (state == cpu_Done || state == cpu_Crashed)
+    {
+        fprintf(stderr, "firmware stopped at cycle %llu\n", (unsigned long long)avr->cycle);
+        exit(1);
+    }
+    if (stack_pointer < stack_pointer_min)
+        stack_pointer_min = stack_pointer;
+}
+
+static void run_for(avr_cycle_count_t cycles)
+{
+    avr_cycle_count_t end = avr->cycle + cycles;
+
+    while (avr->cycle < end)
+        step();
+}
+
+static void interrupt_pending(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    interrupt_stats_t *s = param;
+
+    (void)irq;
+    if (value)
+        s->raised = avr->cycle;
+}
+
+static void interrupt_running(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    interrupt_stats_t *s = param;
+    avr_cycle_count_t latency;
+
+    (void)irq;
+    if (!value)
+        return;
+
+    latency = avr->cycle - s->raised;
+    s->count++;
+    s->total += latency;
+    if (latency > s->max)
+        s->max = latency;
+}
+
+static void watch_interrupt(uint8_t vector, interrupt_stats_t *s)
+{
+    avr_irq_t *irq = avr_get_interrupt_irq(avr, vector);
+
+    avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, interrupt_pending, s);
+    avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, interrupt_running, s);
+}
+
+/** Tries to hand the firmware a packet. Returns false if it NAKed. */
+static bool usb_try(uint32_t request, uint8_t pipe, uint8_t *data, uint32_t *size)
+{
+    struct avr_io_usb io = {.pipe = pipe, .sz = *size, .buf = data};
+    int ret = avr_ioctl(avr, request, &io);
+
+    if (ret == AVR_IOCTL_USB_NAK)
+        return false;
+    if (ret < 0)
+    {
+        fprintf(stderr, "endpoint %02x stalled (%d)\n", pipe, ret);
+        exit(1);
+    }
+    *size = io.sz;
+    return true;
+}
+
+static bool usb_write(uint8_t pipe, const uint8_t *data, uint32_t size)
+{
+    return usb_try(AVR_IOCTL_USB_WRITE, pipe, (uint8_t *)data, &size);
+}
+
+/** Reads a packet into data, which must have room for a whole one. Returns its size, or -1 if NAKed. */
+static int usb_read(uint8_t pipe, uint8_t *data)
+{
+    uint32_t size = FIDO_REPORT_SIZE;
+
+    return usb_try(AVR_IOCTL_USB_READ, pipe & 0x7f, data, &size) ? (int)size : -1;
+}
+
+/** Retries an endpoint 0 transfer between instructions until the firmware takes it. */
+static uint32_t control_stage(const char *what, uint32_t request, uint8_t *data, uint32_t size)
+{
+    avr_cycle_count_t deadline = avr->cycle + TIMEOUT_CYCLES;
+
+    while (!usb_try(request, 0, data, &size))
+    {
+        if (avr->cycle > deadline)
+            fail(what);
+        step();
+    }
+    return size;
+}
+
+/** Runs a control transfer: SETUP, any IN data, and the status stage. */
+static void control(const char *what, uint8_t request_type, uint8_t request, uint16_t value, uint16_t length, uint8_t *data)
+{
+    uint8_t setup[8] = {request_type, request, value & 0xff, value >> 8, 0, 0, length & 0xff, length >> 8};
+    uint8_t packet[FIDO_REPORT_SIZE];
+    uint16_t received = 0;
+
+    control_stage(what, AVR_IOCTL_USB_SETUP, setup, sizeof(setup));
+
+    if (request_type & 0x80)
+    {
+        // The data stage ends with a short packet, or once all that was asked for has come.
+        while (received < length)
+        {
+            uint32_t size = control_stage(what, AVR_IOCTL_USB_READ, packet, sizeof(packet));
+            uint32_t wanted = length - received;
+            uint16_t used = size < wanted ? size : wanted;
+
+            memcpy(data + received, packet, used);
+            received += used;
+            if (size < CONTROL_EPSIZE)
+                break;
+        }
+        control_stage(what, AVR_IOCTL_USB_WRITE, packet, 0);
+    }
+    else
+    {
+        control_stage(what, AVR_IOCTL_USB_READ, packet, sizeof(packet));
+    }
+}
+
+static void enumerate(void)
+{
+    uint8_t device[18];
+
+    // Boots, sees VBUS and attaches, then is reset by the host, as when it's plugged in.
+    run_for(F_CPU / 100);
+    avr_ioctl(avr, AVR_IOCTL_USB_VBUS, (void *)1);
+    run_for(F_CPU / 100);
+    avr_ioctl(avr, AVR_IOCTL_USB_RESET, NULL);
+    run_for(F_CPU / 1000);
+
+    control("GET_DESCRIPTOR", 0x80, 6, 0x0100, sizeof(device), device);
+    control("SET_ADDRESS", 0x00, 5, 1, 0, NULL);
+    control("SET_CONFIGURATION", 0x00, 9, 1, 0, NULL);
+    run_for(F_CPU / 1000);
+
+    printf("enumerated %04x:%04x at cycle %llu\n", device[8] | device[9] << 8, device[10] | device[11] << 8,
+           (unsigned long long)avr->cycle);
+}
+
+static uint16_t packets_for(uint16_t payload_length)
+{
+    if (payload_length <= INIT_PAYLOAD_LENGTH)
+        return 1;
+    return 1 + (payload_length - INIT_PAYLOAD_LENGTH + CONT_PAYLOAD_LENGTH - 1) / CONT_PAYLOAD_LENGTH;
+}
+
+/** Splits a request into requests[], as write_message_packets does. Returns the number of packets. */
+static uint16_t build_request(const uint8_t channel_id[4], uint8_t command_id, const uint8_t *payload, uint16_t length)
+{
+    uint16_t count = packets_for(length);
+    uint16_t offset = 0;
+
+    memset(requests, 0, sizeof(requests));
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint8_t *report = requests[i];
+        uint8_t header = i == 0 ? 7 : 5;
+        uint16_t size = length - offset < FIDO_REPORT_SIZE - header ? length - offset : FIDO_REPORT_SIZE - header;
+
+        memcpy(report, channel_id, 4);
+        if (i == 0)
+        {
+            report[4] = command_id | 0x80;
+            report[5] = length >> 8;
+            report[6] = length & 0xff;
+        }
+        else
+        {
+            report[4] = i - 1;
+        }
+        memcpy(report + header, payload + offset, size);
+        offset += size;
+    }
+    return count;
+}
+
+/** Writes requests[] to the OUT endpoint as fast as the firmware takes them, while reading the IN
+ *  endpoint until the response is complete. Keepalives are skipped. The response's packets are
+ *  copied to responses[]. Returns the cycles from the first packet being taken to the last being read.
+ */
+static avr_cycle_count_t transact(const char *what, uint16_t count, avr_cycle_count_t timeout, uint16_t *response_count)
+{
+    avr_cycle_count_t deadline = avr->cycle + timeout;
+    avr_cycle_count_t start = 0;
+    uint8_t report[FIDO_REPORT_SIZE];
+    uint16_t sent = 0;
+    uint16_t expected = 0;
+    uint16_t received = 0;
+
+    while (avr->cycle < deadline)
+    {
+        if (sent < count && usb_write(FIDO_OUT_EPADDR, requests[sent], FIDO_REPORT_SIZE))
+        {
+            if (sent++ == 0)
+                start = avr->cycle;
+        }
+
+        if (usb_read(FIDO_IN_EPADDR, report) == FIDO_REPORT_SIZE)
+        {
+            if ((report[4] & 0x80) && (report[4] & 0x7f) != CTAPHID_KEEPALIVE)
+            {
+                expected = packets_for(report[5] << 8 | report[6]);
+                received = 0;
+            }
+            if (expected && received < MAX_PACKETS)
+                memcpy(responses[received], report, FIDO_REPORT_SIZE);
+            if (expected && ++received == expected && sent == count)
+            {
+                *response_count = expected;
+                return avr->cycle - start;
+            }
+        }
+
+        step();
+    }
+    fail(what);
+    return 0;
+}
+
+static void report(const char *name, uint16_t payload_length, uint16_t packets, avr_cycle_count_t cycles)
+{
+    double frequency = avr->frequency ? avr->frequency : F_CPU;
+
+    printf("%-24s %6u %4u %12.1f %12.1f %12.0f\n", name, payload_length, packets, (double)cycles,
+           (double)cycles / packets, packets * frequency / cycles);
+}
+
+/** Allocates channels with INITs on the broadcast channel, leaving the last one's ID in channel_id. */
+static void bench_init(uint8_t channel_id[4])
+{
+    static const uint8_t broadcast[4] = {0xff, 0xff, 0xff, 0xff};
+    static const uint8_t nonce[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    avr_cycle_count_t cycles = 0;
+    uint16_t response_count = 0;
+    uint16_t count = build_request(broadcast, CTAPHID_INIT, nonce, sizeof(nonce));
+
+    for (int i = 0; i < INIT_ITERATIONS; i++)
+        cycles += transact("INIT", count, TIMEOUT_CYCLES, &response_count);
+
+    memcpy(channel_id, responses[0] + 7 + sizeof(nonce), 4);
+    report("init", sizeof(nonce), count + response_count, cycles / INIT_ITERATIONS);
+}
+
+static void bench_ping(const uint8_t channel_id[4])
+{
+    static uint8_t payload[CTAPHID_MAX_MESSAGE_SIZE];
+
+    for (uint16_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i * 7;
+
+    for (uint8_t s = 0; s < sizeof(payload_sizes) / sizeof(payload_sizes[0]); s++)
+    {
+        if (payload_sizes[s] > CTAPHID_MAX_MESSAGE_SIZE)
+            continue;
+
+        uint16_t count = build_request(channel_id, CTAPHID_PING, payload, payload_sizes[s]);
+        avr_cycle_count_t cycles = 0;
+        uint16_t response_count = 0;
+
+        for (int i = 0; i < PING_ITERATIONS; i++)
+            cycles += transact("PING", count, TIMEOUT_CYCLES, &response_count);
+
+        report("ping", payload_sizes[s], count + response_count, cycles / PING_ITERATIONS);
+    }
+}
+
+/** Asks the firmware for its stack and heap peaks and the smallest free gap between them since boot,
+ *  and fails if the gap's ever closed. */
+static void report_ram_usage(const char *when, const uint8_t channel_id[4])
+{
+    uint16_t response_count;
+    const uint8_t *usage = responses[0] + 7;
+
+    transact("RAM_USAGE", build_request(channel_id, CTAPHID_VENDOR_RAM_USAGE, (const uint8_t *)"", 0), TIMEOUT_CYCLES,
+             &response_count);
+    if ((responses[0][4] & 0x7f) != CTAPHID_VENDOR_RAM_USAGE)
+    {
+        printf("ram usage not reported\n");
+        return;
+    }
+    printf("ram after %s: stack_peak %u heap_peak %u gap_min %u\n", when, usage[0] | usage[1] << 8,
+           usage[2] | usage[3] << 8, usage[4] | usage[5] << 8);
+    if ((usage[4] | usage[5] << 8) == 0)
+    {
+        printf("the stack has run into .bss\n");
+        exit(1);
+    }
+}
+
+/** RFC 6979 appendix A.2.5: the P-256 key, SHA-256("sample") and its signature. */
+static const uint8_t p256_private_key[32] = {
+    0xc9, 0xaf, 0xa9, 0xd8, 0x45, 0xba, 0x75, 0x16, 0x6b, 0x5c, 0x21, 0x57, 0x67, 0xb1, 0xd6, 0x93,
+    0x4e, 0x50, 0xc3, 0xdb, 0x36, 0xe8, 0x9b, 0x12, 0x7b, 0x8a, 0x62, 0x2b, 0x12, 0x0f, 0x67, 0x21,
+};
+static const uint8_t p256_hash[32] = {
+    0xaf, 0x2b, 0xdb, 0xe1, 0xaa, 0x9b, 0x6e, 0xc1, 0xe2, 0xad, 0xe1, 0xd6, 0x94, 0xf4, 0x1f, 0xc7,
+    0x1a, 0x83, 0x1d, 0x02, 0x68, 0xe9, 0x89, 0x15, 0x62, 0x11, 0x3d, 0x8a, 0x62, 0xad, 0xd1, 0xbf,
+};
+static const uint8_t p256_signature[64] = {
+    0xef, 0xd4, 0x8b, 0x2a, 0xac, 0xb6, 0xa8, 0xfd, 0x11, 0x40, 0xdd, 0x9c, 0xd4, 0x5e, 0x81, 0xd6,
+    0x9d, 0x2c, 0x87, 0x7b, 0x56, 0xaa, 0xf9, 0x91, 0xc3, 0x4d, 0x0e, 0xa8, 0x4e, 0xaf, 0x37, 0x16,
+    0xf7, 0xcb, 0x1c, 0x94, 0x2d, 0x65, 0x7c, 0x41, 0xd4, 0x36, 0xc7, 0xa1, 0xb6, 0xe2, 0x9f, 0x65,
+    0xf3, 0xe9, 0x00, 0xdb, 0xb9, 0xaf, 0xf4, 0x06, 0x4d, 0xc4, 0xab, 0x2f, 0x84, 0x3a, 0xcd, 0xa8,
+};
+
+/** RFC 8032 section 7.1, test 3: the Ed25519 seed, public key, two byte message and signature. */
+static const uint8_t ed25519_seed[32] = {
+    0xc5, 0xaa, 0x8d, 0xf4, 0x3f, 0x9f, 0x83, 0x7b, 0xed, 0xb7, 0x44, 0x2f, 0x31, 0xdc, 0xb7, 0xb1,
+    0x66, 0xd3, 0x85, 0x35, 0x07, 0x6f, 0x09, 0x4b, 0x85, 0xce, 0x3a, 0x2e, 0x0b, 0x44, 0x58, 0xf7,
+};
+static const uint8_t ed25519_public_key[32] = {
+    0xfc, 0x51, 0xcd, 0x8e, 0x62, 0x18, 0xa1, 0xa3, 0x8d, 0xa4, 0x7e, 0xd0, 0x02, 0x30, 0xf0, 0x58,
+    0x08, 0x16, 0xed, 0x13, 0xba, 0x33, 0x03, 0xac, 0x5d, 0xeb, 0x91, 0x15, 0x48, 0x90, 0x80, 0x25,
+};
+static const uint8_t ed25519_message[2] = {0xaf, 0x82};
+static const uint8_t ed25519_signature[64] = {
+    0x62, 0x91, 0xd6, 0x57, 0xde, 0xec, 0x24, 0x02, 0x48, 0x27, 0xe6, 0x9c, 0x3a, 0xbe, 0x01, 0xa3,
+    0x0c, 0xe5, 0x48, 0xa2, 0x84, 0x74, 0x3a, 0x44, 0x5e, 0x36, 0x80, 0xd7, 0xdb, 0x5a, 0xc3, 0xac,
+    0x18, 0xff, 0x9b, 0x53, 0x8d, 0x16, 0xf2, 0x90, 0xae, 0x67, 0xf7, 0x60, 0x98, 0x4d, 0xc6, 0x59,
+    0x4a, 0x7c, 0x15, 0xe9, 0x71, 0x6e, 0xd2, 0x8d, 0xc0, 0x27, 0xbe, 0xce, 0xea, 0x1e, 0xc4, 0x0a,
+};
+
+/** Has the firmware make a signature, and checks it. Returns false if the firmware can't. */
+static bool sign(const char *name, const uint8_t channel_id[4], const uint8_t *payload, uint16_t length,
+                 const uint8_t answer[64])
+{
+    uint8_t signature[64];
+    uint16_t response_count;
+    uint16_t count = build_request(channel_id, CTAPHID_VENDOR_SIGN_BENCH, payload, length);
+    char stack_name[32];
+
+    stack_pointer_min = avr->ramend;
+    avr_cycle_count_t cycles = transact(name, count, SIGN_TIMEOUT_CYCLES, &response_count);
+
+    if ((responses[0][4] & 0x7f) != CTAPHID_VENDOR_SIGN_BENCH || response_count != 2)
+        return false;
+
+    memcpy(signature, responses[0] + 7, INIT_PAYLOAD_LENGTH);
+    memcpy(signature + INIT_PAYLOAD_LENGTH, responses[1] + 5, sizeof(signature) - INIT_PAYLOAD_LENGTH);
+    if (memcmp(signature, answer, sizeof(signature)) != 0)
+    {
+        printf("%s: wrong answer\n", name);
+        exit(1);
+    }
+    report(name, length, count + response_count, cycles);
+    snprintf(stack_name, sizeof(stack_name), "%s_stack", name);
+    printf("%-24s %6u\n", stack_name, avr->ramend - stack_pointer_min);
+    return true;
+}
+
+static void bench_sign(const uint8_t channel_id[4])
+{
+    uint8_t payload[1 + 32 + 32 + sizeof(ed25519_message)];
+
+    payload[0] = SIGN_BENCH_P256;
+    memcpy(payload + 1, p256_private_key, 32);
+    memcpy(payload + 33, p256_hash, 32);
+    if (!sign("p256_sign", channel_id, payload, 65, p256_signature))
+    {
+        printf("signing not timed: build the firmware with SIGN_BENCH=1\n");
+        return;
+    }
+    report_ram_usage("p256_sign", channel_id);
+
+    payload[0] = SIGN_BENCH_ED25519;
+    memcpy(payload + 1, ed25519_seed, 32);
+    memcpy(payload + 33, ed25519_public_key, 32);
+    memcpy(payload + 65, ed25519_message, sizeof(ed25519_message));
+    if (sign("ed25519_sign", channel_id, payload, sizeof(payload), ed25519_signature))
+        report_ram_usage("ed25519_sign", channel_id);
+}
+
+static void report_interrupts(const interrupt_stats_t *s)
+{
+    printf("%-24s %6lu %12.1f %12llu\n", s->name, s->count, s->count ? (double)s->total / s->count : 0.0,
+           (unsigned long long)s->max);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "../FidoHID.elf";
+    elf_firmware_t firmware = {0};
+    uint8_t channel_id[4];
+
+    if (elf_read_firmware(path, &firmware) != 0)
+    {
+        fprintf(stderr, "can't read %s\n", path);
+        return 1;
+    }
+    // LUFA's build doesn't tag the ELF with its MCU, so it's given here.
+    firmware.frequency = F_CPU;
+
+    avr = avr_make_mcu_by_name(MCU);
+    if (avr == NULL)
+    {
+        fprintf(stderr, "simavr has no %s\n", MCU);
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+
+    watch_interrupt(USB_GEN_VECTOR, &usb_gen_stats);
+    watch_interrupt(USB_COM_VECTOR, &usb_com_stats);
+
+    enumerate();
+
+    printf("%-24s %6s %4s %12s %12s %12s\n", "benchmark", "bytes", "pkts", "cycles", "cycles/pkt", "pkts/s");
+    bench_init(channel_id);
+    bench_ping(channel_id);
+    report_ram_usage("ping", channel_id);
+    bench_sign(channel_id);
+
+    printf("%-24s %6s %12s %12s\n", "interrupt", "count", "mean cycles", "max cycles");
+    report_interrupts(&usb_gen_stats);
+    report_interrupts(&usb_com_stats);
+    return 0;
+}
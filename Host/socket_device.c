@@ -0,0 +1,168 @@
+/** \file
+ *
+ *  Runs the CTAPHID core on a thread of its own behind socket pairs that
+ *  behave as hidraw handles, so the host tests can drive it through
+ *  ctaphid_attach() just as the tools drive a real authenticator.
+ *
+ *  Each handle writes output reports led by a report number, which are taken
+ *  one at a time, round robin across the handles, as the emulated controller
+ *  has room for them. Every input report goes to every handle, as hidraw
+ *  does. The controller is stepped a frame per millisecond.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../FidoHID.h"
+
+#include "host_usb.h"
+#include "socket_device.h"
+
+/** Length of a USB frame, which the emulated controller is stepped by. */
+#define FRAME_NS 1000000ULL
+
+/** Handles that can be connected over a run. */
+#define MAX_HANDLES 256
+
+static int handles[MAX_HANDLES];
+static unsigned handle_count;
+static pthread_mutex_t handles_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t device_thread;
+static atomic_bool running;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** Reads the next waiting output report, starting from the handle after the last one read. */
+static bool read_report(uint8_t report[FIDO_REPORT_SIZE + 1])
+{
+    static unsigned next;
+    bool found = false;
+
+    pthread_mutex_lock(&handles_lock);
+    for (unsigned i = 0; i < handle_count && !found; i++)
+    {
+        unsigned h = (next + i) % handle_count;
+        ssize_t length;
+
+        if (handles[h] < 0)
+            continue;
+        length = read(handles[h], report, FIDO_REPORT_SIZE + 1);
+        if (length == FIDO_REPORT_SIZE + 1)
+        {
+            found = true;
+            next = h + 1;
+        }
+        else if (length == 0)
+        {
+            // The client's end was closed.
+            close(handles[h]);
+            handles[h] = -1;
+        }
+    }
+    pthread_mutex_unlock(&handles_lock);
+    return found;
+}
+
+static void write_report(const uint8_t report[FIDO_REPORT_SIZE])
+{
+    pthread_mutex_lock(&handles_lock);
+    for (unsigned h = 0; h < handle_count; h++)
+    {
+        if (handles[h] >= 0)
+            send(handles[h], report, FIDO_REPORT_SIZE, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    pthread_mutex_unlock(&handles_lock);
+}
+
+static void *device_main(void *arg)
+{
+    uint8_t out[FIDO_REPORT_SIZE + 1];
+    uint8_t in[FIDO_REPORT_SIZE];
+    bool pending = false;
+    uint64_t next_frame = now_ns() + FRAME_NS;
+
+    (void)arg;
+    SetupHardware();
+    init_state();
+    host_usb_attach();
+
+    while (running)
+    {
+        uint64_t now;
+
+        if (!pending)
+            pending = read_report(out);
+        if (pending && host_usb_out(FIDO_OUT_EPADDR, out + 1))
+            pending = false;
+
+        while (fido_task())
+            ;
+        host_usb_service();
+        while (host_usb_in(FIDO_IN_EPADDR, in))
+            write_report(in);
+
+        now = now_ns();
+        if (now >= next_frame)
+        {
+            host_usb_frame();
+            next_frame += FRAME_NS;
+        }
+        else
+        {
+            usleep(20);
+        }
+    }
+    return NULL;
+}
+
+void socket_device_start(void)
+{
+    running = true;
+    pthread_create(&device_thread, NULL, device_main, NULL);
+}
+
+void socket_device_stop(void)
+{
+    running = false;
+    pthread_join(device_thread, NULL);
+
+    for (unsigned h = 0; h < handle_count; h++)
+    {
+        if (handles[h] >= 0)
+            close(handles[h]);
+    }
+    handle_count = 0;
+}
+
+/** Connects a new handle to the device. Returns the client's end, for ctaphid_attach(), or -1. */
+int socket_device_connect(void)
+{
+    int pair[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) < 0)
+        return -1;
+    fcntl(pair[1], F_SETFL, O_NONBLOCK);
+
+    pthread_mutex_lock(&handles_lock);
+    if (handle_count == MAX_HANDLES)
+    {
+        pthread_mutex_unlock(&handles_lock);
+        close(pair[0]);
+        close(pair[1]);
+        return -1;
+    }
+    handles[handle_count++] = pair[1];
+    pthread_mutex_unlock(&handles_lock);
+    return pair[0];
+}
@@ -0,0 +1,14 @@
+/** \file
+ *
+ *  Header file for socket_device.c.
+ */
+
+#ifndef _SOCKET_DEVICE_H_
+#define _SOCKET_DEVICE_H_
+
+/* Function Prototypes: */
+void socket_device_start(void);
+void socket_device_stop(void);
+int socket_device_connect(void);
+
+#endif
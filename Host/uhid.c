@@ -0,0 +1,342 @@
+/** \file
+ *
+ *  Runs the CTAPHID core as a virtual HID authenticator through the Linux
+ *  kernel's uhid interface, so libfido2, fido2-token and browsers can talk to
+ *  it without a Leonardo. The device is registered with the firmware's own
+ *  device and report descriptors, and the kernel's reports are carried over
+ *  the emulated USB controller in host_usb.c, a frame per millisecond.
+ *
+ *  Each transaction's latency, from its request's init packet reaching the
+ *  firmware to its response's last packet leaving it, is printed as one line
+ *  as the response completes, and summarised per command on exit. Keepalives
+ *  sent meanwhile are counted rather than ending the transaction.
+ *
+ *  Usage: fidohid_uhid [/dev/uhid]. Opening uhid usually needs root.
+ */
+
+#define _GNU_SOURCE
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uhid.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../FidoHID.h"
+#include "../ctap2hid_packet.h"
+#include "../ctaphid.h"
+
+#include "host_usb.h"
+
+/** Length of a USB frame, which the emulated controller is stepped by. */
+#define FRAME_NS 1000000ULL
+
+/** Transactions timed at once. The firmware only keeps a few channels open, so this is plenty. */
+#define MAX_TIMED 8
+
+typedef struct
+{
+    bool active;
+    uint32_t channel_id;
+    uint8_t command_id;
+    uint16_t request_length;
+    uint64_t start;
+    // Response packets still to come, once its init packet's been seen.
+    uint16_t remaining;
+    uint16_t keepalives;
+} timed_transaction_t;
+
+typedef struct
+{
+    unsigned long count;
+    uint64_t total;
+    uint64_t max;
+} command_stats_t;
+
+static timed_transaction_t timed[MAX_TIMED];
+static command_stats_t stats[0x80];
+static volatile sig_atomic_t running = 1;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stop(int signal)
+{
+    (void)signal;
+    running = 0;
+}
+
+static uint16_t packets_for(uint16_t payload_length)
+{
+    if (payload_length <= INIT_PAYLOAD_LENGTH)
+        return 1;
+    return 1 + (payload_length - INIT_PAYLOAD_LENGTH + CONT_PAYLOAD_LENGTH - 1) / CONT_PAYLOAD_LENGTH;
+}
+
+static bool write_event(int fd, const struct uhid_event *event)
+{
+    if (write(fd, event, sizeof(*event)) != sizeof(*event))
+    {
+        perror("uhid write");
+        return false;
+    }
+    return true;
+}
+
+/** Registers the device, described as the firmware describes itself to a USB host. */
+static bool create_device(int fd)
+{
+    struct uhid_event event = {.type = UHID_CREATE2};
+    const USB_Descriptor_Device_t *device;
+    const USB_Descriptor_String_t *product;
+    const void *report;
+    uint16_t size;
+
+    if (CALLBACK_USB_GetDescriptor(DTYPE_Device << 8, 0, (const void **)&device) == NO_DESCRIPTOR)
+        return false;
+    size = CALLBACK_USB_GetDescriptor(DTYPE_String << 8 | STRING_ID_Product, 0, (const void **)&product);
+
+    // The product string is ASCII, as UTF-16.
+    for (uint16_t i = 0; i < (size - sizeof(USB_Descriptor_Header_t)) / 2 && i < sizeof(event.u.create2.name) - 1; i++)
+        event.u.create2.name[i] = product->UnicodeString[i];
+
+    size = CALLBACK_USB_GetDescriptor(HID_DTYPE_Report << 8, 0, &report);
+    memcpy(event.u.create2.rd_data, report, size);
+    event.u.create2.rd_size = size;
+    event.u.create2.bus = BUS_USB;
+    event.u.create2.vendor = device->VendorID;
+    event.u.create2.product = device->ProductID;
+    event.u.create2.version = device->ReleaseNumber;
+
+    return write_event(fd, &event);
+}
+
+static timed_transaction_t *find_timed(uint32_t channel_id)
+{
+    for (uint8_t i = 0; i < MAX_TIMED; i++)
+        if (timed[i].active && timed[i].channel_id == channel_id)
+            return &timed[i];
+    return NULL;
+}
+
+/** Starts timing a request once its init packet's been handed to the firmware. */
+static void request_sent(const ctap2hid_packet_t *packet, uint64_t now)
+{
+    timed_transaction_t *t;
+
+    if (!is_init_packet((ctap2hid_packet_t *)packet))
+        return;
+
+    // A new request on a channel abandons whatever was being timed on it.
+    t = find_timed(packet->channel_id);
+    for (uint8_t i = 0; t == NULL && i < MAX_TIMED; i++)
+        if (!timed[i].active)
+            t = &timed[i];
+    if (t == NULL)
+        return;
+
+    *t = (timed_transaction_t){
+        .active = true,
+        .channel_id = packet->channel_id,
+        .command_id = packet->init.command_id & 0x7f,
+        .request_length = SwapEndian_16(packet->init.payload_length),
+        .start = now,
+    };
+}
+
+/** Counts a response packet off its transaction, reporting the transaction once it's complete. */
+static void response_sent(const ctap2hid_packet_t *packet, uint64_t now)
+{
+    timed_transaction_t *t = find_timed(packet->channel_id);
+    uint16_t response_length;
+    uint64_t elapsed;
+    command_stats_t *s;
+
+    if (t == NULL)
+        return;
+
+    if (is_init_packet((ctap2hid_packet_t *)packet))
+    {
+        if ((packet->init.command_id & 0x7f) == CTAPHID_KEEPALIVE)
+        {
+            t->keepalives++;
+            return;
+        }
+        response_length = SwapEndian_16(packet->init.payload_length);
+        t->remaining = packets_for(response_length);
+    }
+    else if (t->remaining == 0)
+    {
+        return;
+    }
+
+    if (--t->remaining > 0)
+        return;
+
+    elapsed = now - t->start;
+    printf("%08x cmd 0x%02x %5u bytes %8.3f ms %3u keepalives\n", be32toh(t->channel_id), t->command_id,
+           t->request_length, elapsed / 1e6, t->keepalives);
+    fflush(stdout);
+
+    s = &stats[t->command_id];
+    s->count++;
+    s->total += elapsed;
+    if (elapsed > s->max)
+        s->max = elapsed;
+    t->active = false;
+}
+
+static void print_stats(void)
+{
+    printf("%-8s %8s %12s %12s\n", "command", "count", "mean ms", "max ms");
+    for (uint8_t command_id = 0; command_id < 0x80; command_id++)
+    {
+        command_stats_t *s = &stats[command_id];
+        if (s->count)
+            printf("0x%02x     %8lu %12.3f %12.3f\n", command_id, s->count, s->total / 1e6 / s->count, s->max / 1e6);
+    }
+}
+
+/** Handles an event from the kernel. An output report is copied to report, and true returned. */
+static bool read_event(int fd, uint8_t report[FIDO_REPORT_SIZE])
+{
+    struct uhid_event event;
+    struct uhid_event reply = {0};
+    const uint8_t *data;
+    uint16_t size;
+
+    if (read(fd, &event, sizeof(event)) <= 0)
+    {
+        if (errno != EINTR && errno != EAGAIN)
+        {
+            perror("uhid read");
+            running = 0;
+        }
+        return false;
+    }
+
+    switch (event.type)
+    {
+    case UHID_OUTPUT:
+        // hidraw writes start with the report number, 0 as the FIDO report isn't numbered.
+        data = event.u.output.data;
+        size = event.u.output.size;
+        if (size > FIDO_REPORT_SIZE)
+        {
+            data++;
+            size--;
+        }
+        memset(report, 0, FIDO_REPORT_SIZE);
+        memcpy(report, data, MIN(size, FIDO_REPORT_SIZE));
+        return true;
+    // The firmware has no feature reports.
+    case UHID_GET_REPORT:
+        reply.type = UHID_GET_REPORT_REPLY;
+        reply.u.get_report_reply.id = event.u.get_report.id;
+        reply.u.get_report_reply.err = EIO;
+        write_event(fd, &reply);
+        return false;
+    case UHID_SET_REPORT:
+        reply.type = UHID_SET_REPORT_REPLY;
+        reply.u.set_report_reply.id = event.u.set_report.id;
+        reply.u.set_report_reply.err = EIO;
+        write_event(fd, &reply);
+        return false;
+    default:
+        return false;
+    }
+}
+
+static void send_input(int fd, const uint8_t report[FIDO_REPORT_SIZE])
+{
+    struct uhid_event event = {.type = UHID_INPUT2};
+
+    memcpy(event.u.input2.data, report, FIDO_REPORT_SIZE);
+    event.u.input2.size = FIDO_REPORT_SIZE;
+    write_event(fd, &event);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "/dev/uhid";
+    struct uhid_event destroy = {.type = UHID_DESTROY};
+    struct sigaction action = {.sa_handler = stop};
+    uint8_t out_report[FIDO_REPORT_SIZE];
+    uint8_t in_report[FIDO_REPORT_SIZE];
+    bool out_pending = false;
+    uint64_t next_frame;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+    if (!create_device(fd))
+        return 1;
+
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    SetupHardware();
+    init_state();
+    host_usb_attach();
+
+    next_frame = now_ns() + FRAME_NS;
+    while (running)
+    {
+        uint64_t now = now_ns();
+
+        // Sleep until the next frame, or until the kernel has a report. A report the OUT endpoint
+        // hasn't room for yet is held, and no more are read, as a USB host's NAKed OUT is retried.
+        if (now < next_frame)
+        {
+            struct pollfd pfd = {.fd = fd, .events = out_pending ? 0 : POLLIN};
+            struct timespec timeout = {.tv_nsec = next_frame - now};
+
+            if (ppoll(&pfd, 1, &timeout, NULL) > 0 && (pfd.revents & POLLIN))
+                out_pending = read_event(fd, out_report);
+            now = now_ns();
+        }
+
+        if (out_pending && host_usb_out(FIDO_OUT_EPADDR, out_report))
+        {
+            out_pending = false;
+            request_sent((ctap2hid_packet_t *)out_report, now);
+        }
+
+        while (fido_task())
+            ;
+        host_usb_service();
+
+        while (host_usb_in(FIDO_IN_EPADDR, in_report))
+        {
+            send_input(fd, in_report);
+            response_sent((ctap2hid_packet_t *)in_report, now_ns());
+        }
+
+        if (now >= next_frame)
+        {
+            host_usb_frame();
+            next_frame += FRAME_NS;
+            // Frames missed while descheduled aren't made up all at once.
+            if (next_frame < now)
+                next_frame = now + FRAME_NS;
+        }
+    }
+
+    write_event(fd, &destroy);
+    close(fd);
+    print_stats();
+    return 0;
+}
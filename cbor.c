@@ -0,0 +1,256 @@
+#include "cbor.h"
+
+// Additional information values for arguments that follow the initial byte.
+#define CBOR_ARG_1 24
+#define CBOR_ARG_8 27
+#define CBOR_INDEFINITE 31
+
+cbor_parser_t cbor_parser(const ctap2hid_message_view_t *view, uint16_t offset)
+{
+    cbor_parser_t p = {.cursor = view_cursor(view)};
+    view_skip(&p.cursor, offset);
+    return p;
+}
+
+bool cbor_at_end(cbor_parser_t *p)
+{
+    return view_remaining(&p->cursor) == 0;
+}
+
+static uint8_t read_head(ctap2hid_view_cursor_t *c, cbor_head_t *head)
+{
+    uint8_t initial;
+    if (!view_read(c, &initial, 1))
+        return CTAP2_ERR_INVALID_CBOR;
+
+    uint8_t info = initial & 0x1f;
+    head->type = initial >> 5;
+    head->value = info;
+
+    if (info >= CBOR_ARG_1)
+    {
+        if (info > CBOR_ARG_8)
+            return CTAP2_ERR_INVALID_CBOR; // reserved, or an indefinite length
+
+        // The argument is big endian in the next 1, 2, 4 or 8 bytes, and must need that many.
+        uint8_t size = 1 << (info - CBOR_ARG_1);
+        uint8_t bytes[8];
+        if (view_read(c, bytes, size) != size)
+            return CTAP2_ERR_INVALID_CBOR;
+
+        uint32_t high = 0;
+        head->value = 0;
+        for (uint8_t i = 0; i < size; i++)
+        {
+            high = (high << 8) | (head->value >> 24);
+            head->value = (head->value << 8) | bytes[i];
+        }
+
+        if (high)
+            return CTAP2_ERR_LIMIT_EXCEEDED;
+
+        uint32_t minimum = size == 1 ? CBOR_ARG_1 : 1UL << (size * 4);
+        if (size == 8 || head->value < minimum)
+            return CTAP2_ERR_INVALID_CBOR;
+    }
+
+    switch (head->type)
+    {
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+        if (head->value > view_remaining(c))
+            return CTAP2_ERR_INVALID_CBOR;
+        break;
+    case CBOR_ARRAY:
+        // Every item takes at least a byte, so a count that can't fit is known to be truncated.
+        if (head->value > view_remaining(c))
+            return CTAP2_ERR_INVALID_CBOR;
+        break;
+    case CBOR_MAP:
+        if (head->value > view_remaining(c) / 2)
+            return CTAP2_ERR_INVALID_CBOR;
+        break;
+    case CBOR_TAG:
+        return CTAP2_ERR_INVALID_CBOR;
+    case CBOR_SIMPLE:
+        if (head->value < CBOR_FALSE || head->value > CBOR_NULL)
+            return CTAP2_ERR_INVALID_CBOR;
+        break;
+    }
+
+    return CTAP2_OK;
+}
+
+// Returns the major type of the next data item without consuming it, or 0xff at the end.
+uint8_t cbor_peek_type(cbor_parser_t *p)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    uint8_t initial;
+
+    if (!view_read(&c, &initial, 1))
+        return 0xff;
+    return initial >> 5;
+}
+
+uint8_t cbor_read_head(cbor_parser_t *p, cbor_head_t *head)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    uint8_t status = read_head(&c, head);
+
+    if (status == CTAP2_OK)
+        p->cursor = c;
+    return status;
+}
+
+static uint8_t read_typed(cbor_parser_t *p, uint8_t type, cbor_head_t *head)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    uint8_t status = read_head(&c, head);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (head->type != type)
+        return CTAP2_ERR_CBOR_UNEXPECTED_TYPE;
+
+    p->cursor = c;
+    return CTAP2_OK;
+}
+
+uint8_t cbor_read_uint(cbor_parser_t *p, uint32_t *value)
+{
+    cbor_head_t head;
+    uint8_t status = read_typed(p, CBOR_UNSIGNED, &head);
+
+    if (status == CTAP2_OK)
+        *value = head.value;
+    return status;
+}
+
+uint8_t cbor_read_int(cbor_parser_t *p, int32_t *value)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    cbor_head_t head;
+    uint8_t status = read_head(&c, &head);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (head.type != CBOR_UNSIGNED && head.type != CBOR_NEGATIVE)
+        return CTAP2_ERR_CBOR_UNEXPECTED_TYPE;
+    if (head.value > INT32_MAX)
+        return CTAP2_ERR_LIMIT_EXCEEDED;
+
+    *value = head.type == CBOR_UNSIGNED ? (int32_t)head.value : -1 - (int32_t)head.value;
+    p->cursor = c;
+    return CTAP2_OK;
+}
+
+uint8_t cbor_read_bool(cbor_parser_t *p, bool *value)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    cbor_head_t head;
+    uint8_t status = read_head(&c, &head);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (head.type != CBOR_SIMPLE || head.value == CBOR_NULL)
+        return CTAP2_ERR_CBOR_UNEXPECTED_TYPE;
+
+    *value = head.value == CBOR_TRUE;
+    p->cursor = c;
+    return CTAP2_OK;
+}
+
+// Strings are returned as a cursor over just their bytes, wherever they lie in the message, which
+// the caller reads with view_next_chunk (or view_read) like any other view.
+static uint8_t read_string(cbor_parser_t *p, uint8_t type, ctap2hid_view_cursor_t *span)
+{
+    cbor_head_t head;
+    uint8_t status = read_typed(p, type, &head);
+
+    if (status != CTAP2_OK)
+        return status;
+
+    *span = p->cursor;
+    span->remaining = head.value;
+    view_skip(&p->cursor, head.value);
+    return CTAP2_OK;
+}
+
+uint8_t cbor_read_bytes(cbor_parser_t *p, ctap2hid_view_cursor_t *span)
+{
+    return read_string(p, CBOR_BYTES, span);
+}
+
+uint8_t cbor_read_text(cbor_parser_t *p, ctap2hid_view_cursor_t *span)
+{
+    return read_string(p, CBOR_TEXT, span);
+}
+
+uint8_t cbor_read_array(cbor_parser_t *p, uint16_t *count)
+{
+    cbor_head_t head;
+    uint8_t status = read_typed(p, CBOR_ARRAY, &head);
+
+    if (status == CTAP2_OK)
+        *count = head.value;
+    return status;
+}
+
+uint8_t cbor_read_map(cbor_parser_t *p, uint16_t *count)
+{
+    cbor_head_t head;
+    uint8_t status = read_typed(p, CBOR_MAP, &head);
+
+    if (status == CTAP2_OK)
+        *count = head.value;
+    return status;
+}
+
+// Skips the next data item, including everything nested in it, without recursing.
+uint8_t cbor_skip(cbor_parser_t *p)
+{
+    ctap2hid_view_cursor_t c = p->cursor;
+    uint32_t items = 1;
+
+    while (items > 0)
+    {
+        cbor_head_t head;
+        uint8_t status = read_head(&c, &head);
+
+        if (status != CTAP2_OK)
+            return status;
+        items--;
+
+        if (head.type == CBOR_BYTES || head.type == CBOR_TEXT)
+            view_skip(&c, head.value);
+        else if (head.type == CBOR_ARRAY || head.type == CBOR_MAP)
+        {
+            // read_head bounds the count by the bytes left, so this can't overflow.
+            items += head.value * (head.type == CBOR_MAP ? 2 : 1);
+            if (items > view_remaining(&c))
+                return CTAP2_ERR_INVALID_CBOR;
+        }
+    }
+
+    p->cursor = c;
+    return CTAP2_OK;
+}
+
+bool span_equals(ctap2hid_view_cursor_t span, const void *data, uint16_t length)
+{
+    const uint8_t *expected = data;
+    const uint8_t *chunk;
+    uint16_t size;
+
+    if (view_remaining(&span) != length)
+        return false;
+
+    while ((size = view_next_chunk(&span, &chunk, length)))
+    {
+        bool progmem = view_chunk_in_progmem(&span);
+        if ((progmem ? memcmp_P(expected, chunk, size) : memcmp(chunk, expected, size)) != 0)
+            return false;
+        expected += size;
+    }
+    return true;
+}
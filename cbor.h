@@ -0,0 +1,55 @@
+#include "ctap2hid_message.h"
+#include "ctap2.h"
+
+#ifndef _CBOR_H_
+#define _CBOR_H_
+
+// CBOR major types
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+// CBOR simple values
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+
+// A data item's head: its major type and argument. The argument is the integer's value (for
+// negative integers, -1 - value), the string's length in bytes, the number of array items or map
+// pairs, or the simple value.
+typedef struct
+{
+    uint8_t type;
+    uint32_t value;
+} cbor_head_t;
+
+// Pulls data items one at a time from a message view, straight out of the memory the view
+// describes. Only the CTAP2 canonical form is accepted: definite lengths, shortest form arguments,
+// no floats and no simple values but false, true and null. Arguments over 32 bits are rejected too,
+// nothing in CTAP2 needs them. Reads that fail leave the parser where it was.
+typedef struct
+{
+    ctap2hid_view_cursor_t cursor;
+} cbor_parser_t;
+
+cbor_parser_t cbor_parser(const ctap2hid_message_view_t *view, uint16_t offset);
+uint8_t cbor_peek_type(cbor_parser_t *p);
+uint8_t cbor_read_head(cbor_parser_t *p, cbor_head_t *head);
+uint8_t cbor_read_uint(cbor_parser_t *p, uint32_t *value);
+uint8_t cbor_read_int(cbor_parser_t *p, int32_t *value);
+uint8_t cbor_read_bool(cbor_parser_t *p, bool *value);
+uint8_t cbor_read_bytes(cbor_parser_t *p, ctap2hid_view_cursor_t *span);
+uint8_t cbor_read_text(cbor_parser_t *p, ctap2hid_view_cursor_t *span);
+uint8_t cbor_read_array(cbor_parser_t *p, uint16_t *count);
+uint8_t cbor_read_map(cbor_parser_t *p, uint16_t *count);
+uint8_t cbor_skip(cbor_parser_t *p);
+bool cbor_at_end(cbor_parser_t *p);
+
+bool span_equals(ctap2hid_view_cursor_t span, const void *data, uint16_t length);
+
+#endif
@@ -0,0 +1,75 @@
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "chacha20.h"
+
+// "expand 32-byte k"
+static const uint32_t constants[4] PROGMEM = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+
+static uint32_t rotl(uint32_t x, uint8_t n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+    return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+static void store_le32(uint8_t *p, uint32_t x)
+{
+    p[0] = x;
+    p[1] = x >> 8;
+    p[2] = x >> 16;
+    p[3] = x >> 24;
+}
+
+static void quarter_round(uint32_t *x, uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+    x[a] += x[b];
+    x[d] = rotl(x[d] ^ x[a], 16);
+    x[c] += x[d];
+    x[b] = rotl(x[b] ^ x[c], 12);
+    x[a] += x[b];
+    x[d] = rotl(x[d] ^ x[a], 8);
+    x[c] += x[d];
+    x[b] = rotl(x[b] ^ x[c], 7);
+}
+
+// The ChaCha20 block function of RFC 8439. Each word of the input is rebuilt from the key and nonce
+// when it's added back in at the end, rather than keeping a second copy of the state, so block
+// mustn't overlap key or nonce.
+void chacha20_block(const uint8_t key[CHACHA20_KEY_LENGTH], uint32_t counter, const uint8_t nonce[CHACHA20_NONCE_LENGTH], uint8_t block[CHACHA20_BLOCK_LENGTH])
+{
+    uint32_t x[16];
+
+    memcpy_P(x, constants, sizeof(constants));
+    for (uint8_t i = 0; i < 8; i++)
+        x[4 + i] = load_le32(key + 4 * i);
+    x[12] = counter;
+    for (uint8_t i = 0; i < 3; i++)
+        x[13 + i] = load_le32(nonce + 4 * i);
+
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        quarter_round(x, 0, 4, 8, 12);
+        quarter_round(x, 1, 5, 9, 13);
+        quarter_round(x, 2, 6, 10, 14);
+        quarter_round(x, 3, 7, 11, 15);
+        quarter_round(x, 0, 5, 10, 15);
+        quarter_round(x, 1, 6, 11, 12);
+        quarter_round(x, 2, 7, 8, 13);
+        quarter_round(x, 3, 4, 9, 14);
+    }
+
+    x[12] += counter;
+    for (uint8_t i = 0; i < 4; i++)
+        x[i] += pgm_read_dword(&constants[i]);
+    for (uint8_t i = 0; i < 8; i++)
+        x[4 + i] += load_le32(key + 4 * i);
+    for (uint8_t i = 0; i < 3; i++)
+        x[13 + i] += load_le32(nonce + 4 * i);
+
+    for (uint8_t i = 0; i < 16; i++)
+        store_le32(block + 4 * i, x[i]);
+}
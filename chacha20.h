@@ -0,0 +1,13 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _CHACHA20_H_
+#define _CHACHA20_H_
+
+#define CHACHA20_KEY_LENGTH 32
+#define CHACHA20_NONCE_LENGTH 12
+#define CHACHA20_BLOCK_LENGTH 64
+
+void chacha20_block(const uint8_t key[CHACHA20_KEY_LENGTH], uint32_t counter, const uint8_t nonce[CHACHA20_NONCE_LENGTH], uint8_t block[CHACHA20_BLOCK_LENGTH]);
+
+#endif
@@ -0,0 +1,54 @@
+#include "channel_table.h"
+#include "ctaphid.h"
+
+#define INDEX_MASK (CHANNEL_TABLE_SIZE - 1)
+
+channel_table_t ct_init(void)
+{
+    channel_table_t t = {.ids = {}};
+
+    for (uint8_t i = 0; i < CHANNEL_TABLE_SIZE; i++)
+        t.order[i] = i;
+    return t;
+}
+
+bool ct_is_open(channel_table_t *t, uint32_t channel_id)
+{
+    return channel_id != 0 && t->ids[channel_id & INDEX_MASK] == channel_id;
+}
+
+// Moves an entry to the front of the order.
+static void touch_index(channel_table_t *t, uint8_t index)
+{
+    uint8_t i = 0;
+    while (t->order[i] != index)
+        i++;
+    for (; i > 0; i--)
+        t->order[i] = t->order[i - 1];
+    t->order[0] = index;
+}
+
+void ct_touch(channel_table_t *t, uint32_t channel_id)
+{
+    if (ct_is_open(t, channel_id))
+        touch_index(t, channel_id & INDEX_MASK);
+}
+
+// Allocates a channel in the least recently used entry. evicted is set to the channel that was
+// there, or 0 if the entry was free.
+uint32_t ct_open(channel_table_t *t, drbg_t *drbg, uint32_t *evicted)
+{
+    uint8_t index = t->order[CHANNEL_TABLE_SIZE - 1];
+    uint32_t channel_id;
+
+    do
+    {
+        drbg_read(drbg, (uint8_t *)&channel_id, sizeof(channel_id));
+        channel_id = (channel_id & ~(uint32_t)INDEX_MASK) | index;
+    } while (channel_id == 0 || channel_id == CTAPHID_BROADCAST_CID || channel_id == t->ids[index]);
+
+    *evicted = t->ids[index];
+    t->ids[index] = channel_id;
+    touch_index(t, index);
+    return channel_id;
+}
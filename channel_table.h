@@ -0,0 +1,25 @@
+#include "drbg.h"
+
+#ifndef _CHANNEL_TABLE_H_
+#define _CHANNEL_TABLE_H_
+
+#define CHANNEL_TABLE_BITS 2
+#define CHANNEL_TABLE_SIZE (1 << CHANNEL_TABLE_BITS)
+
+// The channels CTAPHID_INIT has allocated. An ID's low bits are the index of its entry and the rest
+// are random, so looking one up is a single comparison. Entries are kept in order of use, and once
+// they're all taken a new channel replaces the least recently used.
+typedef struct
+{
+    // 0 for a free entry, which is never a channel ID.
+    uint32_t ids[CHANNEL_TABLE_SIZE];
+    // Entry indices, most recently used first.
+    uint8_t order[CHANNEL_TABLE_SIZE];
+} channel_table_t;
+
+channel_table_t ct_init(void);
+bool ct_is_open(channel_table_t *t, uint32_t channel_id);
+void ct_touch(channel_table_t *t, uint32_t channel_id);
+uint32_t ct_open(channel_table_t *t, drbg_t *drbg, uint32_t *evicted);
+
+#endif
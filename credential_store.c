@@ -0,0 +1,266 @@
+#include <avr/eeprom.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "credential_store.h"
+#include "ctap2.h"
+
+#define VERSION_ADDRESS 0
+
+static uint8_t read_byte(uint16_t address)
+{
+    return eeprom_read_byte((const uint8_t *)(uintptr_t)address);
+}
+
+static void update_byte(uint16_t address, uint8_t value)
+{
+    eeprom_update_byte((uint8_t *)(uintptr_t)address, value);
+}
+
+static uint8_t index_entry(uint8_t block)
+{
+    return read_byte(block);
+}
+
+static uint16_t record_address(uint8_t block)
+{
+    return (uint16_t)block * CS_BLOCK_SIZE;
+}
+
+static uint8_t tag_of(const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH])
+{
+    return rp_id_hash[CS_RP_ID_HASH_LENGTH] % CS_CONTINUED;
+}
+
+static uint8_t blocks_for(uint8_t user_id_length)
+{
+    return (sizeof(credential_t) + user_id_length + CS_BLOCK_SIZE - 1) / CS_BLOCK_SIZE;
+}
+
+// Writes a byte once the EEPROM's finished with the last one. Returns whether it was written.
+static bool write_byte(uint16_t address, uint8_t value)
+{
+    if (!eeprom_is_ready())
+        return false;
+    update_byte(address, value);
+    return true;
+}
+
+// Checks the stored half of a record's rpIdHash, stopping at the first byte that differs.
+static bool matches(uint8_t block, const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH])
+{
+    uint16_t address = record_address(block) + offsetof(credential_t, rp_id_hash);
+
+    for (uint8_t i = 0; i < CS_RP_ID_HASH_LENGTH; i++)
+        if (read_byte(address + i) != rp_id_hash[i])
+            return false;
+    return true;
+}
+
+static bool same_user(uint8_t block, ctap2hid_view_cursor_t user_id)
+{
+    uint16_t address = record_address(block);
+    uint8_t length = view_remaining(&user_id);
+
+    if (read_byte(address + offsetof(credential_t, user_id_length)) != length)
+        return false;
+
+    address += sizeof(credential_t);
+    for (uint8_t i = 0; i < length; i++)
+    {
+        uint8_t byte;
+        view_read(&user_id, &byte, 1);
+        if (read_byte(address + i) != byte)
+            return false;
+    }
+    return true;
+}
+
+// Finds the first of a row of free blocks, counting a record that's being replaced as free. Returns
+// CS_NONE if there's no row long enough.
+static uint8_t allocate(uint8_t blocks, uint8_t reclaim)
+{
+    uint8_t run = 0;
+    bool reclaiming = false;
+
+    for (uint8_t block = 1; block < CS_BLOCKS; block++)
+    {
+        uint8_t entry = index_entry(block);
+
+        if (block == reclaim)
+            reclaiming = true;
+        else if (entry != CS_CONTINUED)
+            reclaiming = false;
+
+        if (entry == CS_FREE || reclaiming)
+        {
+            if (++run == blocks)
+                return block - blocks + 1;
+        }
+        else
+            run = 0;
+    }
+    return CS_NONE;
+}
+
+// Formats the store if it's from another layout, and frees blocks left behind by a power cut. Both
+// write with interrupts enabled but block the main loop, which is only acceptable at boot.
+void cs_init(void)
+{
+    uint8_t previous = CS_FREE;
+
+    if (read_byte(VERSION_ADDRESS) != CS_VERSION)
+    {
+        for (uint8_t block = 1; block < CS_BLOCKS; block++)
+            update_byte(block, CS_FREE);
+        update_byte(VERSION_ADDRESS, CS_VERSION);
+    }
+
+    for (uint8_t block = 1; block < CS_BLOCKS; block++)
+    {
+        uint8_t entry = index_entry(block);
+
+        if (entry == CS_CONTINUED && previous == CS_FREE)
+        {
+            update_byte(block, CS_FREE);
+            entry = CS_FREE;
+        }
+        previous = entry;
+    }
+}
+
+// Returns the first record after the given block whose rpIdHash matches, or CS_NONE. Start from
+// CS_NONE, and pass the last record found to find the next.
+uint8_t cs_find(const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH], uint8_t after)
+{
+    uint8_t tag = tag_of(rp_id_hash);
+
+    for (uint8_t block = after + 1; block < CS_BLOCKS; block++)
+        if (index_entry(block) == tag && matches(block, rp_id_hash))
+            return block;
+    return CS_NONE;
+}
+
+void cs_read(uint8_t block, credential_t *c)
+{
+    eeprom_read_block(c, (const void *)(uintptr_t)record_address(block), sizeof(*c));
+}
+
+// Reads the first length bytes of a record's user ID, which should be no more than its user_id_length.
+void cs_read_user_id(uint8_t block, uint8_t *user_id, uint8_t length)
+{
+    eeprom_read_block(user_id, (const void *)(uintptr_t)(record_address(block) + sizeof(credential_t)), length);
+}
+
+// Starts storing a credential, replacing any of the same rpId and user ID. The user ID is read from
+// its cursor as it's written, so what it points into has to stay put until cs_write_step is done.
+uint8_t cs_store(cs_writer_t *w, const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH], const uint8_t nonce[CS_NONCE_LENGTH],
+                 int8_t algorithm, ctap2hid_view_cursor_t user_id)
+{
+    uint16_t length = view_remaining(&user_id);
+    uint8_t old_block = CS_NONE;
+
+    if (length > CS_MAX_USER_ID_LENGTH)
+        return CTAP2_ERR_LIMIT_EXCEEDED;
+
+    while ((old_block = cs_find(rp_id_hash, old_block)) != CS_NONE)
+        if (same_user(old_block, user_id))
+            break;
+
+    w->blocks = blocks_for(length);
+    w->block = allocate(w->blocks, CS_NONE);
+    w->old_block = old_block;
+
+    if (w->block != CS_NONE)
+        w->state = CS_WRITE_RECORD;
+    else if (old_block != CS_NONE && allocate(w->blocks, old_block) != CS_NONE)
+        w->state = CS_FREE_TAG;
+    else
+        return CTAP2_ERR_KEY_STORE_FULL;
+
+    memcpy(w->record.rp_id_hash, rp_id_hash, CS_RP_ID_HASH_LENGTH);
+    memcpy(w->record.nonce, nonce, CS_NONCE_LENGTH);
+    w->record.algorithm = algorithm;
+    w->record.user_id_length = length;
+    w->user_id = user_id;
+    w->tag = tag_of(rp_id_hash);
+    w->position = 0;
+    return CTAP2_OK;
+}
+
+// Starts deleting the record at a block found by cs_find.
+void cs_delete(cs_writer_t *w, uint8_t block)
+{
+    w->state = CS_FREE_TAG;
+    w->block = CS_NONE;
+    w->blocks = 0;
+    w->old_block = block;
+}
+
+// Writes the next byte, if the EEPROM's ready for it. Returns true once the store or delete is done.
+bool cs_write_step(cs_writer_t *w)
+{
+    uint8_t byte;
+
+    switch (w->state)
+    {
+    case CS_WRITE_RECORD:
+        if (w->position == sizeof(credential_t) + w->record.user_id_length)
+        {
+            w->state = CS_WRITE_CONTINUED;
+            w->position = 1;
+            return false;
+        }
+        if (!eeprom_is_ready())
+            return false;
+        if (w->position < sizeof(credential_t))
+            byte = ((const uint8_t *)&w->record)[w->position];
+        else
+            view_read(&w->user_id, &byte, 1);
+        update_byte(record_address(w->block) + w->position++, byte);
+        return false;
+
+    case CS_WRITE_CONTINUED:
+        if (w->position == w->blocks)
+            w->state = CS_WRITE_TAG;
+        else if (write_byte(w->block + w->position, CS_CONTINUED))
+            w->position++;
+        return false;
+
+    case CS_WRITE_TAG:
+        if (write_byte(w->block, w->tag))
+            w->state = w->old_block != CS_NONE ? CS_FREE_TAG : CS_WRITE_DONE;
+        return w->state == CS_WRITE_DONE;
+
+    case CS_FREE_TAG:
+        if (write_byte(w->old_block, CS_FREE))
+        {
+            w->state = CS_FREE_CONTINUED;
+            w->position = w->old_block + 1;
+        }
+        return false;
+
+    case CS_FREE_CONTINUED:
+        if (w->position < CS_BLOCKS && index_entry(w->position) == CS_CONTINUED)
+        {
+            if (write_byte(w->position, CS_FREE))
+                w->position++;
+            return false;
+        }
+
+        w->old_block = CS_NONE;
+        if (w->blocks && w->block == CS_NONE)
+        {
+            // The record it replaced has made room for it.
+            w->block = allocate(w->blocks, CS_NONE);
+            w->state = CS_WRITE_RECORD;
+            w->position = 0;
+            return false;
+        }
+        w->state = CS_WRITE_DONE;
+        return true;
+
+    default:
+        return true;
+    }
+}
@@ -0,0 +1,84 @@
+#include <avr/io.h>
+
+#include "ctap2hid_message.h"
+#include "sha256.h"
+
+#ifndef _CREDENTIAL_STORE_H_
+#define _CREDENTIAL_STORE_H_
+
+// Discoverable credentials, kept in the EEPROM. It's split into blocks, and block 0 is the index: the
+// layout's version, then an entry for each of the other blocks. A record takes one or more blocks in
+// a row. The entry of its first is a tag hashed from its rpIdHash, and the entries of the rest are
+// CS_CONTINUED. EEPROM is read a byte at a time, so a lookup reads the index and then only the
+// records whose tag matches. That's 31 bytes and usually one record's rpIdHash, however many
+// credentials are stored.
+#define CS_BLOCK_SIZE 32
+#define CS_BLOCKS ((E2END + 1) / CS_BLOCK_SIZE)
+#define CS_VERSION 1
+
+// Index entries other than tags. Erased EEPROM reads as 0xff, so a blank chip is an empty store.
+#define CS_FREE 0xff
+#define CS_CONTINUED 0xfe
+
+// Block 0 is the index, so no record starts there.
+#define CS_NONE 0
+
+// Only the leading half of the rpIdHash is kept. The tag comes from the byte after it.
+#define CS_RP_ID_HASH_LENGTH 16
+#define CS_NONCE_LENGTH 12
+#define CS_MAX_USER_ID_LENGTH 64
+
+#if CS_BLOCKS > CS_BLOCK_SIZE
+#error "The credential store's index has to fit in its first block"
+#endif
+
+// A record's fixed part, followed by the user ID. The nonce is random, and is the credential's ID.
+typedef struct
+{
+    uint8_t rp_id_hash[CS_RP_ID_HASH_LENGTH];
+    uint8_t nonce[CS_NONCE_LENGTH];
+    int8_t algorithm;
+    uint8_t user_id_length;
+} credential_t;
+
+typedef enum
+{
+    CS_WRITE_RECORD,
+    CS_WRITE_CONTINUED,
+    CS_WRITE_TAG,
+    CS_FREE_TAG,
+    CS_FREE_CONTINUED,
+    CS_WRITE_DONE,
+} cs_write_state_t;
+
+// Stores or deletes a record a byte at a time. Each EEPROM byte takes milliseconds to write, so the
+// job yields between them. A new record's blocks are written before its tag, so it's either all there
+// or not there at all. A record it replaces is freed afterwards, unless the store's too full to hold
+// both, in which case it's freed first. A power cut part way through can leave CS_CONTINUED entries
+// after a free block, and cs_init frees those.
+typedef struct
+{
+    cs_write_state_t state;
+    credential_t record;
+    // The user ID's bytes, read from the request as they're written.
+    ctap2hid_view_cursor_t user_id;
+    uint8_t tag;
+    // The record being written, CS_NONE until it's been given blocks, and how many it needs.
+    uint8_t block;
+    uint8_t blocks;
+    // The record being freed, or CS_NONE.
+    uint8_t old_block;
+    // The next byte of the record or block to write.
+    uint8_t position;
+} cs_writer_t;
+
+void cs_init(void);
+uint8_t cs_find(const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH], uint8_t after);
+void cs_read(uint8_t block, credential_t *c);
+void cs_read_user_id(uint8_t block, uint8_t *user_id, uint8_t length);
+uint8_t cs_store(cs_writer_t *w, const uint8_t rp_id_hash[SHA256_DIGEST_LENGTH], const uint8_t nonce[CS_NONCE_LENGTH],
+                 int8_t algorithm, ctap2hid_view_cursor_t user_id);
+void cs_delete(cs_writer_t *w, uint8_t block);
+bool cs_write_step(cs_writer_t *w);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _CTAP2_H_
+#define _CTAP2_H_
+
+// CTAP2 Commands (the first byte of a CTAPHID_CBOR request)
+#define CTAP2_MAKE_CREDENTIAL 0x01
+#define CTAP2_GET_ASSERTION 0x02
+#define CTAP2_GET_INFO 0x04
+#define CTAP2_CLIENT_PIN 0x06
+#define CTAP2_RESET 0x07
+#define CTAP2_GET_NEXT_ASSERTION 0x08
+
+// CTAP2 Status Codes (the first byte of a CTAPHID_CBOR response)
+#define CTAP2_OK 0x00
+#define CTAP1_ERR_INVALID_COMMAND 0x01
+#define CTAP1_ERR_INVALID_PARAMETER 0x02
+#define CTAP1_ERR_INVALID_LENGTH 0x03
+#define CTAP1_ERR_OTHER 0x7F
+#define CTAP2_ERR_CBOR_UNEXPECTED_TYPE 0x11
+#define CTAP2_ERR_INVALID_CBOR 0x12
+#define CTAP2_ERR_MISSING_PARAMETER 0x14
+#define CTAP2_ERR_LIMIT_EXCEEDED 0x15
+#define CTAP2_ERR_UNSUPPORTED_EXTENSION 0x16
+#define CTAP2_ERR_CREDENTIAL_EXCLUDED 0x19
+#define CTAP2_ERR_PROCESSING 0x21
+#define CTAP2_ERR_INVALID_CREDENTIAL 0x22
+#define CTAP2_ERR_USER_ACTION_PENDING 0x23
+#define CTAP2_ERR_OPERATION_PENDING 0x24
+#define CTAP2_ERR_NO_OPERATIONS 0x25
+#define CTAP2_ERR_UNSUPPORTED_ALGORITHM 0x26
+#define CTAP2_ERR_OPERATION_DENIED 0x27
+#define CTAP2_ERR_KEY_STORE_FULL 0x28
+#define CTAP2_ERR_UNSUPPORTED_OPTION 0x2B
+#define CTAP2_ERR_INVALID_OPTION 0x2C
+#define CTAP2_ERR_KEEPALIVE_CANCEL 0x2D
+#define CTAP2_ERR_NO_CREDENTIALS 0x2E
+#define CTAP2_ERR_USER_ACTION_TIMEOUT 0x2F
+#define CTAP2_ERR_NOT_ALLOWED 0x30
+#define CTAP2_ERR_PIN_REQUIRED 0x36
+
+// COSE Algorithms
+#define COSE_ALG_ES256 (-7)
+#define COSE_ALG_EDDSA (-8)
+
+#endif
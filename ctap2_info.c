@@ -0,0 +1,27 @@
+#include "ctap2_info.h"
+#include "ctap2.h"
+
+// maxMsgSize is encoded below as a two byte argument, which is only canonical from 256 up.
+#if CTAPHID_MAX_MESSAGE_SIZE < 256 || CTAPHID_MAX_MESSAGE_SIZE > 0xffff
+#error CTAPHID_MAX_MESSAGE_SIZE must be encoded differently in the authenticatorGetInfo response
+#endif
+
+// The whole authenticatorGetInfo response, status byte included, precomputed in canonical CBOR. It's
+// streamed from flash as it's sent, so answering getInfo costs no RAM.
+const uint8_t ctap2_info_response[] PROGMEM = {
+    CTAP2_OK,
+    0xa4, // map(4)
+    0x01, // versions
+    0x81, 0x68, 'F', 'I', 'D', 'O', '_', '2', '_', '0',
+    0x03, // aaguid
+    0x50, 0x9c, 0x3e, 0x6a, 0x41, 0x58, 0x0d, 0x4f, 0x27, 0xb1, 0x62, 0x15, 0xa4, 0x6e, 0x2f, 0x83, 0xd0,
+    0x04, // options
+    0xa3,
+    0x62, 'r', 'k', 0xf4,
+    0x62, 'u', 'p', 0xf5,
+    0x64, 'p', 'l', 'a', 't', 0xf4,
+    0x05, // maxMsgSize
+    0x19, CTAPHID_MAX_MESSAGE_SIZE >> 8, CTAPHID_MAX_MESSAGE_SIZE & 0xff,
+};
+
+const uint16_t ctap2_info_response_length = sizeof(ctap2_info_response);
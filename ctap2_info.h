@@ -0,0 +1,10 @@
+#include <avr/pgmspace.h>
+#include "ctap2hid_message.h"
+
+#ifndef _CTAP2_INFO_H_
+#define _CTAP2_INFO_H_
+
+extern const uint8_t ctap2_info_response[] PROGMEM;
+extern const uint16_t ctap2_info_response_length;
+
+#endif
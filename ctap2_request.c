@@ -0,0 +1,390 @@
+#include "ctap2_request.h"
+
+static const char public_key[] = "public-key";
+
+#define TEXT_EQUALS(span, text) span_equals(span, text, sizeof(text) - 1)
+
+// Integer map keys have to be in canonical order, which for the unsigned keys CTAP2 uses is simply
+// ascending.
+static uint8_t read_key(cbor_parser_t *p, uint32_t *key, uint32_t *previous)
+{
+    uint8_t status = cbor_read_uint(p, key);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (*previous != UINT32_MAX && *key <= *previous)
+        return CTAP2_ERR_INVALID_CBOR;
+
+    *previous = *key;
+    return CTAP2_OK;
+}
+
+static uint8_t read_byte_string(cbor_parser_t *p, ctap2hid_view_cursor_t *span, uint16_t min, uint16_t max)
+{
+    uint8_t status = cbor_read_bytes(p, span);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (view_remaining(span) < min || view_remaining(span) > max)
+        return CTAP1_ERR_INVALID_LENGTH;
+    return CTAP2_OK;
+}
+
+// Text map keys have to be in canonical order too: shorter keys first, then bytewise. Returns whether
+// key comes strictly after previous, so a repeated key is out of order.
+static bool text_key_follows(ctap2hid_view_cursor_t key, ctap2hid_view_cursor_t previous)
+{
+    if (view_remaining(&key) != view_remaining(&previous))
+        return view_remaining(&key) > view_remaining(&previous);
+
+    while (view_remaining(&key))
+    {
+        uint8_t a, b;
+        view_read(&key, &a, 1);
+        view_read(&previous, &b, 1);
+        if (a != b)
+            return a > b;
+    }
+    return false;
+}
+
+// Reads a map with text keys, keeping the values of the ones named in keys (in the order given) as
+// parsers positioned at them and skipping the rest. found has a bit set for each key present.
+static uint8_t read_text_map(cbor_parser_t *p, const char *const *keys, uint8_t key_count, cbor_parser_t *values, uint8_t *found)
+{
+    uint16_t count;
+    ctap2hid_view_cursor_t previous;
+    uint8_t status = cbor_read_map(p, &count);
+
+    if (status != CTAP2_OK)
+        return status;
+
+    *found = 0;
+    for (uint16_t n = 0; n < count; n++)
+    {
+        ctap2hid_view_cursor_t key;
+        if ((status = cbor_read_text(p, &key)) != CTAP2_OK)
+            return status;
+        if (n > 0 && !text_key_follows(key, previous))
+            return CTAP2_ERR_INVALID_CBOR;
+        previous = key;
+
+        for (uint8_t i = 0; i < key_count; i++)
+        {
+            if (span_equals(key, keys[i], strlen(keys[i])))
+            {
+                values[i] = *p;
+                *found |= 1 << i;
+                break;
+            }
+        }
+
+        if ((status = cbor_skip(p)) != CTAP2_OK)
+            return status;
+    }
+    return CTAP2_OK;
+}
+
+static const char *const cred_param_keys[] = {"alg", "type"};
+
+// Reads one PublicKeyCredentialParameters entry.
+static uint8_t read_cred_param(cbor_parser_t *p, bool *is_public_key, int32_t *alg)
+{
+    cbor_parser_t values[2];
+    uint8_t found;
+    uint8_t status = read_text_map(p, cred_param_keys, 2, values, &found);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (found != 0x3)
+        return CTAP2_ERR_MISSING_PARAMETER;
+
+    ctap2hid_view_cursor_t type;
+    if ((status = cbor_read_int(&values[0], alg)) != CTAP2_OK)
+        return status;
+    if ((status = cbor_read_text(&values[1], &type)) != CTAP2_OK)
+        return status;
+
+    *is_public_key = TEXT_EQUALS(type, public_key);
+    return CTAP2_OK;
+}
+
+static const char *const descriptor_keys[] = {"id", "type"};
+
+// Reads one PublicKeyCredentialDescriptor, leaving id as a span over the credential ID.
+uint8_t read_credential_descriptor(cbor_parser_t *p, ctap2hid_view_cursor_t *id, bool *is_public_key)
+{
+    cbor_parser_t values[2];
+    uint8_t found;
+    uint8_t status = read_text_map(p, descriptor_keys, 2, values, &found);
+
+    if (status != CTAP2_OK)
+        return status;
+    if (found != 0x3)
+        return CTAP2_ERR_MISSING_PARAMETER;
+
+    ctap2hid_view_cursor_t type;
+    if ((status = cbor_read_bytes(&values[0], id)) != CTAP2_OK)
+        return status;
+    if ((status = cbor_read_text(&values[1], &type)) != CTAP2_OK)
+        return status;
+
+    *is_public_key = TEXT_EQUALS(type, public_key);
+    return CTAP2_OK;
+}
+
+// Checks every descriptor in a list is well formed, leaving list where it was.
+static uint8_t read_credential_list(cbor_parser_t *p, cbor_parser_t *list, uint16_t *count)
+{
+    uint8_t status = cbor_read_array(p, count);
+
+    if (status != CTAP2_OK)
+        return status;
+
+    *list = *p;
+    for (uint16_t i = 0; i < *count; i++)
+    {
+        ctap2hid_view_cursor_t id;
+        bool is_public_key;
+        if ((status = read_credential_descriptor(p, &id, &is_public_key)) != CTAP2_OK)
+            return status;
+    }
+    return CTAP2_OK;
+}
+
+static const char *const option_keys[] = {"rk", "up", "uv"};
+
+// found's bit for the up option, which is option_keys[1].
+#define OPTION_UP (1 << 1)
+
+// Reads the options map. Options that are absent are left as they were, and found has a bit set for
+// each one present.
+static uint8_t read_options(cbor_parser_t *p, bool *rk, bool *up, bool *uv, uint8_t *found)
+{
+    cbor_parser_t values[3];
+    uint8_t status = read_text_map(p, option_keys, 3, values, found);
+    bool *options[3] = {rk, up, uv};
+
+    if (status != CTAP2_OK)
+        return status;
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        if ((*found & (1 << i)) && (status = cbor_read_bool(&values[i], options[i])) != CTAP2_OK)
+            return status;
+    }
+    return CTAP2_OK;
+}
+
+static const char *const rp_keys[] = {"id"};
+static const char *const user_keys[] = {"id"};
+
+uint8_t parse_make_credential(const ctap2hid_message_view_t *request, ctap2_make_credential_t *params)
+{
+    // The request's CBOR follows the command byte.
+    cbor_parser_t p = cbor_parser(request, 1);
+    uint32_t previous = UINT32_MAX;
+    uint16_t count;
+    uint16_t required = 0;
+    uint8_t status;
+
+    memset(params, 0, sizeof(*params));
+
+    if ((status = cbor_read_map(&p, &count)) != CTAP2_OK)
+        return status;
+
+    for (; count > 0; count--)
+    {
+        uint32_t key;
+        cbor_parser_t value;
+        uint8_t found;
+        bool up = false;
+
+        if ((status = read_key(&p, &key, &previous)) != CTAP2_OK)
+            return status;
+
+        switch (key)
+        {
+        case 0x01:
+            status = read_byte_string(&p, &params->client_data_hash, 32, 32);
+            break;
+        case 0x02:
+            if ((status = read_text_map(&p, rp_keys, 1, &value, &found)) == CTAP2_OK)
+                status = found ? cbor_read_text(&value, &params->rp_id) : CTAP2_ERR_MISSING_PARAMETER;
+            break;
+        case 0x03:
+            if ((status = read_text_map(&p, user_keys, 1, &value, &found)) == CTAP2_OK)
+                status = found ? read_byte_string(&value, &params->user_id, 0, 64) : CTAP2_ERR_MISSING_PARAMETER;
+            break;
+        case 0x04:
+            if ((status = cbor_read_array(&p, &params->pub_key_cred_params_count)) != CTAP2_OK)
+                break;
+            params->pub_key_cred_params = p;
+            for (uint16_t i = 0; i < params->pub_key_cred_params_count && status == CTAP2_OK; i++)
+            {
+                bool is_public_key;
+                int32_t alg;
+                status = read_cred_param(&p, &is_public_key, &alg);
+            }
+            break;
+        case 0x05:
+            status = read_credential_list(&p, &params->exclude_list, &params->exclude_list_count);
+            break;
+        case 0x07:
+            status = read_options(&p, &params->rk, &up, &params->uv, &found);
+            // There's no user presence to skip when making a credential, so up may only be true.
+            if (status == CTAP2_OK && (found & OPTION_UP) && !up)
+                status = CTAP2_ERR_INVALID_OPTION;
+            break;
+        case 0x08:
+            params->pin_auth = true;
+            status = cbor_skip(&p);
+            break;
+        default:
+            // Extensions, pinProtocol and anything newer are ignored.
+            status = cbor_skip(&p);
+            break;
+        }
+
+        if (status != CTAP2_OK)
+            return status;
+        if (key <= 0x04)
+            required |= 1 << key;
+    }
+
+    if (!cbor_at_end(&p))
+        return CTAP2_ERR_INVALID_CBOR;
+    if (required != 0x1e)
+        return CTAP2_ERR_MISSING_PARAMETER;
+    return CTAP2_OK;
+}
+
+uint8_t parse_get_assertion(const ctap2hid_message_view_t *request, ctap2_get_assertion_t *params)
+{
+    cbor_parser_t p = cbor_parser(request, 1);
+    uint32_t previous = UINT32_MAX;
+    uint16_t count;
+    uint16_t required = 0;
+    uint8_t status;
+
+    memset(params, 0, sizeof(*params));
+    params->up = true;
+
+    if ((status = cbor_read_map(&p, &count)) != CTAP2_OK)
+        return status;
+
+    for (; count > 0; count--)
+    {
+        uint32_t key;
+        uint8_t found;
+        bool rk = false;
+
+        if ((status = read_key(&p, &key, &previous)) != CTAP2_OK)
+            return status;
+
+        switch (key)
+        {
+        case 0x01:
+            status = cbor_read_text(&p, &params->rp_id);
+            break;
+        case 0x02:
+            status = read_byte_string(&p, &params->client_data_hash, 32, 32);
+            break;
+        case 0x03:
+            status = read_credential_list(&p, &params->allow_list, &params->allow_list_count);
+            break;
+        case 0x05:
+            status = read_options(&p, &rk, &params->up, &params->uv, &found);
+            if (status == CTAP2_OK && rk)
+                status = CTAP2_ERR_UNSUPPORTED_OPTION;
+            break;
+        case 0x06:
+            params->pin_auth = true;
+            status = cbor_skip(&p);
+            break;
+        default:
+            status = cbor_skip(&p);
+            break;
+        }
+
+        if (status != CTAP2_OK)
+            return status;
+        if (key <= 0x02)
+            required |= 1 << key;
+    }
+
+    if (!cbor_at_end(&p))
+        return CTAP2_ERR_INVALID_CBOR;
+    if (required != 0x6)
+        return CTAP2_ERR_MISSING_PARAMETER;
+    return CTAP2_OK;
+}
+
+// Finds the rpId of a makeCredential or getAssertion request without parsing any more of it than it
+// has to, so that it can be found in the part of a request that's arrived so far. The request is
+// checked in full by parse_make_credential or parse_get_assertion once it's complete.
+uint8_t locate_rp_id(const ctap2hid_message_view_t *request, ctap2hid_view_cursor_t *rp_id)
+{
+    ctap2hid_view_cursor_t cursor = view_cursor(request);
+    cbor_parser_t p = cbor_parser(request, 1);
+    uint32_t previous = UINT32_MAX;
+    uint32_t rp_key;
+    uint16_t count;
+    uint8_t command;
+    uint8_t status;
+
+    if (!view_read(&cursor, &command, 1))
+        return CTAP1_ERR_INVALID_LENGTH;
+    if (command == CTAP2_MAKE_CREDENTIAL)
+        rp_key = 0x02;
+    else if (command == CTAP2_GET_ASSERTION)
+        rp_key = 0x01;
+    else
+        return CTAP1_ERR_INVALID_COMMAND;
+
+    if ((status = cbor_read_map(&p, &count)) != CTAP2_OK)
+        return status;
+
+    for (; count > 0; count--)
+    {
+        uint32_t key;
+        cbor_parser_t value;
+        uint8_t found;
+
+        if ((status = read_key(&p, &key, &previous)) != CTAP2_OK)
+            return status;
+        if (key > rp_key)
+            break;
+        if (key < rp_key)
+        {
+            if ((status = cbor_skip(&p)) != CTAP2_OK)
+                return status;
+            continue;
+        }
+
+        if (command == CTAP2_GET_ASSERTION)
+            return cbor_read_text(&p, rp_id);
+        if ((status = read_text_map(&p, rp_keys, 1, &value, &found)) != CTAP2_OK)
+            return status;
+        return found ? cbor_read_text(&value, rp_id) : CTAP2_ERR_MISSING_PARAMETER;
+    }
+    return CTAP2_ERR_MISSING_PARAMETER;
+}
+
+// Whether the client listed alg among the public key algorithms it accepts.
+bool accepts_algorithm(ctap2_make_credential_t *params, int32_t alg)
+{
+    cbor_parser_t p = params->pub_key_cred_params;
+
+    for (uint16_t i = 0; i < params->pub_key_cred_params_count; i++)
+    {
+        bool is_public_key;
+        int32_t param_alg;
+
+        if (read_cred_param(&p, &is_public_key, &param_alg) != CTAP2_OK)
+            return false;
+        if (is_public_key && param_alg == alg)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#include "cbor.h"
+
+#ifndef _CTAP2_REQUEST_H_
+#define _CTAP2_REQUEST_H_
+
+// authenticatorMakeCredential parameters. Strings are spans into the request message, and lists are
+// left in place as a parser positioned at their first item, so nothing is copied out of the request.
+typedef struct
+{
+    ctap2hid_view_cursor_t client_data_hash;
+    ctap2hid_view_cursor_t rp_id;
+    ctap2hid_view_cursor_t user_id;
+    cbor_parser_t pub_key_cred_params;
+    uint16_t pub_key_cred_params_count;
+    cbor_parser_t exclude_list;
+    uint16_t exclude_list_count;
+    bool rk;
+    bool uv;
+    bool pin_auth;
+} ctap2_make_credential_t;
+
+// authenticatorGetAssertion parameters, kept the same way.
+typedef struct
+{
+    ctap2hid_view_cursor_t rp_id;
+    ctap2hid_view_cursor_t client_data_hash;
+    cbor_parser_t allow_list;
+    uint16_t allow_list_count;
+    bool up;
+    bool uv;
+    bool pin_auth;
+} ctap2_get_assertion_t;
+
+uint8_t parse_make_credential(const ctap2hid_message_view_t *request, ctap2_make_credential_t *params);
+uint8_t parse_get_assertion(const ctap2hid_message_view_t *request, ctap2_get_assertion_t *params);
+uint8_t locate_rp_id(const ctap2hid_message_view_t *request, ctap2hid_view_cursor_t *rp_id);
+bool accepts_algorithm(ctap2_make_credential_t *params, int32_t alg);
+uint8_t read_credential_descriptor(cbor_parser_t *p, ctap2hid_view_cursor_t *id, bool *is_public_key);
+
+#endif
@@ -5,93 +5,284 @@ bool is_broadcast_message(ctap2hid_message_t message)
     return message.channel_id == 0xffffffff;
 }
 
-void write_message_packets(ctap2hid_message_t *message, writer_t write)
+ctap2hid_message_view_t message_view(ctap2hid_message_t *message)
 {
-    ctap2hid_packet_t packet = {
+    ctap2hid_message_view_t view = {
         .channel_id = message->channel_id,
-        .init.command_id = message->command_id,
-        .init.payload_length = SwapEndian_16(message->payload_length),
+        .command_id = message->command_id,
+        .payload_length = message->payload_length,
+        .segment_count = 1,
+        .segments[0] = {.data = message->payload, .length = message->payload_length},
     };
+    return view;
+}
 
-    int len;
+// Describes a constant payload stored in flash, which is read straight from there as it's sent.
+ctap2hid_message_view_t progmem_view(uint32_t channel_id, uint8_t command_id, const uint8_t *data, uint16_t length)
+{
+    ctap2hid_message_view_t view = {
+        .channel_id = channel_id,
+        .command_id = command_id,
+        .payload_length = length,
+        .segment_count = 1,
+        .segments[0] = {.data = data, .length = length, .progmem = true},
+    };
+    return view;
+}
 
-    for (len = 0; len < INIT_PAYLOAD_LENGTH; len++)
+ctap2hid_view_cursor_t view_cursor(const ctap2hid_message_view_t *view)
+{
+    ctap2hid_view_cursor_t c = {
+        .view = view,
+        .segment = 0,
+        .offset = 0,
+        .remaining = view->payload_length,
+    };
+    return c;
+}
+
+uint16_t view_remaining(ctap2hid_view_cursor_t *c)
+{
+    return c->remaining;
+}
+
+// Returns a pointer to (up to max bytes of) the payload at the cursor without copying it, and
+// advances past them. A chunk never crosses a segment boundary.
+uint16_t view_next_chunk(ctap2hid_view_cursor_t *c, const uint8_t **data, uint16_t max)
+{
+    const ctap2hid_message_view_t *view = c->view;
+
+    while (c->segment < view->segment_count && c->offset == view->segments[c->segment].length)
     {
-        packet.init.payload[len] = len < message->payload_length ? message->payload[len] : 0;
+        c->segment++;
+        c->offset = 0;
     }
 
-    int start = len;
+    if (c->remaining == 0 || c->segment == view->segment_count)
+        return 0;
 
-    write(&packet);
+    uint16_t size = MIN(view->segments[c->segment].length - c->offset, MIN(max, c->remaining));
+    *data = view->segments[c->segment].data + c->offset;
+    c->offset += size;
+    c->remaining -= size;
+    return size;
+}
 
-    packet.cont.seq = 0;
+// Whether the chunk last returned by view_next_chunk is in flash rather than RAM.
+bool view_chunk_in_progmem(ctap2hid_view_cursor_t *c)
+{
+    return c->view->segments[c->segment].progmem;
+}
+
+uint16_t view_read(ctap2hid_view_cursor_t *c, uint8_t *dst, uint16_t n)
+{
+    uint16_t total = 0;
+    const uint8_t *data;
+    uint16_t size;
 
-    while (start < message->payload_length && packet.cont.seq <= 0x7F)
+    while (total < n && (size = view_next_chunk(c, &data, n - total)))
     {
-        for (len = 0; len < CONT_PAYLOAD_LENGTH; len++)
-        {
-            packet.cont.payload[len] = start + len < message->payload_length ? message->payload[start + len] : 0;
-        }
+        if (view_chunk_in_progmem(c))
+            memcpy_P(dst + total, data, size);
+        else
+            memcpy(dst + total, data, size);
+        total += size;
+    }
+    return total;
+}
 
-        write(&packet);
+uint16_t view_skip(ctap2hid_view_cursor_t *c, uint16_t n)
+{
+    uint16_t total = 0;
+    const uint8_t *data;
+    uint16_t size;
+
+    while (total < n && (size = view_next_chunk(c, &data, n - total)))
+        total += size;
+    return total;
+}
+
+void write_message_packets(ctap2hid_message_t *message, writer_t write)
+{
+    ctap2hid_message_view_t view = message_view(message);
+    write_view_packets(&view, write);
+}
 
-        start += len;
+void write_view_packets(ctap2hid_message_view_t *view, writer_t write)
+{
+    ctap2hid_view_cursor_t cursor = view_cursor(view);
+    ctap2hid_packet_t packet = {
+        .channel_id = view->channel_id,
+        .init.command_id = view->command_id | 0x80,
+        .init.payload_length = SwapEndian_16(view->payload_length),
+    };
+
+    uint16_t size = view_read(&cursor, packet.init.payload, INIT_PAYLOAD_LENGTH);
+    memset(packet.init.payload + size, 0, INIT_PAYLOAD_LENGTH - size);
+
+    write(&packet);
+
+    for (packet.cont.seq = 0; view_remaining(&cursor) > 0 && packet.cont.seq <= 0x7F; packet.cont.seq++)
+    {
+        size = view_read(&cursor, packet.cont.payload, CONT_PAYLOAD_LENGTH);
+        memset(packet.cont.payload + size, 0, CONT_PAYLOAD_LENGTH - size);
 
-        packet.cont.seq++;
+        write(&packet);
     }
 }
 
-uint8_t read_message_packets(ctap2hid_message_t *message, bool *err, packet_reader_t read, error_handler_t handle_error)
+void response_begin(ctap2hid_response_t *r, ctap2hid_message_view_t *view)
 {
-    uint8_t n = 0;
+    r->view = *view;
+    r->cursor = view_cursor(&r->view);
+    r->started = false;
+    r->seq = 0;
+    r->active = true;
+}
 
-    ctap2hid_packet_t *packet = read(n);
-    if (!packet || !is_init_packet(packet))
+// Writes the response's next packet as a series of writes: the header, each contiguous chunk of the
+// payload that fits (flagged when it's to be read from flash), then the zero padding in one go
+// (signalled by a NULL data pointer). Returns whether any packets remain.
+bool response_write_packet(ctap2hid_response_t *r, stream_writer_t write)
+{
+    uint8_t header[7];
+    uint8_t header_length;
+    uint8_t space;
+
+    memcpy(header, &r->view.channel_id, 4);
+
+    if (!r->started)
+    {
+        header[4] = r->view.command_id | 0x80;
+        header[5] = r->view.payload_length >> 8;
+        header[6] = r->view.payload_length & 0xff;
+        header_length = 7;
+        space = INIT_PAYLOAD_LENGTH;
+        r->started = true;
+    }
+    else
+    {
+        header[4] = r->seq++;
+        header_length = 5;
+        space = CONT_PAYLOAD_LENGTH;
+    }
+
+    write(header, header_length, false);
+
+    const uint8_t *data;
+    uint16_t size;
+    while (space > 0 && (size = view_next_chunk(&r->cursor, &data, space)))
     {
-        *err = true;
-        return n;
+        write(data, size, view_chunk_in_progmem(&r->cursor));
+        space -= size;
     }
 
-    message->channel_id = packet->channel_id;
-    message->command_id = packet->init.command_id & 0x7f;
-    message->payload_length = SwapEndian_16(packet->init.payload_length);
-    message->payload = malloc(message->payload_length);
+    if (space > 0)
+        write(NULL, space, false);
 
-    int position = 0;
-    int size = MIN(message->payload_length - position, INIT_PAYLOAD_LENGTH);
-    memcpy(message->payload, packet->init.payload, size);
-    position += size;
+    r->active = view_remaining(&r->cursor) > 0 && r->seq <= 0x7F;
+    return r->active;
+}
+
+// Describes a message whose packets are all available from read, in order, as a view over the
+// packets themselves. Returns the number of packets it spans, or 0 if it isn't wholly available
+// (or doesn't start with an init packet), in which case it has to be reassembled instead.
+uint8_t read_message_view(ctap2hid_message_view_t *view, packet_reader_t read)
+{
+    ctap2hid_packet_t *packet = read(0);
+    if (!packet || !is_init_packet(packet))
+        return 0;
+
+    view->channel_id = packet->channel_id;
+    view->command_id = packet->init.command_id & 0x7f;
+    view->payload_length = SwapEndian_16(packet->init.payload_length);
 
-    n++;
+    uint16_t position = MIN(view->payload_length, INIT_PAYLOAD_LENGTH);
+    view->segments[0].data = packet->init.payload;
+    view->segments[0].length = position;
+    view->segments[0].progmem = false;
 
-    while (position < message->payload_length)
+    uint8_t n = 1;
+
+    while (position < view->payload_length)
     {
+        if (n == MESSAGE_VIEW_SEGMENTS)
+            return 0;
+
         packet = read(n);
 
-        if (!packet)
-        {
-            free(message->payload);
+        if (!packet || !is_cont_packet(packet) || packet->channel_id != view->channel_id || packet->cont.seq != n - 1)
             return 0;
-        }
-        else if (!is_cont_packet(packet))
-        {
-            free(message->payload);
-            *err = true;
-            return n;
-        }
-        else if (n - 1 != packet->cont.seq)
-        {
-            handle_error(packet, CTAPHID_ERR_INVALID_SEQ);
-            *err = true;
-            return n;
-        }
-
-        size = MIN(message->payload_length - position, CONT_PAYLOAD_LENGTH);
-        memcpy(message->payload + position, packet->cont.payload, size);
+
+        uint16_t size = MIN(view->payload_length - position, CONT_PAYLOAD_LENGTH);
+        view->segments[n].data = packet->cont.payload;
+        view->segments[n].length = size;
+        view->segments[n].progmem = false;
         position += size;
 
         n++;
     }
 
+    view->segment_count = n;
     return n;
+}
+
+ctap2hid_reassembler_t reassembler_init(uint8_t *buffer, uint16_t capacity)
+{
+    ctap2hid_reassembler_t r = {
+        .active = false,
+        .capacity = capacity,
+        .message.payload = buffer,
+    };
+    return r;
+}
+
+static reassembly_result_t start_message(ctap2hid_reassembler_t *r, ctap2hid_packet_t *packet, error_handler_t handle_error)
+{
+    uint16_t payload_length = SwapEndian_16(packet->init.payload_length);
+
+    if (payload_length > r->capacity)
+    {
+        r->active = false;
+        handle_error(packet, CTAPHID_ERR_INVALID_LEN);
+        return REASSEMBLY_DROPPED;
+    }
+
+    r->message.channel_id = packet->channel_id;
+    r->message.command_id = packet->init.command_id & 0x7f;
+    r->message.payload_length = payload_length;
+    r->received = MIN(payload_length, INIT_PAYLOAD_LENGTH);
+    r->seq = 0;
+    memcpy(r->message.payload, packet->init.payload, r->received);
+
+    r->active = r->received < payload_length;
+    return r->active ? REASSEMBLY_PENDING : REASSEMBLY_COMPLETE;
+}
+
+// Consumes a single packet of one channel's traffic, appending its payload to the message being
+// reassembled (an init packet always starts a new message). The packet is not referenced after this
+// returns, so its queue slot can be released straight away.
+reassembly_result_t reassemble_packet(ctap2hid_reassembler_t *r, ctap2hid_packet_t *packet, error_handler_t handle_error)
+{
+    if (is_init_packet(packet))
+        return start_message(r, packet, handle_error);
+
+    // Continuation packets without a preceding init packet are spurious.
+    if (!r->active)
+        return REASSEMBLY_DROPPED;
+
+    if (packet->cont.seq != r->seq)
+    {
+        r->active = false;
+        handle_error(packet, CTAPHID_ERR_INVALID_SEQ);
+        return REASSEMBLY_DROPPED;
+    }
+
+    uint16_t size = MIN(r->message.payload_length - r->received, CONT_PAYLOAD_LENGTH);
+    memcpy(r->message.payload + r->received, packet->cont.payload, size);
+    r->received += size;
+    r->seq++;
+
+    r->active = r->received < r->message.payload_length;
+    return r->active ? REASSEMBLY_PENDING : REASSEMBLY_COMPLETE;
 }
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include <stdlib.h>
 #include "ctap2hid_packet.h"
 #include "ctaphid.h"
+#include "packet_queue.h"
 
 #ifndef _CTAP2HID_MESSAGE_
 #define _CTAP2HID_MESSAGE_
 
+// A view can describe a message spread over every slot of a packet queue.
+#define MESSAGE_VIEW_SEGMENTS PACKET_QUEUE_LEN
+
 typedef struct
 {
     bool valid;
@@ -14,12 +18,83 @@ typedef struct
     uint8_t *payload;
 } ctap2hid_message_t;
 
+// A contiguous piece of a message's payload, in RAM or (progmem) in flash.
+typedef struct
+{
+    const uint8_t *data;
+    uint16_t length;
+    bool progmem;
+} ctap2hid_segment_t;
+
+// A message whose payload is read in place from wherever it was received (packet payloads or a
+// reassembly buffer), as a sequence of segments, rather than copied into one allocation.
+typedef struct
+{
+    uint32_t channel_id;
+    uint8_t command_id;
+    uint16_t payload_length;
+    uint8_t segment_count;
+    ctap2hid_segment_t segments[MESSAGE_VIEW_SEGMENTS];
+} ctap2hid_message_view_t;
+
+typedef struct
+{
+    const ctap2hid_message_view_t *view;
+    uint8_t segment;
+    uint16_t offset;
+    uint16_t remaining;
+} ctap2hid_view_cursor_t;
+
+// Produces a message's packets one at a time, on demand, straight from its payload's view. The view
+// is copied in, but the memory it describes must stay valid until the last packet is written.
+typedef struct
+{
+    bool active;
+    bool started;
+    uint8_t seq;
+    ctap2hid_message_view_t view;
+    ctap2hid_view_cursor_t cursor;
+} ctap2hid_response_t;
+
+typedef enum
+{
+    REASSEMBLY_PENDING,
+    REASSEMBLY_COMPLETE,
+    REASSEMBLY_DROPPED,
+} reassembly_result_t;
+
+typedef struct
+{
+    bool active;
+    uint8_t seq;
+    uint16_t received;
+    uint16_t capacity;
+    ctap2hid_message_t message;
+} ctap2hid_reassembler_t;
+
 typedef void writer_t(ctap2hid_packet_t *);
-typedef void message_handler_t(ctap2hid_message_t *);
+typedef void stream_writer_t(const uint8_t *data, uint8_t length, bool progmem);
+typedef void message_handler_t(ctap2hid_message_view_t *);
 typedef ctap2hid_packet_t *packet_reader_t(uint8_t n);
 typedef void error_handler_t(ctap2hid_packet_t *, uint8_t);
 
 void write_message_packets(ctap2hid_message_t *message, writer_t write);
-uint8_t read_message_packets(ctap2hid_message_t *message, bool *err, packet_reader_t read, error_handler_t handle_error);
+void write_view_packets(ctap2hid_message_view_t *view, writer_t write);
+uint8_t read_message_view(ctap2hid_message_view_t *view, packet_reader_t read);
+ctap2hid_message_view_t message_view(ctap2hid_message_t *message);
+ctap2hid_message_view_t progmem_view(uint32_t channel_id, uint8_t command_id, const uint8_t *data, uint16_t length);
+
+void response_begin(ctap2hid_response_t *r, ctap2hid_message_view_t *view);
+bool response_write_packet(ctap2hid_response_t *r, stream_writer_t write);
+
+ctap2hid_view_cursor_t view_cursor(const ctap2hid_message_view_t *view);
+uint16_t view_next_chunk(ctap2hid_view_cursor_t *c, const uint8_t **data, uint16_t max);
+uint16_t view_read(ctap2hid_view_cursor_t *c, uint8_t *dst, uint16_t n);
+uint16_t view_skip(ctap2hid_view_cursor_t *c, uint16_t n);
+uint16_t view_remaining(ctap2hid_view_cursor_t *c);
+bool view_chunk_in_progmem(ctap2hid_view_cursor_t *c);
+
+ctap2hid_reassembler_t reassembler_init(uint8_t *buffer, uint16_t capacity);
+reassembly_result_t reassemble_packet(ctap2hid_reassembler_t *r, ctap2hid_packet_t *packet, error_handler_t handle_error);
 
 #endif
\ No newline at end of file
@@ -3,8 +3,8 @@
 #ifndef _CTAP2HID_PACKET_H_
 #define _CTAP2HID_PACKET_H_
 
-#define INIT_PAYLOAD_LENGTH FIDO_REPORT_SIZE - 7
-#define CONT_PAYLOAD_LENGTH FIDO_REPORT_SIZE - 5
+#define INIT_PAYLOAD_LENGTH (FIDO_REPORT_SIZE - 7)
+#define CONT_PAYLOAD_LENGTH (FIDO_REPORT_SIZE - 5)
 
 typedef struct
 {
@@ -16,14 +16,14 @@ typedef struct
             uint8_t command_id;
             uint16_t payload_length;
             uint8_t payload[INIT_PAYLOAD_LENGTH];
-        } init;
+        } ATTR_PACKED init;
         struct
         {
             uint8_t seq;
             uint8_t payload[CONT_PAYLOAD_LENGTH];
-        } cont;
+        } ATTR_PACKED cont;
     };
-} ctap2hid_packet_t;
+} ATTR_PACKED ctap2hid_packet_t;
 
 bool is_init_packet(ctap2hid_packet_t *packet);
 bool is_cont_packet(ctap2hid_packet_t *packet);
@@ -0,0 +1,162 @@
+#include "ctap2hid_transaction.h"
+
+transaction_table_t tt_init(uint8_t *buffer, uint16_t capacity)
+{
+    transaction_table_t t = {
+        .buffer = buffer,
+        .capacity = capacity,
+        .transactions = {},
+    };
+    return t;
+}
+
+ctap2hid_transaction_t *tt_find(transaction_table_t *t, uint32_t channel_id)
+{
+    for (uint8_t i = 0; i < CTAPHID_MAX_TRANSACTIONS; i++)
+    {
+        ctap2hid_transaction_t *transaction = &t->transactions[i];
+        if (transaction->in_use && transaction->reassembler.message.channel_id == channel_id)
+            return transaction;
+    }
+    return NULL;
+}
+
+// Returns a transaction whose request is complete but hasn't been handled yet, if any.
+ctap2hid_transaction_t *tt_next_complete(transaction_table_t *t)
+{
+    for (uint8_t i = 0; i < CTAPHID_MAX_TRANSACTIONS; i++)
+    {
+        ctap2hid_transaction_t *transaction = &t->transactions[i];
+        if (transaction->in_use && !transaction->handled && !transaction->reassembler.active)
+            return transaction;
+    }
+    return NULL;
+}
+
+void tt_release(ctap2hid_transaction_t *transaction)
+{
+    transaction->in_use = false;
+    transaction->handled = false;
+    transaction->reassembler.active = false;
+}
+
+static bool overlaps_transaction(transaction_table_t *t, uint16_t offset, uint16_t length)
+{
+    for (uint8_t i = 0; i < CTAPHID_MAX_TRANSACTIONS; i++)
+    {
+        ctap2hid_transaction_t *transaction = &t->transactions[i];
+        if (!transaction->in_use)
+            continue;
+
+        uint16_t start = transaction->reassembler.message.payload - t->buffer;
+        uint16_t end = start + transaction->reassembler.capacity;
+        if (offset < end && start < offset + length)
+            return true;
+    }
+    return false;
+}
+
+// Finds room for a message of the given length in the shared buffer. Free space always begins at
+// the start of the buffer or at the end of a transaction's slice, so only those offsets are tried.
+// The whole declared length is reserved up front, as a message is reassembled in one piece, so while
+// one channel's large request is arriving another's may not fit, and is refused as busy.
+static uint8_t *allocate_slice(transaction_table_t *t, uint16_t length)
+{
+    if (!overlaps_transaction(t, 0, length))
+        return t->buffer;
+
+    for (uint8_t i = 0; i < CTAPHID_MAX_TRANSACTIONS; i++)
+    {
+        ctap2hid_transaction_t *transaction = &t->transactions[i];
+        if (!transaction->in_use)
+            continue;
+
+        uint16_t offset = transaction->reassembler.message.payload - t->buffer + transaction->reassembler.capacity;
+        if (offset + length <= t->capacity && !overlaps_transaction(t, offset, length))
+            return t->buffer + offset;
+    }
+    return NULL;
+}
+
+static ctap2hid_transaction_t *start_transaction(transaction_table_t *t, ctap2hid_packet_t *packet, error_handler_t handle_error)
+{
+    uint16_t payload_length = SwapEndian_16(packet->init.payload_length);
+
+    if (payload_length > t->capacity)
+    {
+        handle_error(packet, CTAPHID_ERR_INVALID_LEN);
+        return NULL;
+    }
+
+    ctap2hid_transaction_t *transaction = NULL;
+    for (uint8_t i = 0; i < CTAPHID_MAX_TRANSACTIONS && !transaction; i++)
+    {
+        if (!t->transactions[i].in_use)
+            transaction = &t->transactions[i];
+    }
+
+    uint8_t *buffer = allocate_slice(t, payload_length);
+
+    // Out of transactions or buffer space: the request is refused now rather than left to wait.
+    if (!transaction || !buffer)
+    {
+        handle_error(packet, CTAPHID_ERR_CHANNEL_BUSY);
+        return NULL;
+    }
+
+    transaction->in_use = true;
+    transaction->handled = false;
+    transaction->reassembler = reassembler_init(buffer, payload_length);
+
+    if (reassemble_packet(&transaction->reassembler, packet, handle_error) == REASSEMBLY_COMPLETE)
+        return transaction;
+    return NULL;
+}
+
+// Demultiplexes a packet onto its channel's transaction. Returns the transaction if the packet
+// completed its message, which stays reserved (and its channel busy) until released with tt_release.
+// An INIT aborts its channel's transaction however far it's got, so the caller has to have finished
+// with a complete one before feeding it an INIT.
+ctap2hid_transaction_t *tt_feed(transaction_table_t *t, ctap2hid_packet_t *packet, error_handler_t handle_error)
+{
+    ctap2hid_transaction_t *transaction = tt_find(t, packet->channel_id);
+
+    if (is_init_packet(packet))
+    {
+        if (transaction)
+        {
+            // A channel stays busy from a complete request until its transaction is released, except
+            // to an INIT, which replaces it.
+            if (!transaction->reassembler.active && (packet->init.command_id & 0x7f) != CTAPHID_INIT)
+            {
+                handle_error(packet, CTAPHID_ERR_CHANNEL_BUSY);
+                return NULL;
+            }
+
+            // An INIT resynchronises a channel mid-message, anything else aborts its transaction.
+            tt_release(transaction);
+            if ((packet->init.command_id & 0x7f) != CTAPHID_INIT)
+            {
+                handle_error(packet, CTAPHID_ERR_INVALID_SEQ);
+                return NULL;
+            }
+        }
+
+        return start_transaction(t, packet, handle_error);
+    }
+
+    // Continuation packets without a message in progress on their channel are spurious.
+    if (!transaction || !transaction->reassembler.active)
+        return NULL;
+
+    switch (reassemble_packet(&transaction->reassembler, packet, handle_error))
+    {
+    case REASSEMBLY_COMPLETE:
+        return transaction;
+    case REASSEMBLY_DROPPED:
+        tt_release(transaction);
+        return NULL;
+    default:
+        return NULL;
+    }
+}
@@ -0,0 +1,28 @@
+#include "ctap2hid_message.h"
+
+#ifndef _CTAP2HID_TRANSACTION_H_
+#define _CTAP2HID_TRANSACTION_H_
+
+typedef struct
+{
+    bool in_use;
+    bool handled;
+    ctap2hid_reassembler_t reassembler;
+} ctap2hid_transaction_t;
+
+// Transactions in progress, one per channel, with their messages reassembled into slices of a
+// shared buffer sized to each message's payload length.
+typedef struct
+{
+    uint8_t *buffer;
+    uint16_t capacity;
+    ctap2hid_transaction_t transactions[CTAPHID_MAX_TRANSACTIONS];
+} transaction_table_t;
+
+transaction_table_t tt_init(uint8_t *buffer, uint16_t capacity);
+ctap2hid_transaction_t *tt_find(transaction_table_t *t, uint32_t channel_id);
+ctap2hid_transaction_t *tt_next_complete(transaction_table_t *t);
+ctap2hid_transaction_t *tt_feed(transaction_table_t *t, ctap2hid_packet_t *packet, error_handler_t handle_error);
+void tt_release(ctap2hid_transaction_t *transaction);
+
+#endif
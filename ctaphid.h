@@ -9,12 +9,31 @@
 // CTAPHID Protocol Version (CTAP2)
 #define CTAPHID_PROTOCOL_VERSION 2
 
+// CTAPHID Channels
+#define CTAPHID_BROADCAST_CID 0xffffffff
+
 // CTAPHID Commands
 #define CTAPHID_PING 0x1
+#define CTAPHID_LOCK 0x4
 #define CTAPHID_INIT 0x6
 #define CTAPHID_WINK 0x8
+#define CTAPHID_CBOR 0x10
+#define CTAPHID_KEEPALIVE 0x3b
 #define CTAPHID_ERROR 0x3f
 
+// Vendor Commands (0x40 to 0x7f), specific to this firmware
+#define CTAPHID_VENDOR_PROFILE 0x40
+#define CTAPHID_VENDOR_RAM_USAGE 0x41
+#define CTAPHID_VENDOR_SIGN_BENCH 0x42
+
+// Signers the CTAPHID_VENDOR_SIGN_BENCH command's first payload byte picks
+#define SIGN_BENCH_P256 0
+#define SIGN_BENCH_ED25519 1
+
+// CTAPHID Keepalive Statuses
+#define CTAPHID_STATUS_PROCESSING 1
+#define CTAPHID_STATUS_UPNEEDED 2
+
 // CTAPHID Errors
 #define CTAPHID_ERR_INVALID_CMD 0x01
 #define CTAPHID_ERR_INVALID_PAR 0x02
@@ -0,0 +1,100 @@
+#include <util/atomic.h>
+#include <string.h>
+
+#include "drbg.h"
+
+void drbg_init(drbg_t *d, const uint8_t *seed, uint16_t length)
+{
+    sha256(seed, length, d->key);
+    d->available = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < SHA256_DIGEST_LENGTH; i++)
+            d->entropy[i] = 0;
+        d->samples = 0;
+    }
+}
+
+// Called from the sampling interrupt. Only a sample's low bits are expected to vary, so each byte of
+// the buffer is rotated before the next sample is folded into it, keeping the two apart.
+void drbg_add_sample(drbg_t *d, uint8_t sample)
+{
+    uint8_t i = d->samples % SHA256_DIGEST_LENGTH;
+    uint8_t e = d->entropy[i];
+
+    d->entropy[i] = (uint8_t)(e << 1 | e >> 7) ^ sample;
+    if (d->samples < UINT8_MAX)
+        d->samples++;
+}
+
+// The pool was made with the old key, so it's thrown away.
+static void reseed(drbg_t *d)
+{
+    uint8_t entropy[SHA256_DIGEST_LENGTH];
+    sha256_t sha;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < SHA256_DIGEST_LENGTH; i++)
+        {
+            entropy[i] = d->entropy[i];
+            d->entropy[i] = 0;
+        }
+        d->samples = 0;
+    }
+
+    sha256_init(&sha);
+    sha256_update(&sha, d->key, sizeof(d->key));
+    sha256_update(&sha, entropy, sizeof(entropy));
+    sha256_final(&sha, d->key);
+
+    memset(d->pool, 0, sizeof(d->pool));
+    d->available = 0;
+}
+
+static void refill(drbg_t *d)
+{
+    uint8_t nonce[CHACHA20_NONCE_LENGTH] = {0};
+    uint8_t block[CHACHA20_BLOCK_LENGTH];
+
+    chacha20_block(d->key, 0, nonce, block);
+    memcpy(d->key, block, CHACHA20_KEY_LENGTH);
+    memcpy(d->pool, block + CHACHA20_KEY_LENGTH, DRBG_POOL_LENGTH);
+    memset(block, 0, sizeof(block));
+    d->available = DRBG_POOL_LENGTH;
+}
+
+/** Reseeds or refills the pool if either is due. Returns whether it did any work. */
+bool drbg_task(drbg_t *d)
+{
+    if (d->samples >= DRBG_RESEED_SAMPLES)
+    {
+        reseed(d);
+        return true;
+    }
+    if (d->available < DRBG_POOL_LENGTH)
+    {
+        refill(d);
+        return true;
+    }
+    return false;
+}
+
+// Bytes are taken from the end of the pool and wiped as they go. A read the pool is too short for
+// refills it there and then, which only happens if reads outpace the idle time between them.
+void drbg_read(drbg_t *d, uint8_t *data, uint8_t length)
+{
+    while (length > 0)
+    {
+        if (d->available == 0)
+            refill(d);
+
+        uint8_t size = length < d->available ? length : d->available;
+        d->available -= size;
+        memcpy(data, d->pool + d->available, size);
+        memset(d->pool + d->available, 0, size);
+        data += size;
+        length -= size;
+    }
+}
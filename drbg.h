@@ -0,0 +1,30 @@
+#include "chacha20.h"
+#include "sha256.h"
+
+#ifndef _DRBG_H_
+#define _DRBG_H_
+
+#define DRBG_POOL_LENGTH (CHACHA20_BLOCK_LENGTH - CHACHA20_KEY_LENGTH)
+
+// Entropy samples folded in before they're hashed into the key.
+#define DRBG_RESEED_SAMPLES 64
+
+// Random bytes from ChaCha20 with fast key erasure: each block's first half replaces the key that
+// made it, so bytes already handed out can't be recovered from the state. The other half refills a
+// pool in the main loop's idle time, and drbg_read takes from it in constant time. Entropy arrives
+// a sample at a time, from an interrupt, and is hashed into the key every DRBG_RESEED_SAMPLES.
+typedef struct
+{
+    uint8_t key[CHACHA20_KEY_LENGTH];
+    uint8_t pool[DRBG_POOL_LENGTH];
+    uint8_t available;
+    volatile uint8_t entropy[SHA256_DIGEST_LENGTH];
+    volatile uint8_t samples;
+} drbg_t;
+
+void drbg_init(drbg_t *d, const uint8_t *seed, uint16_t length);
+void drbg_add_sample(drbg_t *d, uint8_t sample);
+bool drbg_task(drbg_t *d);
+void drbg_read(drbg_t *d, uint8_t *data, uint8_t length);
+
+#endif
@@ -0,0 +1,605 @@
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "ed25519.h"
+
+// The scalar multiplications run on the Montgomery form of the curve, Curve25519, with the x-only
+// ladder of RFC 7748: each bit is 4 multiplies, 4 squares and 2 multiplies by small constants,
+// against twice that for the same ladder on the Edwards curve. The full point is recovered from the
+// two x coordinates the ladder ends with (Okeya and Sakurai) and mapped back to Edwards form to be
+// encoded.
+//
+// Field elements are only kept below 2^256, not fully reduced, and 2^256 is folded back in as 38.
+// Scalars mod L use a Montgomery multiplication, as mod n does for P-256. As there, nothing branches
+// on or indexes memory by secret values.
+
+#define WORD_BITS (8 * ED25519_WORD_SIZE)
+
+#if ED25519_WORD_SIZE == 1
+#define ED25519_CHUNK(c) (uint8_t)(c), (uint8_t)((c) >> 8), (uint8_t)((c) >> 16), (uint8_t)((c) >> 24)
+#define pgm_read_ed25519_word(addr) pgm_read_byte(addr)
+// -1/L mod 2^8
+#define L_INVERSE 0x1b
+#else
+#define ED25519_CHUNK(c) (c)
+#define pgm_read_ed25519_word(addr) pgm_read_dword(addr)
+// -1/L mod 2^32
+#define L_INVERSE 0x12547e1b
+#endif
+
+typedef ed25519_word_t fe_t[ED25519_WORDS];
+
+// The order of the base point.
+static const ed25519_word_t group_order[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x5CF5D3ED), ED25519_CHUNK(0x5812631A), ED25519_CHUNK(0xA2F79CD6), ED25519_CHUNK(0x14DEF9DE),
+    ED25519_CHUNK(0x00000000), ED25519_CHUNK(0x00000000), ED25519_CHUNK(0x00000000), ED25519_CHUNK(0x10000000),
+};
+
+// 2^512 and 2^768 mod L, which take numbers into and past Montgomery form.
+static const ed25519_word_t order_r2[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x449C0F01), ED25519_CHUNK(0xA40611E3), ED25519_CHUNK(0x68859347), ED25519_CHUNK(0xD00E1BA7),
+    ED25519_CHUNK(0x17F5BE65), ED25519_CHUNK(0xCEEC73D2), ED25519_CHUNK(0x7C309A3D), ED25519_CHUNK(0x0399411B),
+};
+
+static const ed25519_word_t order_r3[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x7B83A2DB), ED25519_CHUNK(0x2A9E4968), ED25519_CHUNK(0xAEF7F3EC), ED25519_CHUNK(0x278324E6),
+    ED25519_CHUNK(0x04EC5B65), ED25519_CHUNK(0x8065DC6C), ED25519_CHUNK(0x3599CEC7), ED25519_CHUNK(0x0E530B77),
+};
+
+// sqrt(-486664), which scales x in the map from Curve25519 to the Edwards curve.
+static const ed25519_word_t edwards_scale[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0xFF457E06), ED25519_CHUNK(0xCC6E04AA), ED25519_CHUNK(0x4B7D1A82), ED25519_CHUNK(0xC5A1D3D1),
+    ED25519_CHUNK(0x03FC4F7E), ED25519_CHUNK(0xD27B08DC), ED25519_CHUNK(0x60A006BB), ED25519_CHUNK(0x0F26EDF4),
+};
+
+// Twice the base point's v coordinate on Curve25519 (its u is 9).
+static const ed25519_word_t base_two_v[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x0262583B), ED25519_CHUNK(0xAC2C74BB), ED25519_CHUNK(0x25073C9B), ED25519_CHUNK(0xDB856503),
+    ED25519_CHUNK(0x116E5D66), ED25519_CHUNK(0x3FC245A7), ED25519_CHUNK(0x8EBEF296), ED25519_CHUNK(0x3EA3CCBC),
+};
+
+// -B on the Edwards curve, the one result the recovery can't give.
+static const ed25519_word_t negative_base_x[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x70DA2AD3), ED25519_CHUNK(0x36A9D29F), ED25519_CHUNK(0x6ADA584D), ED25519_CHUNK(0x96D3389F),
+    ED25519_CHUNK(0x022923A3), ED25519_CHUNK(0x3F5B1DCE), ED25519_CHUNK(0x3291AC01), ED25519_CHUNK(0x5E96C92C),
+};
+
+static const ed25519_word_t base_y[ED25519_WORDS] PROGMEM = {
+    ED25519_CHUNK(0x66666658), ED25519_CHUNK(0x66666666), ED25519_CHUNK(0x66666666), ED25519_CHUNK(0x66666666),
+    ED25519_CHUNK(0x66666666), ED25519_CHUNK(0x66666666), ED25519_CHUNK(0x66666666), ED25519_CHUNK(0x66666666),
+};
+
+// Curve25519's ladder constant (A - 2) / 4, twice its A, and the base point's u.
+#define LADDER_A24 121665
+#define CURVE_TWO_A 973324
+#define BASE_U 9
+
+static void load(ed25519_word_t *r, const ed25519_word_t *progmem)
+{
+    memcpy_P(r, progmem, sizeof(fe_t));
+}
+
+static void set_small(ed25519_word_t *r, uint32_t value)
+{
+    memset(r, 0, sizeof(fe_t));
+    for (uint8_t i = 0; i < ED25519_WORDS && i * WORD_BITS < 32; i++)
+        r[i] = value >> (i * WORD_BITS);
+}
+
+static void from_bytes(ed25519_word_t *r, const uint8_t bytes[32])
+{
+    memset(r, 0, sizeof(fe_t));
+    for (uint8_t i = 0; i < 32; i++)
+        r[i / ED25519_WORD_SIZE] |= (ed25519_word_t)bytes[i] << (8 * (i % ED25519_WORD_SIZE));
+}
+
+static void to_bytes(uint8_t bytes[32], const ed25519_word_t *a)
+{
+    for (uint8_t i = 0; i < 32; i++)
+        bytes[i] = a[i / ED25519_WORD_SIZE] >> (8 * (i % ED25519_WORD_SIZE));
+}
+
+static bool is_zero(const ed25519_word_t *a)
+{
+    ed25519_word_t bits = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+        bits |= a[i];
+    return bits == 0;
+}
+
+// Swaps a and b if mask is all ones, leaves them if it's 0.
+static void swap_masked(ed25519_word_t *a, ed25519_word_t *b, ed25519_word_t mask)
+{
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_word_t t = (a[i] ^ b[i]) & mask;
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+// Sets a to b if mask is all ones.
+static void select_masked(ed25519_word_t *a, const ed25519_word_t *b, ed25519_word_t mask)
+{
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+        a[i] ^= (a[i] ^ b[i]) & mask;
+}
+
+// Adds c * 38 to r and folds any carry out of the top back in the same way. The second pass can't
+// carry: if the first did, r is now small.
+static void fold_carry(ed25519_word_t *r, uint16_t c)
+{
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        ed25519_dword_t acc = (ed25519_dword_t)c * 38;
+        for (uint8_t i = 0; i < ED25519_WORDS; i++)
+        {
+            acc += r[i];
+            r[i] = acc;
+            acc >>= WORD_BITS;
+        }
+        c = acc;
+    }
+}
+
+static void fe_add(ed25519_word_t *r, const ed25519_word_t *a, const ed25519_word_t *b)
+{
+    ed25519_word_t carry = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_dword_t sum = (ed25519_dword_t)a[i] + b[i] + carry;
+        r[i] = sum;
+        carry = sum >> WORD_BITS;
+    }
+    fold_carry(r, carry);
+}
+
+// r = a - b, where a borrow out of the top means r is 2^256 (38) too big.
+static void fe_sub(ed25519_word_t *r, const ed25519_word_t *a, const ed25519_word_t *b)
+{
+    ed25519_word_t borrow = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_dword_t diff = (ed25519_dword_t)a[i] - b[i] - borrow;
+        r[i] = diff;
+        borrow = (diff >> WORD_BITS) & 1;
+    }
+
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        ed25519_word_t subtract = borrow * 38;
+        borrow = 0;
+        for (uint8_t i = 0; i < ED25519_WORDS; i++)
+        {
+            ed25519_dword_t diff = (ed25519_dword_t)r[i] - subtract - borrow;
+            r[i] = diff;
+            borrow = (diff >> WORD_BITS) & 1;
+            subtract = 0;
+        }
+    }
+}
+
+// Folds the top half of a 512 bit product into the bottom: 2^256 is 38 mod p.
+static void fe_reduce(ed25519_word_t *r, const ed25519_word_t product[2 * ED25519_WORDS])
+{
+    ed25519_dword_t acc = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        acc += (ed25519_dword_t)product[i + ED25519_WORDS] * 38 + product[i];
+        r[i] = acc;
+        acc >>= WORD_BITS;
+    }
+    fold_carry(r, acc);
+}
+
+static void fe_mul(ed25519_word_t *r, const ed25519_word_t *a, const ed25519_word_t *b)
+{
+    ed25519_word_t product[2 * ED25519_WORDS];
+    memset(product, 0, sizeof(product));
+
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_word_t carry = 0;
+        for (uint8_t j = 0; j < ED25519_WORDS; j++)
+        {
+            ed25519_dword_t v = (ed25519_dword_t)a[i] * b[j] + product[i + j] + carry;
+            product[i + j] = v;
+            carry = v >> WORD_BITS;
+        }
+        product[i + ED25519_WORDS] = carry;
+    }
+
+    fe_reduce(r, product);
+}
+
+// Only the products above the diagonal are multiplied out, then doubled.
+static void fe_square(ed25519_word_t *r, const ed25519_word_t *a)
+{
+    ed25519_word_t product[2 * ED25519_WORDS];
+    memset(product, 0, sizeof(product));
+
+    for (uint8_t i = 0; i < ED25519_WORDS - 1; i++)
+    {
+        ed25519_word_t carry = 0;
+        for (uint8_t j = i + 1; j < ED25519_WORDS; j++)
+        {
+            ed25519_dword_t v = (ed25519_dword_t)a[i] * a[j] + product[i + j] + carry;
+            product[i + j] = v;
+            carry = v >> WORD_BITS;
+        }
+        product[i + ED25519_WORDS] = carry;
+    }
+
+    ed25519_word_t carry = 0;
+    for (uint8_t i = 0; i < 2 * ED25519_WORDS; i++)
+    {
+        ed25519_word_t doubled = product[i] << 1 | carry;
+        carry = product[i] >> (WORD_BITS - 1);
+        product[i] = doubled;
+    }
+
+    carry = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_dword_t v = (ed25519_dword_t)a[i] * a[i] + product[2 * i] + carry;
+        product[2 * i] = v;
+        v = (ed25519_dword_t)product[2 * i + 1] + (v >> WORD_BITS);
+        product[2 * i + 1] = v;
+        carry = v >> WORD_BITS;
+    }
+
+    fe_reduce(r, product);
+}
+
+// Fully reduces r mod p = 2^255 - 19.
+static void fe_freeze(ed25519_word_t *r)
+{
+    // Below 2^255 + 19 after folding in bit 255...
+    ed25519_word_t top = r[ED25519_WORDS - 1] >> (WORD_BITS - 1);
+    r[ED25519_WORDS - 1] &= (ed25519_word_t)-1 >> 1;
+    ed25519_dword_t acc = (ed25519_dword_t)top * 19;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        acc += r[i];
+        r[i] = acc;
+        acc >>= WORD_BITS;
+    }
+
+    // ...so at most one p to take off, which is when r + 19 reaches 2^255.
+    fe_t t;
+    acc = 19;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        acc += r[i];
+        t[i] = acc;
+        acc >>= WORD_BITS;
+    }
+    ed25519_word_t reduce = -(ed25519_word_t)(t[ED25519_WORDS - 1] >> (WORD_BITS - 1));
+    t[ED25519_WORDS - 1] &= (ed25519_word_t)-1 >> 1;
+    select_masked(r, t, reduce);
+}
+
+// r = a^(p - 2) = 1/a. p - 2 is 2^255 - 21, all ones but for bits 2 and 4.
+static void fe_invert(ed25519_word_t *r, const ed25519_word_t *a)
+{
+    fe_t c;
+    memcpy(c, a, sizeof(c));
+    for (int16_t bit = 253; bit >= 0; bit--)
+    {
+        fe_square(c, c);
+        if (bit != 2 && bit != 4)
+            fe_mul(c, c, a);
+    }
+    memcpy(r, c, sizeof(c));
+}
+
+// Takes L off a number below 2L if it's at least L.
+static void order_reduce_once(ed25519_word_t *r, const ed25519_word_t *a)
+{
+    fe_t reduced;
+    ed25519_word_t borrow = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_dword_t diff = (ed25519_dword_t)a[i] - pgm_read_ed25519_word(&group_order[i]) - borrow;
+        reduced[i] = diff;
+        borrow = (diff >> WORD_BITS) & 1;
+    }
+    memmove(r, a, sizeof(reduced));
+    select_masked(r, reduced, borrow - 1);
+}
+
+// Montgomery multiplication mod L, as scalar_mul is mod n for P-256.
+static void order_mul(ed25519_word_t *r, const ed25519_word_t *a, const ed25519_word_t *b)
+{
+    ed25519_word_t t[ED25519_WORDS + 2];
+    memset(t, 0, sizeof(t));
+
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_word_t carry = 0;
+        for (uint8_t j = 0; j < ED25519_WORDS; j++)
+        {
+            ed25519_dword_t v = (ed25519_dword_t)a[j] * b[i] + t[j] + carry;
+            t[j] = v;
+            carry = v >> WORD_BITS;
+        }
+        ed25519_dword_t v = (ed25519_dword_t)t[ED25519_WORDS] + carry;
+        t[ED25519_WORDS] = v;
+        t[ED25519_WORDS + 1] = v >> WORD_BITS;
+
+        ed25519_word_t m = t[0] * (ed25519_word_t)L_INVERSE;
+        v = (ed25519_dword_t)m * pgm_read_ed25519_word(&group_order[0]) + t[0];
+        carry = v >> WORD_BITS;
+        for (uint8_t j = 1; j < ED25519_WORDS; j++)
+        {
+            v = (ed25519_dword_t)m * pgm_read_ed25519_word(&group_order[j]) + t[j] + carry;
+            t[j - 1] = v;
+            carry = v >> WORD_BITS;
+        }
+        v = (ed25519_dword_t)t[ED25519_WORDS] + carry;
+        t[ED25519_WORDS - 1] = v;
+        t[ED25519_WORDS] = t[ED25519_WORDS + 1] + (v >> WORD_BITS);
+    }
+
+    // t is below 2L, and L is below 2^253, so there's nothing in its top words.
+    order_reduce_once(r, t);
+}
+
+// r = a + b mod L, for a and b below L.
+static void order_add(ed25519_word_t *r, const ed25519_word_t *a, const ed25519_word_t *b)
+{
+    fe_t sum;
+    ed25519_word_t carry = 0;
+    for (uint8_t i = 0; i < ED25519_WORDS; i++)
+    {
+        ed25519_dword_t v = (ed25519_dword_t)a[i] + b[i] + carry;
+        sum[i] = v;
+        carry = v >> WORD_BITS;
+    }
+    order_reduce_once(r, sum);
+}
+
+// r = a 64 byte little endian number, h 2^256 + l, mod L. In Montgomery form that's h 2^512 + l 2^256,
+// which is one multiplication for each half.
+static void order_reduce(ed25519_word_t *r, const uint8_t digest[SHA512_DIGEST_LENGTH])
+{
+    fe_t half;
+    fe_t k;
+
+    from_bytes(half, digest + 32);
+    load(k, order_r3);
+    order_mul(r, half, k);
+
+    from_bytes(half, digest);
+    load(k, order_r2);
+    order_mul(half, half, k);
+
+    order_add(r, r, half);
+    set_small(k, 1);
+    order_mul(r, r, k);
+}
+
+// Starts the ladder with infinity and B, over 255 bits: scalars are below 2^255.
+static void ladder_start(ed25519_sign_t *s)
+{
+    set_small(s->x2, 1);
+    set_small(s->z2, 0);
+    set_small(s->x3, BASE_U);
+    set_small(s->z3, 1);
+    s->swap = 0;
+    s->bit = 255;
+}
+
+// Runs the RFC 7748 ladder down over up to count bits of scalar. Returns whether there's more to go.
+static bool ladder_bits(ed25519_sign_t *s, const ed25519_word_t *scalar, uint8_t count)
+{
+    fe_t a, aa, b, bb, e, c, d;
+
+    while (s->bit > 0 && count--)
+    {
+        s->bit--;
+        uint8_t k = (scalar[s->bit / WORD_BITS] >> (s->bit % WORD_BITS)) & 1;
+        s->swap ^= k;
+        swap_masked(s->x2, s->x3, -(ed25519_word_t)s->swap);
+        swap_masked(s->z2, s->z3, -(ed25519_word_t)s->swap);
+        s->swap = k;
+
+        fe_add(a, s->x2, s->z2);
+        fe_square(aa, a);
+        fe_sub(b, s->x2, s->z2);
+        fe_square(bb, b);
+        fe_sub(e, aa, bb);
+        fe_add(c, s->x3, s->z3);
+        fe_sub(d, s->x3, s->z3);
+        fe_mul(d, d, a);        // DA
+        fe_mul(c, c, b);        // CB
+        fe_add(s->x3, d, c);
+        fe_square(s->x3, s->x3);
+        fe_sub(s->z3, d, c);
+        fe_square(s->z3, s->z3);
+        set_small(a, BASE_U);
+        fe_mul(s->z3, s->z3, a);
+        fe_mul(s->x2, aa, bb);
+        set_small(a, LADDER_A24);
+        fe_mul(s->z2, e, a);
+        fe_add(s->z2, s->z2, aa);
+        fe_mul(s->z2, s->z2, e);
+    }
+
+    if (s->bit > 0)
+        return true;
+
+    swap_masked(s->x2, s->x3, -(ed25519_word_t)s->swap);
+    swap_masked(s->z2, s->z3, -(ed25519_word_t)s->swap);
+    return false;
+}
+
+// Encodes the Edwards point for the ladder's result: kB in (x2 : z2) and (k + 1)B in (x3 : z3).
+static void ladder_encode(ed25519_sign_t *s, uint8_t encoded[32])
+{
+    fe_t v1, v2, v3, v4;
+    fe_t x, y, z;
+
+    // Okeya-Sakurai recovery of the projective (X : Y : Z) on Curve25519, as in Costello and Smith's
+    // "Montgomery curves and their arithmetic", algorithm 5.
+    set_small(v4, BASE_U);
+    fe_mul(v1, v4, s->z2);
+    fe_add(v2, s->x2, v1);
+    fe_sub(v3, s->x2, v1);
+    fe_square(v3, v3);
+    fe_mul(v3, v3, s->x3);
+    set_small(v1, CURVE_TWO_A);
+    fe_mul(v1, v1, s->z2);
+    fe_add(v2, v2, v1);
+    fe_mul(v4, v4, s->x2);
+    fe_add(v4, v4, s->z2);
+    fe_mul(v2, v2, v4);
+    fe_mul(v1, v1, s->z2);
+    fe_sub(v2, v2, v1);
+    fe_mul(v2, v2, s->z3);
+    fe_sub(y, v2, v3);
+    load(v1, base_two_v);
+    fe_mul(v1, v1, s->z2);
+    fe_mul(v1, v1, s->z3);
+    fe_mul(x, v1, s->x2);
+    fe_mul(z, v1, s->z2);
+
+    // To Edwards: x = sqrt(-486664) X / Y and y = (X - Z) / (X + Z), sharing one inversion.
+    fe_add(v1, x, z);
+    fe_sub(v2, x, z);
+    fe_mul(v3, y, v1);
+    fe_invert(v3, v3);
+    fe_mul(v2, v2, y);
+    fe_mul(v2, v2, v3);     // y
+    fe_mul(v1, v1, x);
+    fe_mul(v1, v1, v3);
+    load(v4, edwards_scale);
+    fe_mul(v1, v1, v4);     // x
+
+    // kB at infinity encodes as (0, 1), and (k + 1)B at infinity means kB is -B.
+    fe_freeze(s->z2);
+    fe_freeze(s->z3);
+    ed25519_word_t infinite = -(ed25519_word_t)is_zero(s->z2);
+    ed25519_word_t negative_base = -(ed25519_word_t)is_zero(s->z3);
+    set_small(v3, 0);
+    select_masked(v1, v3, infinite);
+    set_small(v3, 1);
+    select_masked(v2, v3, infinite);
+    load(v3, negative_base_x);
+    select_masked(v1, v3, negative_base);
+    load(v3, base_y);
+    select_masked(v2, v3, negative_base);
+
+    fe_freeze(v1);
+    fe_freeze(v2);
+    to_bytes(encoded, v2);
+    encoded[31] |= (v1[0] & 1) << 7;
+}
+
+// The secret scalar is the clamped first half of the seed's hash, and the second half prefixes the
+// message for the nonce.
+static void expand_seed(ed25519_word_t *a, uint8_t prefix[32], const uint8_t seed[ED25519_SEED_LENGTH])
+{
+    uint8_t h[SHA512_DIGEST_LENGTH];
+    sha512(seed, ED25519_SEED_LENGTH, h);
+
+    h[0] &= 248;
+    h[31] &= 127;
+    h[31] |= 64;
+    from_bytes(a, h);
+    if (prefix)
+        memcpy(prefix, h + 32, 32);
+    memset(h, 0, sizeof(h));
+}
+
+void ed25519_public_key(const uint8_t seed[ED25519_SEED_LENGTH], uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH])
+{
+    ed25519_sign_t s;
+    expand_seed(s.a, NULL, seed);
+
+    ladder_start(&s);
+    while (ladder_bits(&s, s.a, ED25519_LADDER_STEP_BITS))
+        ;
+    ladder_encode(&s, public_key);
+    memset(&s, 0, sizeof(s));
+}
+
+// Starts a signature with the key pair, and starts hashing the message for the nonce.
+void ed25519_sign_start(ed25519_sign_t *s, const uint8_t seed[ED25519_SEED_LENGTH], const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH])
+{
+    uint8_t prefix[32];
+    expand_seed(s->a, prefix, seed);
+    memcpy(s->public_key, public_key, ED25519_PUBLIC_KEY_LENGTH);
+
+    sha512_init(&s->sha);
+    sha512_update(&s->sha, prefix, sizeof(prefix));
+    memset(prefix, 0, sizeof(prefix));
+}
+
+void ed25519_sign_update(ed25519_sign_t *s, const uint8_t *data, uint16_t length)
+{
+    sha512_update(&s->sha, data, length);
+}
+
+// Ends the first pass over the message and starts multiplying the base point by the nonce.
+void ed25519_sign_nonce(ed25519_sign_t *s)
+{
+    uint8_t h[SHA512_DIGEST_LENGTH];
+    sha512_final(&s->sha, h);
+    order_reduce(s->r, h);
+    memset(h, 0, sizeof(h));
+
+    ladder_start(s);
+}
+
+// Runs the next ED25519_LADDER_STEP_BITS bits of the multiplication. Once it's done, starts the
+// second pass over the message, and returns false.
+bool ed25519_sign_step(ed25519_sign_t *s)
+{
+    if (ladder_bits(s, s->r, ED25519_LADDER_STEP_BITS))
+        return true;
+
+    uint8_t encoded[32];
+    ladder_encode(s, encoded);
+    memcpy(s->encoded_r, encoded, sizeof(encoded));
+
+    sha512_init(&s->sha);
+    sha512_update(&s->sha, s->encoded_r, sizeof(s->encoded_r));
+    sha512_update(&s->sha, s->public_key, sizeof(s->public_key));
+    return false;
+}
+
+// Writes the signature, R and then S = r + H(R, A, message) a mod L.
+void ed25519_sign_finish(ed25519_sign_t *s, uint8_t signature[ED25519_SIGNATURE_LENGTH])
+{
+    uint8_t h[SHA512_DIGEST_LENGTH];
+    fe_t k;
+    fe_t t;
+
+    sha512_final(&s->sha, h);
+    order_reduce(k, h);
+
+    load(t, order_r2);
+    order_mul(k, k, t);
+    order_mul(k, k, s->a);
+    order_add(k, k, s->r);
+
+    memcpy(signature, s->encoded_r, 32);
+    to_bytes(signature + 32, k);
+
+    memset(h, 0, sizeof(h));
+    memset(k, 0, sizeof(k));
+    memset(s, 0, sizeof(*s));
+}
+
+void ed25519_sign(const uint8_t seed[ED25519_SEED_LENGTH], const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH], const uint8_t *message, uint16_t length, uint8_t signature[ED25519_SIGNATURE_LENGTH])
+{
+    ed25519_sign_t s;
+    ed25519_sign_start(&s, seed, public_key);
+    ed25519_sign_update(&s, message, length);
+    ed25519_sign_nonce(&s);
+    while (ed25519_sign_step(&s))
+        ;
+    ed25519_sign_update(&s, message, length);
+    ed25519_sign_finish(&s, signature);
+}
@@ -0,0 +1,73 @@
+#include "sha512.h"
+
+#ifndef _ED25519_H_
+#define _ED25519_H_
+
+#define ED25519_SEED_LENGTH 32
+#define ED25519_PUBLIC_KEY_LENGTH 32
+#define ED25519_SIGNATURE_LENGTH 64
+
+// Numbers are little endian arrays of the widest word the CPU multiplies natively, as for P-256.
+#ifndef ED25519_WORD_SIZE
+#ifdef __AVR__
+#define ED25519_WORD_SIZE 1
+#else
+#define ED25519_WORD_SIZE 4
+#endif
+#endif
+
+#if ED25519_WORD_SIZE == 1
+typedef uint8_t ed25519_word_t;
+typedef uint16_t ed25519_dword_t;
+#elif ED25519_WORD_SIZE == 4
+typedef uint32_t ed25519_word_t;
+typedef uint64_t ed25519_dword_t;
+#else
+#error "ED25519_WORD_SIZE must be 1 or 4"
+#endif
+
+#define ED25519_WORDS (32 / ED25519_WORD_SIZE)
+
+// Bits of the scalar multiplication run per ed25519_sign_step.
+#define ED25519_LADDER_STEP_BITS 16
+
+// An Ed25519 signature being made. The message is hashed twice, once for the nonce and once for
+// the challenge, and is streamed through SHA-512 both times rather than held:
+//
+//   ed25519_sign_start(), ed25519_sign_update() with the message, ed25519_sign_nonce(),
+//   ed25519_sign_step() until it returns false, ed25519_sign_update() with the message again,
+//   ed25519_sign_finish().
+//
+// The scalar multiplication runs a few bits per step, like p256_sign_t's.
+typedef struct
+{
+    sha512_t sha;
+    union
+    {
+        struct
+        {
+            ed25519_word_t x2[ED25519_WORDS];
+            ed25519_word_t z2[ED25519_WORDS];
+            ed25519_word_t x3[ED25519_WORDS];
+            ed25519_word_t z3[ED25519_WORDS];
+        };
+        // R, once the ladder's done with.
+        uint8_t encoded_r[32];
+    };
+    ed25519_word_t r[ED25519_WORDS];
+    ed25519_word_t a[ED25519_WORDS];
+    uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH];
+    uint8_t bit;
+    uint8_t swap;
+} ed25519_sign_t;
+
+void ed25519_public_key(const uint8_t seed[ED25519_SEED_LENGTH], uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH]);
+
+void ed25519_sign_start(ed25519_sign_t *s, const uint8_t seed[ED25519_SEED_LENGTH], const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH]);
+void ed25519_sign_update(ed25519_sign_t *s, const uint8_t *data, uint16_t length);
+void ed25519_sign_nonce(ed25519_sign_t *s);
+bool ed25519_sign_step(ed25519_sign_t *s);
+void ed25519_sign_finish(ed25519_sign_t *s, uint8_t signature[ED25519_SIGNATURE_LENGTH]);
+void ed25519_sign(const uint8_t seed[ED25519_SEED_LENGTH], const uint8_t public_key[ED25519_PUBLIC_KEY_LENGTH], const uint8_t *message, uint16_t length, uint8_t signature[ED25519_SIGNATURE_LENGTH]);
+
+#endif
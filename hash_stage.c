@@ -0,0 +1,119 @@
+#include "hash_stage.h"
+
+void hash_stage_start(hash_stage_t *h, ctap2hid_transaction_t *transaction, field_locator_t *locate)
+{
+    h->state = HASH_STAGE_LOCATING;
+    h->transaction = transaction;
+    h->channel_id = transaction->reassembler.message.channel_id;
+    h->locate = locate;
+    h->searched = 0;
+}
+
+void hash_stage_stop(hash_stage_t *h)
+{
+    h->state = HASH_STAGE_IDLE;
+}
+
+bool hash_stage_is_on(hash_stage_t *h, uint32_t channel_id)
+{
+    return h->state != HASH_STAGE_IDLE && h->channel_id == channel_id;
+}
+
+// Whether the transaction is still the one the stage was started on. A released transaction may
+// have been reused by another channel since.
+static bool has_transaction(hash_stage_t *h, ctap2hid_transaction_t *transaction)
+{
+    return h->state != HASH_STAGE_IDLE && h->transaction == transaction && transaction->in_use &&
+           transaction->reassembler.message.channel_id == h->channel_id;
+}
+
+// The request is located in over its full length, though only what's been received is there yet.
+// Every head the locator reads before the field's is in the received part, so the field it returns
+// is only trusted if it starts there too; anything else might have come from the stale rest of the
+// buffer, and is looked for again once more has arrived.
+static bool locate(hash_stage_t *h)
+{
+    ctap2hid_reassembler_t *r = &h->transaction->reassembler;
+    ctap2hid_message_view_t view = message_view(&r->message);
+    ctap2hid_view_cursor_t field;
+
+    if (r->received == h->searched)
+        return false;
+    h->searched = r->received;
+
+    if (h->locate(&view, &field) != CTAP2_OK || field.offset > r->received)
+    {
+        if (!r->active)
+            h->state = HASH_STAGE_FAILED;
+        return true;
+    }
+
+    h->start = field.offset;
+    h->position = field.offset;
+    h->end = field.offset + view_remaining(&field);
+    sha256_init(&h->sha);
+    h->state = HASH_STAGE_HASHING;
+    return true;
+}
+
+// Hashes the field's newly received bytes, up to the end of the block being filled, so a run costs
+// at most one compression.
+static bool hash_received(hash_stage_t *h)
+{
+    ctap2hid_reassembler_t *r = &h->transaction->reassembler;
+    uint16_t available = MIN(r->received, h->end) - h->position;
+    uint8_t room = SHA256_BLOCK_LENGTH - h->sha.length % SHA256_BLOCK_LENGTH;
+    uint16_t size = MIN(available, room);
+
+    if (size == 0)
+        return false;
+
+    sha256_update(&h->sha, r->message.payload + h->position, size);
+    h->position += size;
+    return true;
+}
+
+/** Runs the stage a step further. Returns whether it did any work. */
+bool hash_stage_run(hash_stage_t *h)
+{
+    if (h->state == HASH_STAGE_IDLE)
+        return false;
+
+    // A request that's gone (or failed) before the stage's digest was taken leaves it free again.
+    if (!has_transaction(h, h->transaction))
+    {
+        h->state = HASH_STAGE_IDLE;
+        return false;
+    }
+
+    if (h->state == HASH_STAGE_FAILED)
+        return false;
+    if (h->state == HASH_STAGE_LOCATING)
+        return locate(h);
+    return hash_received(h);
+}
+
+// Hashes a field of a transaction's complete request, finishing what the stage started if it was on
+// the same field, or from scratch if it wasn't. Either way the stage is stopped.
+void hash_stage_digest(hash_stage_t *h, ctap2hid_transaction_t *transaction, ctap2hid_view_cursor_t field, uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    uint16_t start = field.offset;
+    uint16_t end = start + view_remaining(&field);
+
+    if (has_transaction(h, transaction) && h->state == HASH_STAGE_HASHING && h->start == start && h->end == end)
+    {
+        sha256_update(&h->sha, transaction->reassembler.message.payload + h->position, end - h->position);
+    }
+    else
+    {
+        const uint8_t *data;
+        uint16_t size;
+
+        sha256_init(&h->sha);
+        while ((size = view_next_chunk(&field, &data, UINT16_MAX)) > 0)
+            sha256_update(&h->sha, data, size);
+    }
+
+    sha256_final(&h->sha, digest);
+    h->state = HASH_STAGE_IDLE;
+}
@@ -0,0 +1,46 @@
+#include "ctap2.h"
+#include "ctap2hid_transaction.h"
+#include "sha256.h"
+
+#ifndef _HASH_STAGE_H_
+#define _HASH_STAGE_H_
+
+typedef enum
+{
+    HASH_STAGE_IDLE,
+    HASH_STAGE_LOCATING,
+    HASH_STAGE_HASHING,
+    HASH_STAGE_FAILED,
+} hash_stage_state_t;
+
+// Finds the field to hash in a request. It's given the whole message's view, of which only the
+// bytes received so far are valid, and should return CTAP2_OK with field over the field's bytes.
+typedef uint8_t field_locator_t(const ctap2hid_message_view_t *request, ctap2hid_view_cursor_t *field);
+
+// Hashes a field of a request while the rest of the request is still arriving, a block per run, so
+// the hashing is done in the main loop's idle time between packets rather than once the request is
+// complete. The field is located as soon as the packets holding its head have arrived, and its
+// bytes are hashed as they're received.
+typedef struct
+{
+    hash_stage_state_t state;
+    ctap2hid_transaction_t *transaction;
+    uint32_t channel_id;
+    field_locator_t *locate;
+    // Bytes received when the field was last looked for, so it's only looked for again once more
+    // have arrived.
+    uint16_t searched;
+    // The field's start, the next byte of it to hash, and its end, as offsets into the payload.
+    uint16_t start;
+    uint16_t position;
+    uint16_t end;
+    sha256_t sha;
+} hash_stage_t;
+
+void hash_stage_start(hash_stage_t *h, ctap2hid_transaction_t *transaction, field_locator_t *locate);
+void hash_stage_stop(hash_stage_t *h);
+bool hash_stage_is_on(hash_stage_t *h, uint32_t channel_id);
+bool hash_stage_run(hash_stage_t *h);
+void hash_stage_digest(hash_stage_t *h, ctap2hid_transaction_t *transaction, ctap2hid_view_cursor_t field, uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+#endif
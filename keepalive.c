@@ -0,0 +1,64 @@
+#include <util/atomic.h>
+
+#include "keepalive.h"
+
+void keepalive_start(keepalive_t *k, uint32_t channel_id, uint8_t status)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        k->active = true;
+        k->due = false;
+        k->status = status;
+        k->ms_till_due = KEEPALIVE_INTERVAL_MS;
+        k->channel_id = channel_id;
+    }
+}
+
+// Changes what's reported from the next keepalive on, e.g. once a request starts waiting for the
+// user to touch the device.
+void keepalive_set_status(keepalive_t *k, uint8_t status)
+{
+    k->status = status;
+}
+
+// Stops reporting, dropping any keepalive that's due but not yet sent, so none follows the response.
+void keepalive_stop(keepalive_t *k)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        k->active = false;
+        k->due = false;
+    }
+}
+
+// Counts down a millisecond. Returns whether a keepalive has become due.
+bool keepalive_tick(keepalive_t *k)
+{
+    if (!k->active || --k->ms_till_due > 0)
+        return false;
+
+    k->ms_till_due = KEEPALIVE_INTERVAL_MS;
+    k->due = true;
+    return true;
+}
+
+// Writes the due keepalive as a whole packet, the same way response_write_packet does. Returns
+// whether there was one.
+bool keepalive_write_packet(keepalive_t *k, stream_writer_t write)
+{
+    if (!k->due)
+        return false;
+
+    uint8_t packet[8];
+    memcpy(packet, &k->channel_id, 4);
+    packet[4] = CTAPHID_KEEPALIVE | 0x80;
+    packet[5] = 0;
+    packet[6] = 1;
+    packet[7] = k->status;
+
+    write(packet, sizeof(packet), false);
+    write(NULL, FIDO_REPORT_SIZE - sizeof(packet), false);
+
+    k->due = false;
+    return true;
+}
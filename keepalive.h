@@ -0,0 +1,27 @@
+#include "ctap2hid_message.h"
+
+#ifndef _KEEPALIVE_H_
+#define _KEEPALIVE_H_
+
+// Milliseconds (Start Of Frame ticks) between keepalives on a busy channel.
+#define KEEPALIVE_INTERVAL_MS 100
+
+// Reports the status of a request that's taking a while, on its channel, every
+// KEEPALIVE_INTERVAL_MS for as long as it's running. Ticked from the SOF interrupt and sent by
+// hid_poll_task, so it keeps going while the main loop is stuck in a handler.
+typedef struct
+{
+    bool active;
+    bool due;
+    uint8_t status;
+    uint8_t ms_till_due;
+    uint32_t channel_id;
+} keepalive_t;
+
+void keepalive_start(keepalive_t *k, uint32_t channel_id, uint8_t status);
+void keepalive_set_status(keepalive_t *k, uint8_t status);
+void keepalive_stop(keepalive_t *k);
+bool keepalive_tick(keepalive_t *k);
+bool keepalive_write_packet(keepalive_t *k, stream_writer_t write);
+
+#endif
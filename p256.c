@@ -0,0 +1,692 @@
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "p256.h"
+#include "sha256.h"
+
+// Field elements are kept in Montgomery form, x * 2^256 mod p, so that every multiplication is
+// followed by a Montgomery reduction instead of a division. For p that reduction needs no
+// multiplies at all: -1/p mod 2^256 is 1 and p is 2^256 - 2^224 + 2^192 + 2^96 - 1, so each step is
+// a handful of word additions and subtractions. Scalars mod n are only multiplied a few hundred
+// times per signature and use an ordinary Montgomery multiplication.
+//
+// Nothing branches on, or indexes memory by anything but a ladder bit of, secret values. The AVR
+// has no cache, so the ladder's indexing takes the same time either way.
+
+#define WORD_BITS (8 * P256_WORD_SIZE)
+
+#if P256_WORD_SIZE == 1
+typedef int16_t p256_sdword_t;
+#define P256_CHUNK(c) (uint8_t)(c), (uint8_t)((c) >> 8), (uint8_t)((c) >> 16), (uint8_t)((c) >> 24)
+#define pgm_read_p256_word(addr) pgm_read_byte(addr)
+// -1/n mod 2^8
+#define N_INVERSE 0x4f
+#else
+typedef int64_t p256_sdword_t;
+#define P256_CHUNK(c) (c)
+#define pgm_read_p256_word(addr) pgm_read_dword(addr)
+// -1/n mod 2^32
+#define N_INVERSE 0xee00bc4f
+#endif
+
+// Word offsets of the 2^96, 2^192 and 2^224 terms of p.
+#define P_96 (96 / WORD_BITS)
+#define P_192 (192 / WORD_BITS)
+#define P_224 (224 / WORD_BITS)
+
+static const p256_word_t curve_p[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0x00000000),
+    P256_CHUNK(0x00000000), P256_CHUNK(0x00000000), P256_CHUNK(0x00000001), P256_CHUNK(0xFFFFFFFF),
+};
+
+static const p256_word_t curve_n[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xFC632551), P256_CHUNK(0xF3B9CAC2), P256_CHUNK(0xA7179E84), P256_CHUNK(0xBCE6FAAD),
+    P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0x00000000), P256_CHUNK(0xFFFFFFFF),
+};
+
+// Inverses are taken as x^(m - 2), so they take the same time for every x.
+static const p256_word_t p_minus_2[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xFFFFFFFD), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0x00000000),
+    P256_CHUNK(0x00000000), P256_CHUNK(0x00000000), P256_CHUNK(0x00000001), P256_CHUNK(0xFFFFFFFF),
+};
+
+static const p256_word_t n_minus_2[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xFC63254F), P256_CHUNK(0xF3B9CAC2), P256_CHUNK(0xA7179E84), P256_CHUNK(0xBCE6FAAD),
+    P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0xFFFFFFFF), P256_CHUNK(0x00000000), P256_CHUNK(0xFFFFFFFF),
+};
+
+// The base point, in Montgomery form.
+static const p256_word_t base_x[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0x18A9143C), P256_CHUNK(0x79E730D4), P256_CHUNK(0x5FEDB601), P256_CHUNK(0x75BA95FC),
+    P256_CHUNK(0x77622510), P256_CHUNK(0x79FB732B), P256_CHUNK(0xA53755C6), P256_CHUNK(0x18905F76),
+};
+
+static const p256_word_t base_y[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xCE95560A), P256_CHUNK(0xDDF25357), P256_CHUNK(0xBA19E45C), P256_CHUNK(0x8B4AB8E4),
+    P256_CHUNK(0xDD21F325), P256_CHUNK(0xD2E88688), P256_CHUNK(0x25885D85), P256_CHUNK(0x8571FF18),
+};
+
+// 2^512 mod n, which takes a scalar into Montgomery form.
+static const p256_word_t n_r2[P256_WORDS] PROGMEM = {
+    P256_CHUNK(0xBE79EEA2), P256_CHUNK(0x83244C95), P256_CHUNK(0x49BD6FA6), P256_CHUNK(0x4699799C),
+    P256_CHUNK(0x2B6BEC59), P256_CHUNK(0x2845B239), P256_CHUNK(0xF3D95620), P256_CHUNK(0x66E12D94),
+};
+
+static void load(p256_word_t *r, const p256_word_t *progmem)
+{
+    memcpy_P(r, progmem, P256_WORDS * sizeof(p256_word_t));
+}
+
+static void from_bytes(p256_word_t *r, const uint8_t bytes[P256_SCALAR_LENGTH])
+{
+    memset(r, 0, P256_WORDS * sizeof(p256_word_t));
+    for (uint8_t i = 0; i < P256_SCALAR_LENGTH; i++)
+        r[i / P256_WORD_SIZE] |= (p256_word_t)bytes[P256_SCALAR_LENGTH - 1 - i] << (8 * (i % P256_WORD_SIZE));
+}
+
+static void to_bytes(uint8_t bytes[P256_SCALAR_LENGTH], const p256_word_t *a)
+{
+    for (uint8_t i = 0; i < P256_SCALAR_LENGTH; i++)
+        bytes[P256_SCALAR_LENGTH - 1 - i] = a[i / P256_WORD_SIZE] >> (8 * (i % P256_WORD_SIZE));
+}
+
+static bool is_zero(const p256_word_t *a)
+{
+    p256_word_t bits = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+        bits |= a[i];
+    return bits == 0;
+}
+
+static uint8_t test_bit(const p256_word_t *a, uint16_t bit)
+{
+    return (a[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+static p256_word_t add(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    p256_word_t carry = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_dword_t sum = (p256_dword_t)a[i] + b[i] + carry;
+        r[i] = sum;
+        carry = sum >> WORD_BITS;
+    }
+    return carry;
+}
+
+// r = a + (m & mask), with m in flash.
+static p256_word_t add_masked_P(p256_word_t *r, const p256_word_t *a, const p256_word_t *m, p256_word_t mask)
+{
+    p256_word_t carry = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_dword_t sum = (p256_dword_t)a[i] + (pgm_read_p256_word(&m[i]) & mask) + carry;
+        r[i] = sum;
+        carry = sum >> WORD_BITS;
+    }
+    return carry;
+}
+
+static p256_word_t sub(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    p256_word_t borrow = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_dword_t diff = (p256_dword_t)a[i] - b[i] - borrow;
+        r[i] = diff;
+        borrow = (diff >> WORD_BITS) & 1;
+    }
+    return borrow;
+}
+
+// r = a - (m & mask), with m in flash.
+static p256_word_t sub_masked_P(p256_word_t *r, const p256_word_t *a, const p256_word_t *m, p256_word_t mask)
+{
+    p256_word_t borrow = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_dword_t diff = (p256_dword_t)a[i] - (pgm_read_p256_word(&m[i]) & mask) - borrow;
+        r[i] = diff;
+        borrow = (diff >> WORD_BITS) & 1;
+    }
+    return borrow;
+}
+
+// Takes m off a (a number below 2m, with its top bit in carry) if it's at least m.
+static void reduce_once(p256_word_t *r, const p256_word_t *a, p256_word_t carry, const p256_word_t *m)
+{
+    p256_word_t reduced[P256_WORDS];
+    p256_word_t borrow = sub_masked_P(reduced, a, m, (p256_word_t)-1);
+    p256_word_t keep_reduced = -(p256_word_t)(carry | (borrow ^ 1));
+
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+        r[i] = (reduced[i] & keep_reduced) | (a[i] & ~keep_reduced);
+}
+
+static void mod_add(p256_word_t *r, const p256_word_t *a, const p256_word_t *b, const p256_word_t *m)
+{
+    p256_word_t carry = add(r, a, b);
+    reduce_once(r, r, carry, m);
+}
+
+static void mod_sub(p256_word_t *r, const p256_word_t *a, const p256_word_t *b, const p256_word_t *m)
+{
+    p256_word_t borrow = sub(r, a, b);
+    add_masked_P(r, r, m, -borrow);
+}
+
+static void multiply(p256_word_t product[2 * P256_WORDS], const p256_word_t *a, const p256_word_t *b)
+{
+    memset(product, 0, 2 * P256_WORDS * sizeof(p256_word_t));
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_word_t carry = 0;
+        for (uint8_t j = 0; j < P256_WORDS; j++)
+        {
+            p256_dword_t v = (p256_dword_t)a[i] * b[j] + product[i + j] + carry;
+            product[i + j] = v;
+            carry = v >> WORD_BITS;
+        }
+        product[i + P256_WORDS] = carry;
+    }
+}
+
+// Only the products above the diagonal are multiplied out, then doubled, which saves nearly half
+// the multiplies of squaring with multiply().
+static void square(p256_word_t product[2 * P256_WORDS], const p256_word_t *a)
+{
+    memset(product, 0, 2 * P256_WORDS * sizeof(p256_word_t));
+    for (uint8_t i = 0; i < P256_WORDS - 1; i++)
+    {
+        p256_word_t carry = 0;
+        for (uint8_t j = i + 1; j < P256_WORDS; j++)
+        {
+            p256_dword_t v = (p256_dword_t)a[i] * a[j] + product[i + j] + carry;
+            product[i + j] = v;
+            carry = v >> WORD_BITS;
+        }
+        product[i + P256_WORDS] = carry;
+    }
+
+    p256_word_t carry = 0;
+    for (uint8_t i = 0; i < 2 * P256_WORDS; i++)
+    {
+        p256_word_t doubled = product[i] << 1 | carry;
+        carry = product[i] >> (WORD_BITS - 1);
+        product[i] = doubled;
+    }
+
+    carry = 0;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_dword_t v = (p256_dword_t)a[i] * a[i] + product[2 * i] + carry;
+        product[2 * i] = v;
+        v = (p256_dword_t)product[2 * i + 1] + (v >> WORD_BITS);
+        product[2 * i + 1] = v;
+        carry = v >> WORD_BITS;
+    }
+}
+
+// Montgomery reduction of a product of two field elements, r = t / 2^256 mod p. Column by column,
+// each word m_i of the multiple of p being added is picked to clear column i, and its terms are
+// added into the columns above as they're reached, so the running sum is one signed accumulator.
+static void reduce_p(p256_word_t *r, p256_word_t t[2 * P256_WORDS])
+{
+    p256_sdword_t acc = 0;
+
+    for (uint8_t j = 0; j < 2 * P256_WORDS; j++)
+    {
+        acc += t[j];
+        if (j >= P_96 && j - P_96 < P256_WORDS)
+            acc += t[j - P_96];
+        if (j >= P_192 && j - P_192 < P256_WORDS)
+            acc += t[j - P_192];
+        if (j >= P_224 && j - P_224 < P256_WORDS)
+            acc -= t[j - P_224];
+        if (j >= P256_WORDS)
+            acc += t[j - P256_WORDS];
+
+        p256_word_t low = acc;
+        if (j < P256_WORDS)
+        {
+            // m_j replaces column j, which it clears, to be added in above.
+            t[j] = low;
+            acc -= low;
+        }
+        else
+            r[j - P256_WORDS] = low;
+
+        acc >>= WORD_BITS;
+    }
+
+    reduce_once(r, r, acc, curve_p);
+}
+
+static void field_mul(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    p256_word_t product[2 * P256_WORDS];
+    multiply(product, a, b);
+    reduce_p(r, product);
+}
+
+static void field_square(p256_word_t *r, const p256_word_t *a)
+{
+    p256_word_t product[2 * P256_WORDS];
+    square(product, a);
+    reduce_p(r, product);
+}
+
+static void field_add(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    mod_add(r, a, b, curve_p);
+}
+
+static void field_sub(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    mod_sub(r, a, b, curve_p);
+}
+
+// Montgomery multiplication mod n, interleaving each row of the product with its reduction.
+static void scalar_mul(p256_word_t *r, const p256_word_t *a, const p256_word_t *b)
+{
+    p256_word_t t[P256_WORDS + 2];
+    memset(t, 0, sizeof(t));
+
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+    {
+        p256_word_t carry = 0;
+        for (uint8_t j = 0; j < P256_WORDS; j++)
+        {
+            p256_dword_t v = (p256_dword_t)a[j] * b[i] + t[j] + carry;
+            t[j] = v;
+            carry = v >> WORD_BITS;
+        }
+        p256_dword_t v = (p256_dword_t)t[P256_WORDS] + carry;
+        t[P256_WORDS] = v;
+        t[P256_WORDS + 1] = v >> WORD_BITS;
+
+        p256_word_t m = t[0] * (p256_word_t)N_INVERSE;
+        v = (p256_dword_t)m * pgm_read_p256_word(&curve_n[0]) + t[0];
+        carry = v >> WORD_BITS;
+        for (uint8_t j = 1; j < P256_WORDS; j++)
+        {
+            v = (p256_dword_t)m * pgm_read_p256_word(&curve_n[j]) + t[j] + carry;
+            t[j - 1] = v;
+            carry = v >> WORD_BITS;
+        }
+        v = (p256_dword_t)t[P256_WORDS] + carry;
+        t[P256_WORDS - 1] = v;
+        t[P256_WORDS] = t[P256_WORDS + 1] + (v >> WORD_BITS);
+    }
+
+    reduce_once(r, t, t[P256_WORDS], curve_n);
+}
+
+// r = a^exponent, in the field or mod n, where the exponent is public and its top bit is set.
+static void power(p256_word_t *r, const p256_word_t *a, const p256_word_t *exponent, bool field)
+{
+    p256_word_t e[P256_WORDS];
+    p256_word_t base[P256_WORDS];
+    load(e, exponent);
+    memcpy(base, a, sizeof(base));
+    memcpy(r, a, sizeof(base));
+
+    for (int16_t bit = 8 * P256_SCALAR_LENGTH - 2; bit >= 0; bit--)
+    {
+        if (field)
+            field_square(r, r);
+        else
+            scalar_mul(r, r, r);
+
+        if (!test_bit(e, bit))
+            continue;
+        if (field)
+            field_mul(r, r, base);
+        else
+            scalar_mul(r, r, base);
+    }
+}
+
+// x = x * z^2, y = y * z^3
+static void apply_z(p256_word_t *x, p256_word_t *y, const p256_word_t *z)
+{
+    p256_word_t t[P256_WORDS];
+    field_square(t, z);
+    field_mul(x, x, t);
+    field_mul(t, t, z);
+    field_mul(y, y, t);
+}
+
+// Doubles (x, y, z) in place, using a = -3.
+static void double_jacobian(p256_word_t *x, p256_word_t *y, p256_word_t *z)
+{
+    p256_word_t t4[P256_WORDS];
+    p256_word_t t5[P256_WORDS];
+
+    field_square(t4, y);    // y^2
+    field_mul(t5, x, t4);   // A = x * y^2
+    field_square(t4, t4);   // y^4
+    field_mul(y, y, z);     // z3 = y * z
+    field_square(z, z);     // z^2
+
+    field_add(x, x, z);     // x + z^2
+    field_add(z, z, z);     // 2 z^2
+    field_sub(z, x, z);     // x - z^2
+    field_mul(x, x, z);     // x^2 - z^4
+
+    field_add(z, x, x);     // 2 (x^2 - z^4)
+    field_add(x, x, z);     // 3 (x^2 - z^4)
+
+    // B = 3/2 (x^2 - z^4): halved by adding p first if it's odd.
+    p256_word_t carry = add_masked_P(x, x, curve_p, -(x[0] & 1));
+    for (uint8_t i = 0; i < P256_WORDS - 1; i++)
+        x[i] = x[i] >> 1 | x[i + 1] << (WORD_BITS - 1);
+    x[P256_WORDS - 1] = x[P256_WORDS - 1] >> 1 | carry << (WORD_BITS - 1);
+
+    field_square(z, x);     // B^2
+    field_sub(z, z, t5);
+    field_sub(z, z, t5);    // x3 = B^2 - 2A
+    field_sub(t5, t5, z);   // A - x3
+    field_mul(x, x, t5);    // B (A - x3)
+    field_sub(t4, x, t4);   // y3 = B (A - x3) - y^4
+
+    memcpy(x, z, sizeof(t4));
+    memcpy(z, y, sizeof(t4));
+    memcpy(y, t4, sizeof(t4));
+}
+
+// Co-Z addition: given P = (x1, y1) and Q = (x2, y2) sharing a z, leaves P + Q in (x2, y2) and P
+// in (x1, y1), both with the new z.
+static void xycz_add(p256_word_t *x1, p256_word_t *y1, p256_word_t *x2, p256_word_t *y2)
+{
+    p256_word_t t5[P256_WORDS];
+
+    field_sub(t5, x2, x1);
+    field_square(t5, t5);   // A = (x2 - x1)^2
+    field_mul(x1, x1, t5);  // B = x1 A
+    field_mul(x2, x2, t5);  // C = x2 A
+    field_sub(y2, y2, y1);
+    field_square(t5, y2);   // D = (y2 - y1)^2
+
+    field_sub(t5, t5, x1);
+    field_sub(t5, t5, x2);  // x3 = D - B - C
+    field_sub(x2, x2, x1);
+    field_mul(y1, y1, x2);  // y1 (C - B)
+    field_sub(x2, x1, t5);
+    field_mul(y2, y2, x2);  // (y2 - y1)(B - x3)
+    field_sub(y2, y2, y1);  // y3
+
+    memcpy(x2, t5, sizeof(t5));
+}
+
+// Co-Z conjugate addition: leaves P + Q in (x2, y2) and P - Q in (x1, y1).
+static void xycz_add_c(p256_word_t *x1, p256_word_t *y1, p256_word_t *x2, p256_word_t *y2)
+{
+    p256_word_t t5[P256_WORDS];
+    p256_word_t t6[P256_WORDS];
+    p256_word_t t7[P256_WORDS];
+
+    field_sub(t5, x2, x1);
+    field_square(t5, t5);   // A = (x2 - x1)^2
+    field_mul(x1, x1, t5);  // B = x1 A
+    field_mul(x2, x2, t5);  // C = x2 A
+    field_add(t5, y2, y1);
+    field_sub(y2, y2, y1);
+
+    field_sub(t6, x2, x1);
+    field_mul(y1, y1, t6);  // E = y1 (C - B)
+    field_add(t6, x1, x2);  // B + C
+    field_square(x2, y2);   // D = (y2 - y1)^2
+    field_sub(x2, x2, t6);  // x3 = D - (B + C)
+
+    field_sub(t7, x1, x2);
+    field_mul(y2, y2, t7);
+    field_sub(y2, y2, y1);  // y3 = (y2 - y1)(B - x3) - E
+
+    field_square(t7, t5);   // F = (y2 + y1)^2
+    field_sub(t7, t7, t6);  // x3' = F - (B + C)
+    field_sub(t6, t7, x1);
+    field_mul(t6, t6, t5);
+    field_sub(y1, t6, y1);  // y3' = (y2 + y1)(x3' - B) - E
+
+    memcpy(x1, t7, sizeof(t7));
+}
+
+// Starts the multiplication of the base point by scalar. The scalar is regularised to k + n or
+// k + 2n, whichever has bit 256 set, so that the ladder always runs over the same 257 bits; that
+// bit is the initial point and the rest are ladder steps.
+static void ladder_start(p256_sign_t *s, const p256_word_t *scalar)
+{
+    p256_word_t n[P256_WORDS];
+    p256_word_t z[P256_WORDS];
+    load(n, curve_n);
+
+    // The second n is added under a mask, since whether it's needed depends on the nonce.
+    p256_word_t carry = add(s->k, scalar, n);
+    s->k_carry = carry;
+    add_masked_P(s->k, s->k, curve_n, carry - 1);
+
+    // R1 = 2G and R0 = G, sharing a z. G's z is 1, in Montgomery form 2^256 mod p.
+    load(s->x[1], base_x);
+    load(s->y[1], base_y);
+    memcpy(s->x[0], s->x[1], sizeof(z));
+    memcpy(s->y[0], s->y[1], sizeof(z));
+    memset(z, 0, sizeof(z));
+    sub_masked_P(z, z, curve_p, (p256_word_t)-1);
+    double_jacobian(s->x[1], s->y[1], z);
+    apply_z(s->x[0], s->y[0], z);
+
+    s->bit = 8 * P256_SCALAR_LENGTH - 1;
+}
+
+// Runs the ladder down to bit 1, up to count bits at a time. Returns whether there's more to go.
+static bool ladder_bits(p256_sign_t *s, uint8_t count)
+{
+    while (s->bit > 0 && count--)
+    {
+        uint8_t nb = !test_bit(s->k, s->bit);
+        xycz_add_c(s->x[1 - nb], s->y[1 - nb], s->x[nb], s->y[nb]);
+        xycz_add(s->x[nb], s->y[nb], s->x[1 - nb], s->y[1 - nb]);
+        s->bit--;
+    }
+    return s->bit > 0;
+}
+
+// Finishes the ladder with bit 0 and recovers the z the result shares, from the base point's y.
+// Leaves the affine result in x[0] and y[0], out of Montgomery form.
+static void ladder_finish(p256_sign_t *s)
+{
+    p256_word_t z[P256_WORDS];
+    p256_word_t t[P256_WORDS];
+
+    uint8_t nb = !test_bit(s->k, 0);
+    xycz_add_c(s->x[1 - nb], s->y[1 - nb], s->x[nb], s->y[nb]);
+
+    field_sub(z, s->x[1], s->x[0]);
+    field_mul(z, z, s->y[1 - nb]);
+    load(t, base_x);
+    field_mul(z, z, t);     // xG Yb (X1 - X0)
+    power(z, z, p_minus_2, true);
+    load(t, base_y);
+    field_mul(z, z, t);
+    field_mul(z, z, s->x[1 - nb]); // Xb yG / (xG Yb (X1 - X0))
+
+    xycz_add(s->x[nb], s->y[nb], s->x[1 - nb], s->y[1 - nb]);
+    apply_z(s->x[0], s->y[0], z);
+
+    memset(t, 0, sizeof(t));
+    t[0] = 1;
+    field_mul(s->x[0], s->x[0], t);
+    field_mul(s->y[0], s->y[0], t);
+}
+
+// Whether 1 < a < n - 2. The ladder can't multiply by 1, n - 2 or n - 1, which pass through the
+// point at infinity on the way, so those keys and nonces are refused too. A random scalar is one of
+// them with probability 2^-254.
+static bool valid_scalar(const p256_word_t *a)
+{
+    p256_word_t t[P256_WORDS];
+    bool above_one = false;
+    for (uint8_t i = 0; i < P256_WORDS; i++)
+        above_one |= a[i] > (i == 0);
+    return above_one && sub_masked_P(t, a, n_minus_2, (p256_word_t)-1);
+}
+
+bool p256_valid_private_key(const uint8_t private_key[P256_SCALAR_LENGTH])
+{
+    p256_word_t d[P256_WORDS];
+    from_bytes(d, private_key);
+    return valid_scalar(d);
+}
+
+bool p256_public_key(const uint8_t private_key[P256_SCALAR_LENGTH], uint8_t public_key[P256_PUBLIC_KEY_LENGTH])
+{
+    p256_sign_t s;
+    from_bytes(s.d, private_key);
+    if (!valid_scalar(s.d))
+        return false;
+
+    ladder_start(&s, s.d);
+    while (ladder_bits(&s, P256_LADDER_STEP_BITS))
+        ;
+    ladder_finish(&s);
+
+    to_bytes(public_key, s.x[0]);
+    to_bytes(public_key + P256_SCALAR_LENGTH, s.y[0]);
+    memset(&s, 0, sizeof(s));
+    return true;
+}
+
+// Derives the nonce for a signature of hash (already reduced mod n) with key d as in RFC 6979
+// section 3.2, using HMAC-SHA-256.
+static void deterministic_nonce(p256_word_t *k, const p256_word_t *d, const p256_word_t *hash)
+{
+    uint8_t key[SHA256_DIGEST_LENGTH];
+    uint8_t v[SHA256_DIGEST_LENGTH];
+    uint8_t octets[P256_SCALAR_LENGTH];
+    hmac_sha256_t h;
+
+    memset(key, 0x00, sizeof(key));
+    memset(v, 0x01, sizeof(v));
+
+    for (uint8_t separator = 0; separator < 2; separator++)
+    {
+        hmac_sha256_init(&h, key, sizeof(key));
+        hmac_sha256_update(&h, v, sizeof(v));
+        hmac_sha256_update(&h, &separator, 1);
+        to_bytes(octets, d);
+        hmac_sha256_update(&h, octets, sizeof(octets));
+        to_bytes(octets, hash);
+        hmac_sha256_update(&h, octets, sizeof(octets));
+        hmac_sha256_final(&h, key);
+
+        hmac_sha256_init(&h, key, sizeof(key));
+        hmac_sha256_update(&h, v, sizeof(v));
+        hmac_sha256_final(&h, v);
+    }
+
+    for (;;)
+    {
+        hmac_sha256_init(&h, key, sizeof(key));
+        hmac_sha256_update(&h, v, sizeof(v));
+        hmac_sha256_final(&h, v);
+
+        from_bytes(k, v);
+        if (valid_scalar(k))
+            break;
+
+        uint8_t zero = 0;
+        hmac_sha256_init(&h, key, sizeof(key));
+        hmac_sha256_update(&h, v, sizeof(v));
+        hmac_sha256_update(&h, &zero, 1);
+        hmac_sha256_final(&h, key);
+
+        hmac_sha256_init(&h, key, sizeof(key));
+        hmac_sha256_update(&h, v, sizeof(v));
+        hmac_sha256_final(&h, v);
+    }
+
+    memset(key, 0, sizeof(key));
+    memset(v, 0, sizeof(v));
+    memset(&h, 0, sizeof(h));
+}
+
+// Starts signing hash with private_key. Returns false if the key isn't valid.
+bool p256_sign_start(p256_sign_t *s, const uint8_t private_key[P256_SCALAR_LENGTH], const uint8_t hash[P256_SCALAR_LENGTH])
+{
+    p256_word_t k[P256_WORDS];
+
+    from_bytes(s->d, private_key);
+    if (!valid_scalar(s->d))
+        return false;
+
+    // The hash is as long as n, so it's already below 2n.
+    from_bytes(s->e, hash);
+    reduce_once(s->e, s->e, 0, curve_n);
+
+    deterministic_nonce(k, s->d, s->e);
+    ladder_start(s, k);
+    memset(k, 0, sizeof(k));
+    return true;
+}
+
+// Runs the next P256_LADDER_STEP_BITS bits of the scalar multiplication. Returns whether there
+// are more to go before p256_sign_finish.
+bool p256_sign_step(p256_sign_t *s)
+{
+    return ladder_bits(s, P256_LADDER_STEP_BITS);
+}
+
+// Writes the signature as r and s, big endian, 32 bytes each. Returns false in the (2^-256
+// likely) case that either came out 0 and there's no signature with this nonce.
+bool p256_sign_finish(p256_sign_t *s, uint8_t signature[P256_SIGNATURE_LENGTH])
+{
+    p256_word_t k[P256_WORDS];
+    p256_word_t r[P256_WORDS];
+    p256_word_t t[P256_WORDS];
+    bool ok;
+
+    ladder_finish(s);
+
+    // Undo the regularisation to get the nonce back.
+    p256_word_t n[P256_WORDS];
+    load(n, curve_n);
+    sub(k, s->k, n);
+    sub_masked_P(k, k, curve_n, s->k_carry - 1);
+
+    // r = x mod n, and x is below p < 2n.
+    reduce_once(r, s->x[0], 0, curve_n);
+
+    // s = (e + r d) / k. Multiplying a number in Montgomery form by one that isn't gives a result
+    // that isn't, which saves converting r d and the final s back.
+    load(t, n_r2);
+    scalar_mul(k, k, t);
+    power(k, k, n_minus_2, false);
+    scalar_mul(t, r, t);
+    scalar_mul(t, t, s->d);
+    mod_add(t, t, s->e, curve_n);
+    scalar_mul(t, k, t);
+
+    ok = !is_zero(r) && !is_zero(t);
+    if (ok)
+    {
+        to_bytes(signature, r);
+        to_bytes(signature + P256_SCALAR_LENGTH, t);
+    }
+
+    memset(k, 0, sizeof(k));
+    memset(t, 0, sizeof(t));
+    memset(s, 0, sizeof(*s));
+    return ok;
+}
+
+bool p256_sign(const uint8_t private_key[P256_SCALAR_LENGTH], const uint8_t hash[P256_SCALAR_LENGTH], uint8_t signature[P256_SIGNATURE_LENGTH])
+{
+    p256_sign_t s;
+    if (!p256_sign_start(&s, private_key, hash))
+        return false;
+    while (p256_sign_step(&s))
+        ;
+    return p256_sign_finish(&s, signature);
+}
@@ -0,0 +1,58 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _P256_H_
+#define _P256_H_
+
+#define P256_SCALAR_LENGTH 32
+#define P256_PUBLIC_KEY_LENGTH 64
+#define P256_SIGNATURE_LENGTH 64
+
+// Numbers are little endian arrays of the widest word the CPU multiplies natively: bytes on the
+// AVR, where MUL is 8x8, and 32 bit words on the host.
+#ifndef P256_WORD_SIZE
+#ifdef __AVR__
+#define P256_WORD_SIZE 1
+#else
+#define P256_WORD_SIZE 4
+#endif
+#endif
+
+#if P256_WORD_SIZE == 1
+typedef uint8_t p256_word_t;
+typedef uint16_t p256_dword_t;
+#elif P256_WORD_SIZE == 4
+typedef uint32_t p256_word_t;
+typedef uint64_t p256_dword_t;
+#else
+#error "P256_WORD_SIZE must be 1 or 4"
+#endif
+
+#define P256_WORDS (32 / P256_WORD_SIZE)
+
+// Bits of the scalar multiplication run per p256_sign_step.
+#define P256_LADDER_STEP_BITS 16
+
+// An ECDSA signature being made, a few bits of the scalar multiplication at a time, so that the
+// caller can do other work (and the keepalives keep going) in between. The nonce is derived from
+// the key and hash as in RFC 6979, so signing needs no random numbers.
+typedef struct
+{
+    p256_word_t x[2][P256_WORDS];
+    p256_word_t y[2][P256_WORDS];
+    p256_word_t k[P256_WORDS];
+    p256_word_t d[P256_WORDS];
+    p256_word_t e[P256_WORDS];
+    uint16_t bit;
+    bool k_carry;
+} p256_sign_t;
+
+bool p256_valid_private_key(const uint8_t private_key[P256_SCALAR_LENGTH]);
+bool p256_public_key(const uint8_t private_key[P256_SCALAR_LENGTH], uint8_t public_key[P256_PUBLIC_KEY_LENGTH]);
+
+bool p256_sign_start(p256_sign_t *s, const uint8_t private_key[P256_SCALAR_LENGTH], const uint8_t hash[P256_SCALAR_LENGTH]);
+bool p256_sign_step(p256_sign_t *s);
+bool p256_sign_finish(p256_sign_t *s, uint8_t signature[P256_SIGNATURE_LENGTH]);
+bool p256_sign(const uint8_t private_key[P256_SCALAR_LENGTH], const uint8_t hash[P256_SCALAR_LENGTH], uint8_t signature[P256_SIGNATURE_LENGTH]);
+
+#endif
@@ -1,54 +1,76 @@
+#include <string.h>
+
 #include "packet_queue.h"
 
+#if (PACKET_QUEUE_LEN & (PACKET_QUEUE_LEN - 1)) != 0
+#error PACKET_QUEUE_LEN must be a power of two
+#endif
+
+// Keeps the compiler from moving slot accesses across the index update that hands the slot over.
+#define PQ_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 packet_queue_t pq_init(void)
 {
     packet_queue_t q = {
         .head = 0,
         .tail = 0,
-        .len = 0,
         .packets = {},
     };
     return q;
 }
 
-void pq_push(packet_queue_t *q, ctap2hid_packet_t packet)
+// Returns the slot the next packet is to be written into, or NULL if the queue is full. It joins
+// the queue once pq_commit is called.
+ctap2hid_packet_t *pq_reserve(packet_queue_t *q)
 {
-    q->len++;
-    if (q->len > PACKET_QUEUE_LEN)
-    {
-        q->len--;
-        return;
-    }
-
-    q->packets[q->tail] = packet;
+    if (pq_is_full(q))
+        return NULL;
+    return &q->packets[q->tail & (PACKET_QUEUE_LEN - 1)];
+}
 
+void pq_commit(packet_queue_t *q)
+{
+    PQ_BARRIER();
     q->tail++;
-    if (q->tail > PACKET_QUEUE_LEN)
-    {
-        q->tail = 0;
-    }
 }
 
-void pq_pop(packet_queue_t *q)
+bool pq_push(packet_queue_t *q, const ctap2hid_packet_t *packet)
+{
+    ctap2hid_packet_t *slot = pq_reserve(q);
+    if (!slot)
+        return false;
+
+    memcpy(slot, packet, sizeof(*slot));
+    pq_commit(q);
+    return true;
+}
+
+// Hands the oldest packet's slot back to the producer. Pointers from pq_peek are invalid after this.
+void pq_release(packet_queue_t *q)
 {
-    if (q->len == 0)
+    if (pq_is_empty(q))
         return;
 
+    PQ_BARRIER();
     q->head++;
-    q->len--;
 }
 
-void pq_pop_n(packet_queue_t *q, uint8_t n)
+void pq_release_n(packet_queue_t *q, uint8_t n)
 {
-    for (; q->len > 0 && n > 0; n--)
-        pq_pop(q);
+    n = MIN(n, pq_length(q));
+
+    PQ_BARRIER();
+    q->head += n;
 }
 
 ctap2hid_packet_t *pq_peek_n(packet_queue_t *q, uint8_t n)
 {
-    if (q->len <= n)
+    if (pq_length(q) <= n)
         return NULL;
-    return &q->packets[(q->head + n) % PACKET_QUEUE_LEN];
+
+    ctap2hid_packet_t *packet = &q->packets[(uint8_t)(q->head + n) & (PACKET_QUEUE_LEN - 1)];
+    PQ_BARRIER();
+    return packet;
 }
 
 ctap2hid_packet_t *pq_peek(packet_queue_t *q)
@@ -56,12 +78,17 @@ ctap2hid_packet_t *pq_peek(packet_queue_t *q)
     return pq_peek_n(q, 0);
 }
 
+uint8_t pq_length(packet_queue_t *q)
+{
+    return q->tail - q->head;
+}
+
 bool pq_is_empty(packet_queue_t *q)
 {
-    return q->len == 0;
+    return q->head == q->tail;
 }
 
 bool pq_is_full(packet_queue_t *q)
 {
-    return q->len == PACKET_QUEUE_LEN;
-}
\ No newline at end of file
+    return pq_length(q) == PACKET_QUEUE_LEN;
+}
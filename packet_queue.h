@@ -3,23 +3,28 @@
 #ifndef _PACKET_QUEUE_H_
 #define _PACKET_QUEUE_H_
 
-#define PACKET_QUEUE_LEN 5
+// Must be a power of two, so the free running indices below wrap onto the slots.
+#define PACKET_QUEUE_LEN 4
 
+// A single producer, single consumer ring. head is only written by the consumer and tail only by
+// the producer, each a single byte store, so one side can run in an ISR without locking.
 typedef struct
 {
-    uint8_t head;
-    uint8_t tail;
-    uint8_t len;
+    volatile uint8_t head;
+    volatile uint8_t tail;
     ctap2hid_packet_t packets[PACKET_QUEUE_LEN];
 } packet_queue_t;
 
 packet_queue_t pq_init(void);
-void pq_push(packet_queue_t *q, ctap2hid_packet_t packet);
-void pq_pop(packet_queue_t *q);
-void pq_pop_n(packet_queue_t *q, uint8_t n);
+ctap2hid_packet_t *pq_reserve(packet_queue_t *q);
+void pq_commit(packet_queue_t *q);
+bool pq_push(packet_queue_t *q, const ctap2hid_packet_t *packet);
+void pq_release(packet_queue_t *q);
+void pq_release_n(packet_queue_t *q, uint8_t n);
 ctap2hid_packet_t *pq_peek(packet_queue_t *q);
 ctap2hid_packet_t *pq_peek_n(packet_queue_t *q, uint8_t n);
+uint8_t pq_length(packet_queue_t *q);
 bool pq_is_empty(packet_queue_t *q);
 bool pq_is_full(packet_queue_t *q);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,129 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <string.h>
+
+#include "profiler.h"
+
+#if defined(FIDO_PROFILER)
+
+// Timer1 runs from the system clock divided by 64, so a tick is 4us at 16MHz and the count wraps
+// every PROFILE_WRAP_FRAMES frames. Latencies longer than that saturate.
+#define PROFILE_TIMER_CLOCK ((1 << CS11) | (1 << CS10))
+#define PROFILE_WRAP_FRAMES ((65536UL * 64) / (F_CPU / 1000))
+
+profile_t profile;
+
+// The request being traced, stamped into here and only copied to profile once its response is sent.
+struct
+{
+    bool active;
+    uint32_t channel_id;
+    uint8_t command_id;
+    profile_stamp_t stamps[PROFILE_STAGES];
+} trace;
+
+void profile_init(void)
+{
+    TCCR1A = 0;
+    TCCR1B = PROFILE_TIMER_CLOCK;
+
+    memset(&profile, 0, sizeof(profile));
+    trace.active = false;
+}
+
+static profile_histogram_t *histogram(uint8_t command_id)
+{
+    for (uint8_t i = 0; i < PROFILE_COMMANDS; i++)
+    {
+        profile_histogram_t *h = &profile.histograms[i];
+
+        // Command ID 0 isn't a valid command, so it marks a free slot.
+        if (h->command_id == 0)
+        {
+            h->command_id = command_id;
+            h->min = UINT16_MAX;
+            return h;
+        }
+        if (h->command_id == command_id)
+            return h;
+    }
+    return NULL;
+}
+
+static void record(void)
+{
+    profile_stamp_t *first = &trace.stamps[PROFILE_RECEIVED];
+    profile_stamp_t *last = &trace.stamps[PROFILE_SENT];
+
+    uint16_t frames = (last->frame - first->frame) & 0x7ff;
+    uint16_t ticks = frames < PROFILE_WRAP_FRAMES ? last->ticks - first->ticks : UINT16_MAX;
+
+    profile.command_id = trace.command_id;
+    memcpy(profile.stamps, trace.stamps, sizeof(profile.stamps));
+
+    profile_histogram_t *h = histogram(trace.command_id);
+    if (!h)
+        return;
+
+    h->min = MIN(h->min, ticks);
+    h->max = MAX(h->max, ticks);
+
+    uint8_t bucket = 0;
+    while (ticks >>= 1)
+        bucket++;
+
+    if (h->buckets[bucket] < UINT8_MAX)
+        h->buckets[bucket]++;
+}
+
+// Stamps a stage of the request being traced on a channel. A received init packet starts tracing
+// its channel unless another channel's request is already complete and awaiting its response.
+void profile_stamp(uint32_t channel_id, profile_stage_t stage)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (stage == PROFILE_RECEIVED)
+        {
+            bool waiting = trace.active && trace.stamps[PROFILE_COMPLETE].frame != UINT16_MAX;
+            if (waiting && trace.channel_id != channel_id)
+                return;
+
+            trace.active = true;
+            trace.channel_id = channel_id;
+            trace.command_id = 0;
+            memset(trace.stamps, 0xff, sizeof(trace.stamps));
+        }
+        else if (!trace.active || trace.channel_id != channel_id)
+            return;
+
+        trace.stamps[stage].ticks = TCNT1;
+        trace.stamps[stage].frame = USB_Device_GetFrameNumber();
+
+        if (stage == PROFILE_SENT)
+        {
+            record();
+            trace.active = false;
+        }
+    }
+}
+
+void profile_command(uint32_t channel_id, uint8_t command_id)
+{
+    if (trace.active && trace.channel_id == channel_id)
+        trace.command_id = command_id;
+}
+
+// Describes the recorded profile as a response message. It's sent straight from the live record.
+ctap2hid_message_view_t profile_view(uint32_t channel_id)
+{
+    ctap2hid_message_view_t view = {
+        .channel_id = channel_id,
+        .command_id = CTAPHID_VENDOR_PROFILE,
+        .payload_length = sizeof(profile),
+        .segment_count = 1,
+        .segments = {{(const uint8_t *)&profile, sizeof(profile)}},
+    };
+    return view;
+}
+
+#endif
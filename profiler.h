@@ -0,0 +1,71 @@
+#include "ctap2hid_message.h"
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#if defined(FIDO_PROFILER)
+
+// Number of distinct command IDs that get their own histogram. Later ones aren't recorded.
+#define PROFILE_COMMANDS 4
+
+// Latencies are bucketed by their log2 in Timer1 ticks, so the last bucket holds anything over
+// 2^(PROFILE_BUCKETS - 1) ticks.
+#define PROFILE_BUCKETS 16
+
+typedef enum
+{
+    PROFILE_RECEIVED,
+    PROFILE_COMPLETE,
+    PROFILE_HANDLER_ENTRY,
+    PROFILE_HANDLER_EXIT,
+    PROFILE_SENT,
+    PROFILE_STAGES,
+} profile_stage_t;
+
+// Timer1 count and USB frame number at which a stage was reached.
+typedef struct
+{
+    uint16_t ticks;
+    uint16_t frame;
+} ATTR_PACKED profile_stamp_t;
+
+// Latencies from the first packet of a request to the last packet of its response. Bucket counts
+// saturate rather than wrap.
+typedef struct
+{
+    uint8_t command_id;
+    uint16_t min;
+    uint16_t max;
+    uint8_t buckets[PROFILE_BUCKETS];
+} ATTR_PACKED profile_histogram_t;
+
+// Everything recorded, in the layout returned by the dump command (multi-byte fields are little
+// endian): the stamps of the last complete trace followed by the histograms.
+typedef struct
+{
+    uint8_t command_id;
+    profile_stamp_t stamps[PROFILE_STAGES];
+    profile_histogram_t histograms[PROFILE_COMMANDS];
+} ATTR_PACKED profile_t;
+
+void profile_init(void);
+void profile_stamp(uint32_t channel_id, profile_stage_t stage);
+void profile_command(uint32_t channel_id, uint8_t command_id);
+ctap2hid_message_view_t profile_view(uint32_t channel_id);
+
+// One request is traced at a time: its channel's stages are stamped from the first packet received
+// until the last response packet is sent, and other channels' are ignored meanwhile.
+#define PROFILE_INIT() profile_init()
+#define PROFILE_STAMP(channel_id, stage) profile_stamp(channel_id, stage)
+#define PROFILE_COMMAND(channel_id, command_id) profile_command(channel_id, command_id)
+
+#else
+
+// Still statements when profiling's off, so an unbraced if around a stamp keeps a body.
+#define PROFILE_INIT() ((void)0)
+#define PROFILE_STAMP(channel_id, stage) ((void)0)
+#define PROFILE_COMMAND(channel_id, command_id) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#ifndef _PT_H_
+#define _PT_H_
+
+// Stackless coroutines (protothreads). A function written between PT_BEGIN and PT_END returns to
+// its caller at each PT_YIELD or PT_WAIT_UNTIL and carries on from there the next time it's called.
+// Only the resume point is kept, in a pt_t, so locals don't survive across a yield: anything that
+// must is kept alongside the pt_t instead. PT_YIELD and PT_WAIT_UNTIL can't be used inside a switch.
+typedef struct
+{
+    uint16_t lc;
+} pt_t;
+
+typedef enum
+{
+    PT_WAITING,
+    PT_YIELDED,
+    PT_ENDED,
+} pt_state_t;
+
+#define PT_INIT(pt) ((pt)->lc = 0)
+
+#define PT_BEGIN(pt)     \
+    switch ((pt)->lc)    \
+    {                    \
+    case 0:
+
+#define PT_END(pt)       \
+    }                    \
+    PT_INIT(pt);         \
+    return PT_ENDED;
+
+// Gives the rest of the main loop a turn, having done some work.
+#define PT_YIELD(pt)             \
+    do                           \
+    {                            \
+        (pt)->lc = __LINE__;     \
+        return PT_YIELDED;       \
+    case __LINE__:;              \
+    } while (0)
+
+// Returns until condition holds, without counting as work done.
+#define PT_WAIT_UNTIL(pt, condition) \
+    do                               \
+    {                                \
+        (pt)->lc = __LINE__;         \
+    case __LINE__:                   \
+        if (!(condition))            \
+            return PT_WAITING;       \
+    } while (0)
+
+// Runs a child protothread to completion, yielding whenever it does.
+#define PT_SPAWN(pt, child, thread)                      \
+    do                                                   \
+    {                                                    \
+        PT_INIT(child);                                  \
+        (pt)->lc = __LINE__;                             \
+    case __LINE__:;                                      \
+        pt_state_t _child_state = (thread);              \
+        if (_child_state != PT_ENDED)                    \
+            return _child_state;                         \
+    } while (0)
+
+#endif
@@ -0,0 +1,87 @@
+#include <avr/io.h>
+
+#include "ctaphid.h"
+#include "ram_usage.h"
+
+#if defined(FIDO_RAM_USAGE)
+
+// From the linker and avr-libc: the end of .noinit, where the heap starts, and the heap's break, 0
+// until malloc is first called.
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+ram_usage_t ram_usage;
+
+// The heap has written everything below heap_top, and the stack everything from stack_bottom up.
+// A scan walks up the painted gap between them from heap_top, and the first byte it finds written
+// is as deep as the stack has been.
+static uint8_t *heap_top = &__heap_start;
+static uint8_t *stack_bottom = (uint8_t *)(RAMEND + 1);
+static uint8_t *scan = &__heap_start;
+
+// Paints everything from the heap's start to the top of the stack before main runs. .init3 is
+// after the stack pointer's been set up, but before anything's been pushed.
+void ram_paint(void) __attribute__((naked, used, section(".init3")));
+void ram_paint(void)
+{
+    for (uint8_t *p = &__heap_start; p <= (uint8_t *)RAMEND; p++)
+        *p = RAM_PAINT;
+}
+
+static void publish(void)
+{
+    ram_usage.stack_peak = (uint8_t *)(RAMEND + 1) - stack_bottom;
+    ram_usage.heap_peak = heap_top - &__heap_start;
+    ram_usage.gap_min = stack_bottom > heap_top ? stack_bottom - heap_top : 0;
+}
+
+// Checks the next byte of the gap. Returns true once a scan has finished, and ram_usage is current.
+static bool scan_byte(void)
+{
+    if (scan < stack_bottom && *scan == RAM_PAINT)
+    {
+        scan++;
+        return false;
+    }
+
+    stack_bottom = scan;
+
+    // The break only goes down again when the top of the heap is freed, so the peak's kept here.
+    if ((uint8_t *)__brkval > heap_top)
+        heap_top = (uint8_t *)__brkval;
+
+    publish();
+    scan = heap_top;
+    return true;
+}
+
+void ram_usage_task(void)
+{
+    for (uint8_t i = 0; i < RAM_SCAN_BYTES; i++)
+    {
+        if (scan_byte())
+            return;
+    }
+}
+
+/** Finishes the scan in progress, for ram_usage to be read straight away. */
+void ram_usage_update(void)
+{
+    while (!scan_byte())
+        ;
+}
+
+// Describes the high-water marks as a response message, sent straight from ram_usage.
+ctap2hid_message_view_t ram_usage_view(uint32_t channel_id)
+{
+    ctap2hid_message_view_t view = {
+        .channel_id = channel_id,
+        .command_id = CTAPHID_VENDOR_RAM_USAGE,
+        .payload_length = sizeof(ram_usage),
+        .segment_count = 1,
+        .segments = {{(const uint8_t *)&ram_usage, sizeof(ram_usage)}},
+    };
+    return view;
+}
+
+#endif
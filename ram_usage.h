@@ -0,0 +1,39 @@
+#include "ctap2hid_message.h"
+
+#ifndef _RAM_USAGE_H_
+#define _RAM_USAGE_H_
+
+#if defined(FIDO_RAM_USAGE)
+
+// Byte the free RAM is painted with at boot. Any of it that's been written over since has been used.
+#define RAM_PAINT 0xc5
+
+// Bytes of the painted gap checked per idle pass of the main loop.
+#define RAM_SCAN_BYTES 32
+
+// High-water marks since boot, in bytes, in the layout returned by the CTAPHID_VENDOR_RAM_USAGE
+// command (little endian). The gap is what's never been touched between the heap and the stack.
+typedef struct
+{
+    uint16_t stack_peak;
+    uint16_t heap_peak;
+    uint16_t gap_min;
+} ATTR_PACKED ram_usage_t;
+
+// Kept current from the main loop's idle time, so a simulator or debugger can read it straight from
+// RAM by its symbol.
+extern ram_usage_t ram_usage;
+
+void ram_usage_task(void);
+void ram_usage_update(void);
+ctap2hid_message_view_t ram_usage_view(uint32_t channel_id);
+
+#define RAM_USAGE_TASK() ram_usage_task()
+
+#else
+
+#define RAM_USAGE_TASK() ((void)0)
+
+#endif
+
+#endif
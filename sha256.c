@@ -0,0 +1,166 @@
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "sha256.h"
+
+static const uint32_t round_constants[64] PROGMEM = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t initial_state[8] PROGMEM = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static uint32_t rotr(uint32_t x, uint8_t n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static uint32_t load_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+// The message schedule is kept as a rolling window of 16 words rather than all 64, which saves
+// 192 bytes of stack.
+static void compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_LENGTH])
+{
+    uint32_t w[16];
+    uint32_t v[8];
+
+    for (uint8_t i = 0; i < 16; i++)
+        w[i] = load_be32(block + 4 * i);
+    memcpy(v, state, sizeof(v));
+
+    for (uint8_t i = 0; i < 64; i++)
+    {
+        uint32_t wi;
+        if (i < 16)
+            wi = w[i];
+        else
+        {
+            uint32_t w15 = w[(i - 15) & 15];
+            uint32_t w2 = w[(i - 2) & 15];
+            uint32_t s0 = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+            uint32_t s1 = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+            wi = w[i & 15] += s0 + w[(i - 7) & 15] + s1;
+        }
+
+        uint32_t e = v[4];
+        uint32_t t1 = v[7] + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & v[5]) ^ (~e & v[6])) +
+                      pgm_read_dword(&round_constants[i]) + wi;
+        uint32_t a = v[0];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & v[1]) ^ (a & v[2]) ^ (v[1] & v[2]));
+
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+
+    for (uint8_t i = 0; i < 8; i++)
+        state[i] += v[i];
+}
+
+void sha256_init(sha256_t *s)
+{
+    memcpy_P(s->state, initial_state, sizeof(s->state));
+    s->length = 0;
+}
+
+void sha256_update(sha256_t *s, const uint8_t *data, uint16_t length)
+{
+    while (length)
+    {
+        uint8_t used = s->length % SHA256_BLOCK_LENGTH;
+        uint8_t take = SHA256_BLOCK_LENGTH - used;
+        if (take > length)
+            take = length;
+
+        memcpy(s->block + used, data, take);
+        s->length += take;
+        data += take;
+        length -= take;
+
+        if (used + take == SHA256_BLOCK_LENGTH)
+            compress(s->state, s->block);
+    }
+}
+
+void sha256_final(sha256_t *s, uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    uint8_t used = s->length % SHA256_BLOCK_LENGTH;
+
+    s->block[used++] = 0x80;
+    if (used > SHA256_BLOCK_LENGTH - 8)
+    {
+        memset(s->block + used, 0, SHA256_BLOCK_LENGTH - used);
+        compress(s->state, s->block);
+        used = 0;
+    }
+    memset(s->block + used, 0, SHA256_BLOCK_LENGTH - 8 - used);
+
+    // The length in bits, of which the top 29 are always 0 here.
+    store_be32(s->block + SHA256_BLOCK_LENGTH - 8, s->length >> 29);
+    store_be32(s->block + SHA256_BLOCK_LENGTH - 4, s->length << 3);
+    compress(s->state, s->block);
+
+    for (uint8_t i = 0; i < 8; i++)
+        store_be32(digest + 4 * i, s->state[i]);
+}
+
+void sha256(const uint8_t *data, uint16_t length, uint8_t digest[SHA256_DIGEST_LENGTH])
+{
+    sha256_t s;
+    sha256_init(&s);
+    sha256_update(&s, data, length);
+    sha256_final(&s, digest);
+}
+
+// Starts a hash with the key padded out to a block and xored with pad.
+static void start_padded(hmac_sha256_t *h, uint8_t pad)
+{
+    uint8_t block[SHA256_BLOCK_LENGTH];
+    memset(block, pad, sizeof(block));
+    for (uint8_t i = 0; i < SHA256_DIGEST_LENGTH; i++)
+        block[i] ^= h->key[i];
+
+    sha256_init(&h->sha);
+    sha256_update(&h->sha, block, sizeof(block));
+}
+
+void hmac_sha256_init(hmac_sha256_t *h, const uint8_t *key, uint8_t key_length)
+{
+    memset(h->key, 0, sizeof(h->key));
+    memcpy(h->key, key, key_length);
+    start_padded(h, 0x36);
+}
+
+void hmac_sha256_update(hmac_sha256_t *h, const uint8_t *data, uint16_t length)
+{
+    sha256_update(&h->sha, data, length);
+}
+
+void hmac_sha256_final(hmac_sha256_t *h, uint8_t mac[SHA256_DIGEST_LENGTH])
+{
+    uint8_t inner[SHA256_DIGEST_LENGTH];
+    sha256_final(&h->sha, inner);
+
+    start_padded(h, 0x5c);
+    sha256_update(&h->sha, inner, sizeof(inner));
+    sha256_final(&h->sha, mac);
+}
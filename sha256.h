@@ -0,0 +1,36 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#define SHA256_BLOCK_LENGTH 64
+#define SHA256_DIGEST_LENGTH 32
+
+// Hashes a message fed to it in pieces of any size, a block at a time, so only the block being
+// filled is ever held.
+typedef struct
+{
+    uint32_t state[8];
+    uint32_t length;
+    uint8_t block[SHA256_BLOCK_LENGTH];
+} sha256_t;
+
+// HMAC-SHA-256 with a key of at most SHA256_DIGEST_LENGTH bytes, which is all anything here uses.
+// Only the key is kept besides the inner hash, the pads are rebuilt from it as needed.
+typedef struct
+{
+    sha256_t sha;
+    uint8_t key[SHA256_DIGEST_LENGTH];
+} hmac_sha256_t;
+
+void sha256_init(sha256_t *s);
+void sha256_update(sha256_t *s, const uint8_t *data, uint16_t length);
+void sha256_final(sha256_t *s, uint8_t digest[SHA256_DIGEST_LENGTH]);
+void sha256(const uint8_t *data, uint16_t length, uint8_t digest[SHA256_DIGEST_LENGTH]);
+
+void hmac_sha256_init(hmac_sha256_t *h, const uint8_t *key, uint8_t key_length);
+void hmac_sha256_update(hmac_sha256_t *h, const uint8_t *data, uint16_t length);
+void hmac_sha256_final(hmac_sha256_t *h, uint8_t mac[SHA256_DIGEST_LENGTH]);
+
+#endif
@@ -0,0 +1,24 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _SHA512_H_
+#define _SHA512_H_
+
+#define SHA512_BLOCK_LENGTH 128
+#define SHA512_DIGEST_LENGTH 64
+
+// Hashes a message fed to it in pieces of any size, a block at a time, the same way as sha256_t.
+// Messages here are never near 4 GB, so the length is only counted to 32 bits.
+typedef struct
+{
+    uint64_t state[8];
+    uint32_t length;
+    uint8_t block[SHA512_BLOCK_LENGTH];
+} sha512_t;
+
+void sha512_init(sha512_t *s);
+void sha512_update(sha512_t *s, const uint8_t *data, uint16_t length);
+void sha512_final(sha512_t *s, uint8_t digest[SHA512_DIGEST_LENGTH]);
+void sha512(const uint8_t *data, uint16_t length, uint8_t digest[SHA512_DIGEST_LENGTH]);
+
+#endif
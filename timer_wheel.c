@@ -0,0 +1,115 @@
+#include <util/atomic.h>
+
+#include "timer_wheel.h"
+
+timer_wheel_t tw_init(void)
+{
+    timer_wheel_t w = {
+        .timers = {},
+        .current = 0,
+        .ms_till_tick = TIMER_WHEEL_TICK_MS,
+        .expired = 0,
+    };
+
+    for (uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+        w.heads[i] = TIMER_NONE;
+    return w;
+}
+
+static void unlink_timer(timer_wheel_t *w, uint8_t timer)
+{
+    wheel_timer_t *t = &w->timers[timer];
+
+    if (t->previous == TIMER_NONE)
+        w->heads[t->slot] = t->next;
+    else
+        w->timers[t->previous].next = t->next;
+    if (t->next != TIMER_NONE)
+        w->timers[t->next].previous = t->previous;
+
+    t->armed = false;
+}
+
+// Starts a timer, or restarts it if it's already running. It expires no sooner than ms from now, and
+// at most a tick later.
+void tw_start(timer_wheel_t *w, uint8_t timer, uint16_t ms)
+{
+    uint16_t ticks = ms / TIMER_WHEEL_TICK_MS + 1;
+    wheel_timer_t *t = &w->timers[timer];
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (t->armed)
+            unlink_timer(w, timer);
+        w->expired &= ~(1 << timer);
+
+        t->armed = true;
+        t->slot = (w->current + ticks) % TIMER_WHEEL_SLOTS;
+        t->rounds = (ticks - 1) / TIMER_WHEEL_SLOTS;
+        t->previous = TIMER_NONE;
+        t->next = w->heads[t->slot];
+        if (t->next != TIMER_NONE)
+            w->timers[t->next].previous = timer;
+        w->heads[t->slot] = timer;
+    }
+}
+
+// Stops a timer, and forgets it if it had expired but not been dealt with yet.
+void tw_cancel(timer_wheel_t *w, uint8_t timer)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (w->timers[timer].armed)
+            unlink_timer(w, timer);
+        w->expired &= ~(1 << timer);
+    }
+}
+
+// Counts down a millisecond, moving the wheel on a slot every TIMER_WHEEL_TICK_MS. Returns whether a
+// timer has expired.
+bool tw_tick(timer_wheel_t *w)
+{
+    if (--w->ms_till_tick > 0)
+        return false;
+    w->ms_till_tick = TIMER_WHEEL_TICK_MS;
+    w->current = (w->current + 1) % TIMER_WHEEL_SLOTS;
+
+    bool expired = false;
+    uint8_t timer = w->heads[w->current];
+    while (timer != TIMER_NONE)
+    {
+        wheel_timer_t *t = &w->timers[timer];
+        uint8_t next = t->next;
+
+        if (t->rounds == 0)
+        {
+            unlink_timer(w, timer);
+            w->expired |= 1 << timer;
+            expired = true;
+        }
+        else
+            t->rounds--;
+
+        timer = next;
+    }
+    return expired;
+}
+
+// Takes one of the expired timers, lowest numbered first, or returns TIMER_NONE if there are none.
+uint8_t tw_next_expired(timer_wheel_t *w)
+{
+    uint8_t timer = TIMER_NONE;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < TIMER_WHEEL_TIMERS && timer == TIMER_NONE; i++)
+        {
+            if (w->expired & (1 << i))
+            {
+                w->expired &= ~(1 << i);
+                timer = i;
+            }
+        }
+    }
+    return timer;
+}
@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+// Slots around the wheel, and the milliseconds (Start Of Frame ticks) it takes to move on one.
+#define TIMER_WHEEL_SLOTS 16
+#define TIMER_WHEEL_TICK_MS 8
+
+// Timers are numbered from 0, and each has a bit in the expired mask.
+#define TIMER_WHEEL_TIMERS 8
+#define TIMER_NONE 0xff
+
+typedef struct
+{
+    bool armed;
+    uint8_t slot;
+    // Whole turns of the wheel left before it expires when its slot comes round.
+    uint8_t rounds;
+    uint8_t previous;
+    uint8_t next;
+} wheel_timer_t;
+
+// One-shot timers, hashed into slots by when they expire and kept in a doubly linked list per slot,
+// so starting and cancelling one is O(1) and a tick only looks at the slot it's moved onto. Ticked
+// from the SOF interrupt; expired timers are flagged there and dealt with by the main loop.
+typedef struct
+{
+    uint8_t heads[TIMER_WHEEL_SLOTS];
+    wheel_timer_t timers[TIMER_WHEEL_TIMERS];
+    uint8_t current;
+    uint8_t ms_till_tick;
+    volatile uint8_t expired;
+} timer_wheel_t;
+
+timer_wheel_t tw_init(void);
+void tw_start(timer_wheel_t *w, uint8_t timer, uint16_t ms);
+void tw_cancel(timer_wheel_t *w, uint8_t timer);
+bool tw_tick(timer_wheel_t *w);
+uint8_t tw_next_expired(timer_wheel_t *w);
+
+#endif